@@ -0,0 +1,300 @@
+#! /bin/bash
+
+# Shell script for running a benchmark on a generated input
+# Usage: ./bench.sh scan|strings|ast|layout|parse|symbols|members|registers|switch|arith|instructions [lines]
+if [ ! -f ./bin/main ]; then
+  echo "building compiler"
+  make
+fi
+
+BENCH_DIR="./programs/bench"
+LINES=${2:-200000}
+
+mkdir -p $BENCH_DIR
+
+# Generated translation unit: long string tables, wide indentation
+# and expression statements
+gen_scan() {
+  awk -v n=$LINES 'BEGIN {
+    print "char* table_entry;"
+    print "int main() {"
+    print "    int value_0;"
+    for (i = 1; i < n; i++) {
+      if (i % 3 == 0) {
+        printf "            table_entry = \"entry number %d of the generated string table\";\n", i
+      } else {
+        printf "        value_%d = value_%d * %d + (value_%d << 2) - %d;\n", i % 97, (i + 1) % 97, i, i % 13, i % 1000
+      }
+    }
+    print "    return 0;"
+    print "}"
+  }' > $1
+}
+
+# Mostly long string tables behind wide indentation
+gen_strings() {
+  awk -v n=$LINES 'BEGIN {
+    print "char* table_entry;"
+    print "int main() {"
+    for (i = 1; i < n; i++) {
+      printf "                                table_entry = \"%d: the quick brown fox jumps over the lazy dog, the quick brown fox jumps over the lazy dog again and again\";\n", i
+    }
+    print "    return 0;"
+    print "}"
+  }' > $1
+}
+
+# Many functions of 50 expression statements each
+gen_functions() {
+  awk -v n=$LINES 'BEGIN {
+    print "int printf(char* fmt);"
+    for (f = 0; f < n / 50; f++) {
+      printf "int function_%d(int a) {\n    int b;\n    b = a;\n", f
+      for (i = 0; i < 45; i++) {
+        printf "    b = b * %d + (a << 2) - (b >> %d) + %d;\n", i, i % 7, f
+      }
+      print "    return b;"
+      print "}"
+    }
+  }' > $1
+}
+
+# Functions of 100 long expressions each
+gen_expressions() {
+  awk -v n=$LINES 'BEGIN {
+    for (f = 0; f < n / 100; f++) {
+      printf "int function_%d(int a, int b) {\n", f
+      for (i = 0; i < 100; i++) {
+        printf "    a = (a + b * %d - (b << 2)) ^ ((a >> 1) | (b & %d)) + a * b - %d;\n", i % 13, i % 255, f
+      }
+      print "    return a;"
+      print "}"
+    }
+  }' > $1
+}
+
+# Many globals, used from functions with many locals
+gen_symbols() {
+  awk -v n=$LINES 'BEGIN {
+    for (g = 0; g < n / 4; g++) {
+      printf "int global_%d;\n", g
+    }
+    for (f = 0; f < n / 40; f++) {
+      printf "int function_%d(int a) {\n", f
+      for (i = 0; i < 16; i++) {
+        printf "    int local_%d;\n", i
+      }
+      for (i = 0; i < 16; i++) {
+        printf "    local_%d = global_%d + a;\n", i, (f * 16 + i) % int(n / 4)
+      }
+      print "    return local_0;"
+      print "}"
+    }
+  }' > $1
+}
+
+# A struct with many fields, accessed in every statement
+gen_members() {
+  awk -v n=$LINES 'BEGIN {
+    print "struct wide {"
+    for (i = 0; i < 500; i++) {
+      printf "    int field_%d;\n", i
+    }
+    print "};"
+    print "struct wide w;"
+    for (f = 0; f < n / 50; f++) {
+      printf "int function_%d(int a) {\n", f
+      for (i = 0; i < 48; i++) {
+        printf "    w.field_%d = w.field_%d + a;\n", (f * 7 + i * 13) % 500, (f + i * 31) % 500
+      }
+      print "    return a;"
+      print "}"
+    }
+  }' > $1
+}
+
+# Right-nested expressions deeper than the register file, some with calls
+gen_nested() {
+  awk -v n=$LINES 'BEGIN {
+    print "int id(int x) { return x; }"
+    for (f = 0; f < n / 50; f++) {
+      printf "int function_%d(int x, int b) {\n    int a;\n    a = x;\n", f
+      for (i = 0; i < 48; i++) {
+        printf "    a = "
+        for (d = 0; d < i % 24; d++) {
+          printf "%s + (%s * ", (d % 2) ? "a" : "b", (d % 3) ? (i % 4 ? "b" : "id(b)") : "a"
+        }
+        printf "%d", i
+        for (d = 0; d < i % 24; d++) {
+          printf ")"
+        }
+        print ";"
+      }
+      print "    return a;"
+      print "}"
+    }
+  }' > $1
+}
+
+# An interpreter loop over 256 dense opcodes and a lookup of 64 sparse
+# keys, dispatched lines * 50 times each
+gen_switch() {
+  awk -v n=$LINES 'BEGIN {
+    print "int printf(char* fmt);"
+    print "int step(int op, int acc) {"
+    print "    switch (op) {"
+    for (i = 0; i < 256; i++) {
+      printf "        case %d: return acc + %d;\n", i, (i * 37) % 101
+    }
+    print "    }"
+    print "    return acc;"
+    print "}"
+    print "int lookup(int key) {"
+    print "    switch (key) {"
+    for (i = 0; i < 64; i++) {
+      printf "        case %d: return %d;\n", i * 97 + i * i, i
+    }
+    print "        default: return 1;"
+    print "    }"
+    print "    return 0;"
+    print "}"
+    print "int main() {"
+    print "    int i;"
+    print "    int acc;"
+    print "    i = 0;"
+    print "    acc = 0;"
+    printf "    while (i < %d) {\n", n * 50
+    print "        acc = step(i & 255, acc) + lookup((i & 63) * 97 + (i & 63) * (i & 63));"
+    print "        i++;"
+    print "    }"
+    print "    printf(\"%d\\n\", acc);"
+    print "    return 0;"
+    print "}"
+  }' > $1
+}
+
+# Hash probes and ring buffer indexes, lines * 50 iterations of '%' and
+# '/' by constants. With divisors set to "variables" the same divisors
+# are read from globals, so every operation divides at runtime.
+gen_arith() {
+  awk -v n=$LINES -v divisors=$2 'BEGIN {
+    split("1021 24 10 3 7 64 16", d, " ")
+    for (k = 1; k <= 7; k++) {
+      v[d[k]] = divisors == "variables" ? "d_" d[k] : d[k]
+    }
+    print "int printf(char* fmt);"
+    print "int table[1021];"
+    print "int ring[24];"
+    for (k = 1; k <= 7; k++) {
+      printf "int d_%d;\n", d[k]
+    }
+    print "int main() {"
+    print "    int i;"
+    print "    int h;"
+    print "    int head;"
+    print "    int sum;"
+    for (k = 1; k <= 7; k++) {
+      printf "    d_%d = %d;\n", d[k], d[k]
+    }
+    print "    i = 0;"
+    print "    head = 0;"
+    print "    sum = 0;"
+    printf "    while (i < %d) {\n", n * 50
+    printf "        h = (i * 31 + 7) %% %s;\n", v[1021]
+    printf "        table[h] = table[h] + i %% %s;\n", v[10]
+    printf "        head = (head + 1) %% %s;\n", v[24]
+    printf "        ring[head] = i / %s;\n", v[3]
+    printf "        sum = sum + table[h * 5 %% %s] + ring[(head + 12) %% %s] / %s + i %% %s + i / %s;\n", v[1021], v[24], v[7], v[64], v[16]
+    print "        i++;"
+    print "    }"
+    print "    printf(\"%d\\n\", sum);"
+    print "    return 0;"
+    print "}"
+  }' > $1
+}
+
+case "$1" in
+  scan)
+    gen_scan $BENCH_DIR/scan.c
+    echo "scanning $LINES lines"
+    ./bin/main -L $BENCH_DIR/scan.c
+    ;;
+  strings)
+    gen_strings $BENCH_DIR/strings.c
+    echo "scanning $LINES lines of string tables"
+    ./bin/main -L $BENCH_DIR/strings.c
+    ;;
+  ast)
+    gen_functions $BENCH_DIR/functions.c
+    echo "compiling $LINES lines of functions"
+    ./bin/main -S -v $BENCH_DIR/functions.c > /dev/null
+    ;;
+  layout)
+    # -C copies the parsed pointer tree into the compact one, so both
+    # layouts are allocated and parsing costs the same either way
+    gen_expressions $BENCH_DIR/expressions.c
+    echo "compiling $LINES lines of expressions with the pointer AST"
+    time ./bin/main -S $BENCH_DIR/expressions.c > /dev/null
+    mv $BENCH_DIR/expressions.s $BENCH_DIR/expressions_pointer.s
+    echo "compiling $LINES lines of expressions with the compact AST"
+    time ./bin/main -S -C $BENCH_DIR/expressions.c > /dev/null
+    cmp $BENCH_DIR/expressions.s $BENCH_DIR/expressions_pointer.s && echo "same assembly"
+    ;;
+  parse)
+    gen_expressions $BENCH_DIR/expressions.c
+    echo "parsing $LINES lines of expressions"
+    ./bin/main -P $BENCH_DIR/expressions.c
+    ;;
+  symbols)
+    gen_symbols $BENCH_DIR/symbols.c
+    echo "compiling $LINES lines of declarations"
+    time ./bin/main -S -v $BENCH_DIR/symbols.c > /dev/null
+    ;;
+  members)
+    gen_members $BENCH_DIR/members.c
+    echo "parsing $LINES lines of member accesses"
+    ./bin/main -P $BENCH_DIR/members.c
+    ;;
+  registers)
+    gen_nested $BENCH_DIR/nested.c
+    echo "compiling $LINES lines of nested expressions"
+    time ./bin/main -S -v $BENCH_DIR/nested.c 2>&1 > /dev/null |
+      awk '/virtual registers/ {f++; v += $3; p = $6 > p ? $6 : p; s += $10}
+           END {printf "%d functions, %d virtual registers, at most %d live, %d spilled\n", f, v, p, s}'
+    ;;
+  switch)
+    gen_switch $BENCH_DIR/switch.c
+    echo "dispatching $((LINES * 50)) times through the runtime table scan"
+    ./bin/main -S -linear-switch $BENCH_DIR/switch.c && cc -no-pie -o $BENCH_DIR/switch_linear $BENCH_DIR/switch.s
+    time $BENCH_DIR/switch_linear
+    echo "dispatching $((LINES * 50)) times through jump tables and compare trees"
+    ./bin/main -S $BENCH_DIR/switch.c && cc -no-pie -o $BENCH_DIR/switch $BENCH_DIR/switch.s
+    time $BENCH_DIR/switch
+    ;;
+  arith)
+    gen_arith $BENCH_DIR/arith_idiv.c variables
+    echo "$((LINES * 50)) iterations of index math dividing at runtime"
+    ./bin/main -S $BENCH_DIR/arith_idiv.c && cc -no-pie -o $BENCH_DIR/arith_idiv $BENCH_DIR/arith_idiv.s
+    time $BENCH_DIR/arith_idiv
+    gen_arith $BENCH_DIR/arith.c constants
+    echo "$((LINES * 50)) iterations of index math by constant divisors"
+    ./bin/main -S $BENCH_DIR/arith.c && cc -no-pie -o $BENCH_DIR/arith $BENCH_DIR/arith.s
+    time $BENCH_DIR/arith
+    ;;
+  instructions)
+    echo "instructions emitted for programs/source"
+    total=0
+    for f in ./programs/source/test_*.c; do
+      cp $f $BENCH_DIR/
+      ./bin/main -S $BENCH_DIR/$(basename $f) 2> /dev/null || continue
+      count=$(grep -c $'^\t[a-z]' $BENCH_DIR/$(basename $f .c).s)
+      echo "$(basename $f): $count"
+      total=$((total + count))
+    done
+    echo "total: $total"
+    ;;
+  *)
+    echo "Usage: ./bench.sh scan|strings|ast|layout|parse|symbols|members|registers|switch|arith|instructions [lines]"
+    exit 1
+    ;;
+esac
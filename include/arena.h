@@ -0,0 +1,39 @@
+#ifndef ARENA_H
+#define ARENA_H
+
+#include <stdio.h>
+#include <stdlib.h>
+
+#include "error.h"
+
+// Size of one block of an arena, larger requests get a block of their own
+#define ARENA_BLOCK_SIZE 65536
+
+typedef struct arena_block {
+    struct arena_block* next;
+    size_t size;                // Usable bytes in data
+    size_t used;
+    char data[];
+} t_arena_block;
+
+// Bump-pointer allocator. Objects are never freed one by one, the whole
+// arena is reset once its objects are dead. Blocks are kept over a
+// reset, so the arena only grows to its largest use between two resets.
+typedef struct arena {
+    t_arena_block* first;
+    t_arena_block* current;     // Block allocations are taken from
+
+    long allocations;           // Number of allocations ever made
+    size_t allocated;           // Bytes ever allocated
+    size_t in_use;              // Bytes allocated since the last reset
+    size_t peak;                // Largest in_use before a reset
+    size_t reserved;            // Bytes held in blocks
+} t_arena;
+
+// Return size bytes of zeroed memory from the arena.
+void* arena_alloc(t_arena* a, size_t size);
+
+// Release every object of the arena at once, keeping the blocks.
+void arena_reset(t_arena* a);
+
+#endif
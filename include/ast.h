@@ -9,6 +9,13 @@
 #include "symbol.h"
 #include "definitions.h"
 #include "types.h"
+#include "arena.h"
+#include "compact_ast.h"
+#include "ir.h"
+
+// Nodes are taken from ast_arena, which is reset after each function
+// has been generated. Nothing may keep a node beyond that.
+extern t_arena ast_arena;
 
 // Ast generation functions
 t_astnode* make_astnode(int op, int type, t_astnode* left, t_astnode* right, t_symbol_entry* symbol, int value);
@@ -33,12 +40,25 @@ void match(int t, char* to_match);
 */
 t_astnode* modify_types(t_astnode* tree, int rtype, int op);
 
+/*
+    Give every node of the tree its Sethi-Ullman number, the registers
+    needed to evaluate it, and mark the nodes whose evaluation has side
+    effects. The code generator evaluates the costlier operand first
+    when neither has side effects. Return the number of the root.
+*/
+int label_ast(t_astnode* tree);
+
 /*
     Externally defined
 */
 
 // Expressions
 t_astnode* binary_expression(void);
+
+// Parse an expression that has an integer value at compile time: literals,
+// enum values, sizeof, casts and the unary and binary operators except
+// assignment. Return the value.
+int constant_expression(void);
 t_astnode* function_calls(void);
 
 // Statements
@@ -60,6 +80,9 @@ t_astnode* if_statement(void);
 
 // Declarations
 
+// Set by -P: functions are parsed but no code is generated for them
+extern int parse_only;
+
 // <function_declaration> ::= <type> <identifier> '(' <parameter_list> ')'
 //                          | <type> <identifier> '(' <parameter_list> ')' <compound_statement>
 t_symbol_entry* function_declaration(
@@ -69,30 +92,26 @@ t_symbol_entry* function_declaration(
         int class
         );
 
-// <var_declaration_list> ::= <epsilon>
-//                           | <variable_declaration>
-//                           | <variable_declaration> ',' <var_declaration_list>
-int var_declaration_list(t_symbol_entry* function_symbol, int class, int separator, int end_token);
-
 // Parses global variables or functions
 void global_declarations(void);
 
-// Parses declaration of a variable or an array
-// <var_declaration> ::= <type> <identifier>
-//                     | <type> <identifier> '[' <int> ']'
-t_symbol_entry* var_declaration(int type, t_symbol_entry* ctype, int class);
-
 // Types
 int inttype(int type);
 int parse_type(t_symbol_entry** ctpye, int* class);
 
+// Return true if the current token starts a type name, a type keyword
+// or a typedef.
+int is_type_name(void);
+
+// Parse the type name of a cast or sizeof: a type followed by stars.
+int parse_type_name(t_symbol_entry** ctype);
+
 // Generation
-int generate_ast(t_astnode* n,
-                 int if_label,
-                 int loop_start_label,
-                 int loop_end_label,
-                 int parent_ast_op);
+t_ir_function* lower_function(t_astnode* n);
+t_ir_function* compact_lower_function(t_ast_index n);
+void generate_ir(t_ir_function* fn);
 int generate_global_string(char* text);
+void clear_global_strings(void);
 int label(void);
 
 // <expression_list> ::= <epsilon>
@@ -108,7 +127,12 @@ int declaration_list(
 );
 
 // Debugging
+
+// Set by -T: the tree of every function is printed to stdout
+extern int print_syntax_tree;
+
 extern void print_ast(t_astnode* root, int depth);
+extern void print_compact_ast(t_ast_index root, int depth);
 
 extern t_token token;
 extern int current_function_id;
@@ -7,9 +7,11 @@
 #include "definitions.h"
 #include "symbol.h"
 #include "types.h"
+#include "regalloc.h"
+#include "output.h"
 
-#define NUM_FREE_REGISTERS 4        // Registers that can be used freely by the program
-#define FIRST_PARAMETER_REGISTER 9  // Register that is the first one used for parameters (according to calling convention)
+#define FIRST_PARAMETER_REGISTER R_RDI  // Register that is the first one used for parameters (according to calling convention)
+#define NUM_PARAMETER_REGISTERS 6       // Parameters passed in registers, the others are on the stack
 
 // Generates a label to which a jump can be executed.
 void cglabel(int l);
@@ -27,6 +29,9 @@ void cgpostamble(void);
 // Returns the index of the register into which the value was loaded.
 int cgloadint(int value);
 
+// Load integer value into register r, zero by xorl.
+void cgmoveint(int value, int r);
+
 // Load value from a variable into a register.
 // Returns the index of the register in which the value was loaded.
 int cgloadglob(t_symbol_entry* symbol, int op);
@@ -42,10 +47,20 @@ int cgloadlocal(t_symbol_entry* symbol, int op);
 // Store the value of a local variable into a register.
 int cgstorelocal(int r, t_symbol_entry* symbol);
 
+// Store a constant into a variable or through the pointer in register r,
+// without a register for the value.
+void cgstorelocalconst(int value, t_symbol_entry* symbol);
+void cgstoreglobconst(int value, t_symbol_entry* symbol);
+void cgstorderefconst(int value, int r, int type);
+
 // Widen a value in register from oldtype to newtype.
 // Return register which contains original value converted to newtype.
 int cgwiden(int r, int oldtype, int newtype);
 
+// Cut the value in register r to the size of type and extend it back
+// as a load of a variable of that type would. Return the register.
+int cgtruncate(int r, int type);
+
 // Generate a global symbol that holds a value (byte/long/quad).
 void cgglobsym(t_symbol_entry* symbol);
 
@@ -66,10 +81,27 @@ int cgmul(int r1, int r2);
 // a register which holds the result.
 int cgdiv(int r1, int r2);
 
+// The remainder of the same division, in register r1.
+int cgmod(int r1, int r2);
+
+// Multiply register r by a constant in place and return r, by shifts
+// and lea where the constant allows.
+int cgmulconst(int r, int value);
+
+// Divide register r by a nonzero constant in place, or with A_MOD take
+// the remainder, and return r. Powers of two are shifted, other divisors
+// multiplied by their magic number.
+int cgdivconst(int ASTop, int r, int value);
+
 // Subtract value in register r1 by the value in register r2 and return index of
 // a register which holds the result.
 int cgsub(int r1, int r2);
 
+// Apply A_ADD, A_SUBTRACT, A_MULTIPLY, A_DIVIDE, A_MOD, A_AND, A_OR or
+// A_XOR with a constant right operand to register r in place and return
+// r. A divisor must not be zero.
+int cgarithconst(int ASTop, int r, int value);
+
 // Load the address of an identifier into a register and return this register.
 int cgaddress(t_symbol_entry* symbol);
 
@@ -77,7 +109,17 @@ int cgaddress(t_symbol_entry* symbol);
 // a register which contains this value.
 int cgderef(int r, int type);
 
-// Setup assembly code for entering a function
+// Copy parameter number position out of its register and return the
+// copy. The register must not have been written since the function was
+// entered, see cgholdparameter().
+int cgparameter(int position);
+
+// Keep the register of parameter number position from being handed
+// out until cgparameter() reads it.
+void cgholdparameter(int position);
+
+// Setup assembly code for entering a function. Only the parameters and
+// locals that are not kept in registers get a stack slot.
 void cgfunctionpreamble(t_symbol_entry* symbol);
 
 // Clean-up code for returning from a function
@@ -89,12 +131,19 @@ int cgshlconst(int r, int val);
 int cgcompare_and_set(int ASTop, int r1, int r2);
 int cgcompare_and_jump(int ASTop, int r1, int r2, int label);
 
-// Freeing all registers.
-void free_all_registers(void);
+// Compare register r with a constant and set a new register to 0 or 1.
+int cgcompare_const_and_set(int ASTop, int r, int value);
+
+// Compare register r with a constant and, like cgcompare_and_jump(),
+// jump to label unless the comparison holds.
+int cgcompare_const_and_jump(int ASTop, int r, int value, int label);
+
+// Jump through a table of count labels indexed by the value in reg
+// minus low. Values outside the table go to default_label.
+void cgjumptable(int reg, int low, int count, int* caselabel, int default_label);
 
 void generate_preamble();
 void generate_postamble();
-void generate_free_registers();
 void generate_printint(int reg);
 
 // Return the size of a primitive type in bytes
@@ -103,8 +152,16 @@ int cgprimsize(int type);
 // Calls a function with the given id
 int cgcall(t_symbol_entry* symbol, int argc);
 
-// Emits assembly instructions for returning from a function
+// Moves the return value into place, the jump to the end label is
+// left to the caller
 void cgreturn(int reg, t_symbol_entry* symbol);
+void cgreturnconst(int value, t_symbol_entry* symbol);
+
+// Copy register r1 into register r2.
+void cgmove(int r1, int r2);
+
+// Copy register r into a new register and return it.
+int cgcopy(int r);
 
 
 void cgglobstr(int label, char* text);
@@ -128,6 +185,8 @@ int cggreaterequal(int r1, int r2);
 
 void cg_reset_locals(void);
 
+// Dispatch through the switch: routine of cgpreamble(), which scans a
+// table of (value, label) pairs. Only used with -linear-switch.
 void cgswitch(int reg,
               int case_count,
               int top_label,
@@ -138,6 +197,7 @@ void cgswitch(int reg,
 int cg_get_local_offset(int type, int isparam);
 
 void cg_copy_argument(int r, int arg_position);
+void cg_copy_argument_const(int value, int arg_position);
 
 // Gets the size for a primitive type
 int get_primitive_size(int type);
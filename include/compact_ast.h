@@ -0,0 +1,46 @@
+#ifndef COMPACT_AST_H
+#define COMPACT_AST_H
+
+#include <stdio.h>
+#include <stdlib.h>
+
+#include "definitions.h"
+#include "error.h"
+
+// Compact layout of the tree of one function. Nodes are stored in
+// pre-order, one column per field, so that a walk over the tree reads
+// the arrays front to back. Children are 32-bit indices into the
+// columns, index 0 stands for no node.
+typedef unsigned int t_ast_index;
+
+// Symbol of a node, or the case table of an A_SWITCH, as in t_astnode
+typedef union ast_reference {
+    t_symbol_entry* symbol;
+    t_case_table* cases;
+} t_ast_reference;
+
+typedef struct compact_ast {
+    unsigned short* op;
+    unsigned char* rvalue;
+    int* type;
+    int* value;                 // value, or size for A_SCALE and A_GLUE
+    unsigned char* need;        // Sethi-Ullman number, at most 255
+    unsigned char* side_effects;
+    t_ast_index* left;
+    t_ast_index* middle;
+    t_ast_index* right;
+    t_ast_reference* reference;
+    t_ast_index count;          // Nodes in use, including node 0
+    t_ast_index capacity;
+} t_compact_ast;
+
+extern t_compact_ast compact_ast;
+
+// Set by -C: functions are printed and generated from the compact layout
+extern int compact_ast_layout;
+
+// Replace the contents of compact_ast by a copy of the given tree.
+// Return the index of its root.
+t_ast_index compact_ast_build(t_astnode* root);
+
+#endif
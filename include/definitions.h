@@ -10,6 +10,7 @@ enum {
     A_SUBTRACT,
     A_MULTIPLY,
     A_DIVIDE,
+    A_MOD,                  // '%' operator
     A_EQUALS,
     A_NOT_EQUAL,
     A_LESS_THAN,
@@ -38,6 +39,8 @@ enum {
     A_OR,                   // '|' operator
     A_AND,                  // '&' operator
     A_LOGIC_NOT,            // '!' operator
+    A_LOGIC_AND,            // '&&' operator
+    A_LOGIC_OR,             // '||' operator
 
     A_POST_DECREMENT,       // <id>--
     A_POST_INCREMENT,       // <id>++
@@ -125,20 +128,56 @@ typedef struct symbol_table {
         int offset;                 // Negative offset of base pointer for local variables
     };
 
+    int variable;                   // Index of a local or parameter kept in
+                                    // registers, -1 if it stays in memory (ssa.c)
+
 
     int* initializer_list;          // Scalars have one initial value
     // Arrays have several initial values
 
     struct symbol_table *next;      // Next symbol in list
     struct symbol_table *member;    // Parameter of function, struct, union, enum, ...
+    struct symbol_list *members;    // Index of the members of a struct or union by name
 
 } t_symbol_entry;
 
+// Slot of the hash index of a symbol list. A slot written before the
+// list was last cleared belongs to an older generation and counts as empty.
+typedef struct symbol_slot {
+    t_symbol_entry* entry;
+    unsigned int hash;
+    unsigned int generation;
+} t_symbol_slot;
+
+// The entries stay linked in declaration order, names are looked up
+// through an open-addressing index with linear probing.
 typedef struct symbol_list {
     t_symbol_entry *head;
     t_symbol_entry *tail;
+
+    t_symbol_slot* slots;
+    unsigned int capacity;          // Number of slots, a power of two
+    unsigned int count;             // Live entries in the index
+    unsigned int generation;        // Incremented on every clear
+
+    long lookups;                   // Statistics for -v
+    long probes;
+    long longest_probe;
 } t_symbol_list;
 
+// Value of a case label and the position of its A_CASE node among the
+// cases of the switch, default excluded
+typedef struct case_label {
+    int value;
+    int position;
+} t_case_label;
+
+// Case labels of a switch in ascending order of value
+typedef struct case_table {
+    int count;
+    t_case_label* labels;
+} t_case_table;
+
 // Sructure used in the Abstract-Systax Tree (AST).
 typedef struct astnode {
     int op;
@@ -147,11 +186,16 @@ typedef struct astnode {
     struct astnode* left;
     struct astnode* middle;
     struct astnode* right;
-    t_symbol_entry* symbol;
+    union {
+        t_symbol_entry* symbol;
+        t_case_table* cases;    // For A_SWITCH, the sorted case labels
+    };
     union {
         int value;              // For A_INTLIT, the integer value
         int size;               // For A_SCALE, the size to scale by
     };
+    int need;                   // Registers to evaluate the tree, set by label_ast()
+    int side_effects;           // Nonzero if the tree stores, calls or jumps
 } t_astnode;
 
 #endif
\ No newline at end of file
@@ -3,22 +3,29 @@
 
 #include "ast.h"
 #include "code_generation.h"
+#include "ir.h"
 
 
-/*
-    Given AST, the register (if available) that holds
-    the previous rvalue, and the AST op of the parent,
-    generate assembly code.
+// Lower the tree of a function, rooted at its A_FUNCTION node, into
+// the IR, see src/ir/lower.c.
+t_ir_function* lower_function(t_astnode* n);
 
-    Return register index with the tree's final value.
-*/
-int generate_ast(t_astnode* n,
-                 int if_label,
-                 int loop_start_label,
-                 int loop_end_label,
-                 int parent_ast_op);
+// The same for a tree in compact_ast, rooted at node n.
+t_ir_function* compact_lower_function(t_ast_index n);
 
+// Emit the x86 code of a function in the IR.
+void generate_ir(t_ir_function* fn);
+
+// Set by -linear-switch: switch statements scan a table at runtime
+// instead of using jump tables and compare trees
+extern int linear_switch;
+
+// Emit a string literal, given by its interned text, unless it was
+// already emitted to this file. Return its label.
 int generate_global_string(char* text);
+
+// Forget the literals emitted so far, called for every new file
+void clear_global_strings(void);
 void generate_global_symbol(t_symbol_entry* symbol);
 
 int label(void);
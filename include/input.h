@@ -0,0 +1,26 @@
+#ifndef INPUT_H
+#define INPUT_H
+
+#include <stdio.h>
+#include <stdlib.h>
+
+#include "error.h"
+
+// Contiguous view of the source that is currently scanned (a file or
+// the expansion of a macro). The scanner walks this buffer with raw
+// pointers instead of pulling every character through stdio.
+typedef struct input_buffer {
+    char* start;            // First character of the input
+    char* end;              // One past the last character of the input
+    char* pos;              // Next character handed out by the scanner
+    size_t capacity;        // Allocated bytes, 0 if the buffer is mapped
+    int mapped;             // Buffer was obtained with mmap()
+} t_input_buffer;
+
+extern t_input_buffer input;
+
+// Map a file into memory and describe it in buffer.
+// Return 0 if the file cannot be opened.
+int input_map_file(char* filename, t_input_buffer* buffer);
+
+#endif
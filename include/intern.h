@@ -0,0 +1,46 @@
+#ifndef INTERN_H
+#define INTERN_H
+
+#include <stdio.h>
+#include <stdlib.h>
+
+#include "error.h"
+
+// Process-wide pool of strings. Every identifier, file name and string
+// literal is stored once, so two interned strings are equal exactly
+// when their addresses are.
+
+#define INTERN_TABLE_SIZE   4096    // Initial slots of the pool, power of two
+#define INTERN_BLOCK_SIZE   65536   // Characters are taken from blocks of this size
+
+typedef struct intern_entry {
+    char* string;               // 0-terminated, NULL for a free slot
+    unsigned int hash;
+    int length;
+} t_intern_entry;
+
+typedef struct intern_pool {
+    t_intern_entry* entries;
+    unsigned int capacity;
+    unsigned int count;         // Distinct strings
+
+    char* block;                // Characters of new strings are taken from here
+    size_t block_left;
+
+    long requests;              // Calls of intern()
+    size_t requested_bytes;     // Bytes the requests would have copied
+    size_t interned_bytes;      // Bytes actually stored
+} t_intern_pool;
+
+extern t_intern_pool intern_pool;
+
+// Return the interned copy of the length characters at s.
+char* intern(char* s, int length);
+
+// Return the interned copy of a 0-terminated string.
+char* intern_string(char* s);
+
+// Print the bytes stored by the pool against the bytes requested to stderr.
+void report_intern_statistics(char* filename);
+
+#endif
@@ -3,6 +3,15 @@
 
 #include "ast.h"
 
-int interpret_ast(t_astnode* n);
+// Apply operator op of a node to constant operands, the right one is
+// ignored by unary operators. Return 0 if there is no constant result:
+// op is not folded, divides by zero or the value does not fit an int.
+int evaluate_operator(int op, int left, int right, int* result);
 
-#endif
\ No newline at end of file
+// Fold the constant operators of a function tree into literals, apply
+// the identities x * 1, x + 0, x << 0, x ^ x and the like, and drop if
+// statements with a constant condition and loops that never run.
+// Return the tree.
+t_astnode* fold_ast(t_astnode* n);
+
+#endif
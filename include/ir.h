@@ -0,0 +1,192 @@
+#ifndef IR_H
+#define IR_H
+
+#include <stdio.h>
+#include <stdlib.h>
+
+#include "definitions.h"
+#include "arena.h"
+#include "error.h"
+
+// Three-address intermediate representation of one function. The tree
+// of a function is lowered into instructions on virtual registers,
+// grouped into basic blocks that end in exactly one terminator. The
+// blocks form the control flow graph, the x86 emitters walk them in
+// layout order.
+
+enum {
+    IR_CONST = 1,       // dst = value
+    IR_COPY,            // dst = src1
+    IR_STRING,          // dst = address of string literal L<value>
+    IR_ADDRESS,         // dst = address of the global symbol
+    IR_PARAM,           // dst = parameter symbol number value, passed in a register,
+                        //   only at the start of the entry block
+    IR_LOAD_LOCAL,      // dst = local or parameter symbol, value is the
+    IR_LOAD_GLOBAL,     //   A_PRE_ or A_POST_ increment applied, or 0
+    IR_STORE_LOCAL,     // symbol = src1
+    IR_STORE_GLOBAL,
+    IR_LOAD,            // dst = *src1, type is the type of the pointer
+    IR_STORE,           // *src2 = src1, type is the type stored
+
+    IR_ADD,             // dst = src1 op src2
+    IR_SUB,
+    IR_MUL,
+    IR_DIV,
+    IR_MOD,
+    IR_SHL,
+    IR_SHR,
+    IR_AND,
+    IR_OR,
+    IR_XOR,
+    IR_EQ,              // dst = src1 cmp src2, as 0 or 1, in the
+    IR_NE,              //   order of A_EQUALS .. A_GREATER_EQUAL
+    IR_LT,
+    IR_GT,
+    IR_LE,
+    IR_GE,
+    IR_SHL_CONST,       // dst = src1 << value
+    IR_NEG,             // dst = op src1
+    IR_INVERT,
+    IR_LOGIC_NOT,
+    IR_CALL,            // dst = symbol(args[0], .., args[argc - 1])
+    IR_TRUNCATE,        // dst = src1 cut to the size of type and extended back,
+                        //   as a store and load of a variable of the type would
+    IR_PHI,             // dst = args[i] when entered from preds[i], symbol
+                        //   is the variable, only in SSA form
+
+    // Terminators
+    IR_JUMP,            // goto targets[0]
+    IR_BRANCH,          // if (src1 cmp src2) goto targets[0] else targets[1],
+                        //   cmp is value, one of IR_EQ .. IR_GE
+    IR_SWITCH,          // goto targets[i] if src1 == args[i], else targets[argc],
+                        //   args in ascending order
+    IR_RETURN,          // return src1, or nothing if NOREG
+};
+
+typedef struct ir_instr {
+    int op;
+    int dst;                    // Virtual register defined, NOREG if none
+    int src1, src2;             // Operands, NOREG if unused
+    int value;
+    int type;
+    t_symbol_entry* symbol;     // Variable or function
+    int* args;                  // Arguments of IR_CALL and IR_PHI, case values of IR_SWITCH
+    int argc;
+    struct ir_block** targets;  // Successors of a terminator
+    int ntargets;
+    int dead;                   // IR_DEAD_* operands not used after this, set by ir_liveness()
+    struct ir_instr* prev;
+    struct ir_instr* next;
+    struct ir_block* block;
+} t_ir_instr;
+
+#define IR_DEAD_SRC1 1
+#define IR_DEAD_SRC2 2
+
+typedef struct ir_block_list {
+    struct ir_block* block;
+    struct ir_block_list* next;
+} t_ir_block_list;
+
+typedef struct ir_block {
+    int id;                     // Position in the layout
+    int label;
+    t_ir_instr* first;
+    t_ir_instr* last;           // The terminator once the block is complete
+    struct ir_block** preds;
+    int npreds;
+    struct ir_block* next;      // Next block in the layout
+    unsigned long* live_in;     // Virtual registers live across the block edges,
+    unsigned long* live_out;    //   indexed by global_index, set by ir_liveness()
+
+    // Set by ir_dominators()
+    int postorder;              // Position in a depth first postorder walk
+    struct ir_block* idom;      // Immediate dominator, NULL for the entry
+    struct ir_block* dom_child; // First block immediately dominated by this one
+    struct ir_block* dom_sibling;
+    t_ir_block_list* frontier;  // Dominance frontier
+} t_ir_block;
+
+typedef struct ir_function {
+    t_symbol_entry* symbol;
+    t_ir_block* first;          // Blocks in layout order, first is the entry
+    t_ir_block* last;
+    int nblocks;
+    int nvregs;                 // Virtual registers are 0 .. nvregs - 1
+
+    // Set by ir_liveness()
+    int* defs;                  // Number of definitions of each register
+    int* global_index;          // Index into live_in/live_out, -1 if the
+    int nglobals;               //   register never crosses a block edge
+    int* global_vreg;           // Register of every global index
+} t_ir_function;
+
+// Instructions and blocks are taken from ir_arena, which is reset after
+// each function has been generated.
+extern t_arena ir_arena;
+
+// Set by -emit-ir: the IR of every function is printed to stdout
+extern int print_ir;
+
+// Building a function. Instructions are appended to the current block,
+// placing a block makes it the current one and, unless the previous one
+// ended in a terminator, adds a jump to it.
+t_ir_function* ir_begin_function(t_symbol_entry* symbol);
+t_ir_block* ir_new_block(void);
+void ir_place_block(t_ir_block* b);
+int ir_new_vreg(void);
+t_ir_instr* ir_append(int op, int dst, int src1, int src2);
+void ir_jump(t_ir_block* target);
+void ir_branch(int cmp, int src1, int src2, t_ir_block* if_true, t_ir_block* if_false);
+
+// Return the address of operand i of ins, NULL past the last one. The
+// operands are src1, src2 and the arguments of a call or phi, unused
+// ones hold NOREG.
+int* ir_operand(t_ir_instr* ins, int i);
+
+// Editing a finished function. An instruction is created detached, then
+// inserted into block b before pos, or at the end if pos is NULL.
+t_ir_instr* ir_new_instr(int op, int dst, int src1, int src2);
+void ir_insert(t_ir_block* b, t_ir_instr* pos, t_ir_instr* ins);
+void ir_remove(t_ir_instr* ins);
+
+// Close the current function, drop unreachable blocks and link the
+// predecessors. Return the function.
+t_ir_function* ir_end_function(void);
+
+// Compute the predecessors of every block from the terminators.
+void ir_build_cfg(t_ir_function* fn);
+
+// Compute the immediate dominators, the dominator tree and the dominance
+// frontiers of the blocks.
+void ir_dominators(t_ir_function* fn);
+
+// Bring the function into SSA form: the scalar locals and parameters
+// whose address is never taken live in virtual registers, merged by
+// phi instructions where control flow joins. ir_from_ssa() replaces the
+// phis by copies on the incoming edges.
+void ir_to_ssa(t_ir_function* fn);
+void ir_from_ssa(t_ir_function* fn);
+
+// Propagate constants and copies through a function in SSA form: the
+// results known at compile time become constants, branches decided by
+// them become jumps, unreachable blocks are dropped and the uses of
+// copies and of phis that merge a single value use its source.
+void ir_propagate(t_ir_function* fn);
+
+// Print the uses replaced and the branches and blocks removed by
+// ir_propagate() since the last report.
+void report_propagation_statistics(char* filename);
+
+// Compute the definitions of every register, the registers live into and
+// out of every block, and the last uses of the operands.
+void ir_liveness(t_ir_function* fn);
+
+// Return true if register v is set in the bitset.
+#define IR_BIT_WORDS(n)     (((n) + 63) / 64)
+#define IR_TEST(set, i)     (((set)[(i) / 64] >> ((i) % 64)) & 1)
+
+// Print the function in a readable form.
+void ir_dump(t_ir_function* fn, FILE* out);
+
+#endif
@@ -0,0 +1,27 @@
+#ifndef OUTPUT_H
+#define OUTPUT_H
+
+#include <stdio.h>
+#include <stdlib.h>
+
+#include "error.h"
+
+// All assembly goes through this buffer instead of stdio. Text is
+// appended with plain copies, the numbers in it are formatted by hand
+// in emit(), and handed to write() in blocks of OUTPUT_BLOCK_SIZE bytes.
+
+#define OUTPUT_BLOCK_SIZE (1 << 20)
+
+// Append n bytes of text.
+void out_write(const char* s, size_t n);
+
+// Append a string.
+void out_string(const char* s);
+
+// Write all buffered text to outfile. Must be called before outfile is
+// closed.
+void out_flush(void);
+
+extern FILE* outfile;
+
+#endif
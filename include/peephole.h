@@ -0,0 +1,34 @@
+#ifndef PEEPHOLE_H
+#define PEEPHOLE_H
+
+#include <stdio.h>
+#include <stdlib.h>
+
+#include "arena.h"
+#include "error.h"
+
+// Peephole optimization of the assembly of one function. The lines are
+// collected after register allocation as records of mnemonic and
+// operands, rewritten by a few local rules and then written out.
+//
+//   redundant moves        movq %a, %a and movq %b, %a after movq %a, %b
+//   jumps to the next      jmp L or jcc L right before L:
+//   jump threading         jumps to a jmp M go to M directly
+//   compare and branch     setcc, movzbq and a test of the result against
+//                          zero before je/jne become a single jcc
+//   zeroing xors           movq $0, %r becomes xorl %r, %r while the
+//                          flags are not needed
+
+// Start collecting the lines of a function.
+void peephole_begin(void);
+
+// Add the text of n bytes, one or more complete lines.
+void peephole_lines(const char* text, size_t n);
+
+// Rewrite the lines collected and write them to the output.
+void peephole_end(void);
+
+// Print how often every rule fired since the last report.
+void report_peephole_statistics(char* filename);
+
+#endif
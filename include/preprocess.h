@@ -0,0 +1,45 @@
+#ifndef PREPROCESS_H
+#define PREPROCESS_H
+
+#include "scanner.h"
+#include "input.h"
+
+// Integrated preprocessor. Directives are handled while the scanner
+// skips whitespace, included files and macro expansions are pushed as
+// new sources on top of the current one, so tokens flow straight from
+// the source files into the parser.
+
+#define MAX_SOURCES         256     // Nesting of includes and macro expansions
+#define MAX_CONDITIONALS    64      // Nesting of #if groups
+#define MAX_MACRO_ARGS      32
+#define MACRO_TABLE_SIZE    1024    // Buckets of the macro table, power of two
+#define MAX_EVAL_DEPTH      64      // Nesting of macros inside #if expressions
+
+// Start a new translation unit with the given file as current input.
+// Macros of the previous unit are forgotten, files stay cached.
+void pp_start(char* filename);
+
+// Called when the current source is exhausted. Resume the source it
+// was pushed from and return 1, or return 0 at the end of the main file.
+int pp_pop_source(void);
+
+// Return true if the '#' at p is the first character of its line
+// in a file (and thus starts a directive).
+int pp_directive_start(char* p);
+
+// Handle the directive whose '#' has just been read.
+void pp_directive(void);
+
+// If the identifier spelled by [name, name + length) is a macro, push
+// its expansion as the current source and return 1.
+int pp_expand(char* name, int length);
+
+// Nonzero while a token would keep the current file from being
+// recognized as guarded by an include guard.
+extern int pp_guard_watch;
+
+// Tell the preprocessor that the current file contains a token
+// outside of its include guard.
+void pp_token_seen(void);
+
+#endif
@@ -0,0 +1,73 @@
+#ifndef REGALLOC_H
+#define REGALLOC_H
+
+#include <stdio.h>
+#include <stdlib.h>
+
+#include "arena.h"
+#include "error.h"
+
+// Register operands of the code generator are plain ints. Numbers below
+// FIRST_VREG name a physical register, larger numbers are virtual
+// registers. The instructions of a function are buffered until its end,
+// then a linear scan over the live intervals maps every virtual register
+// to a physical one or, if none is left, to a stack slot.
+
+#define NUM_PHYSICAL_REGISTERS 13
+#define FIRST_VREG 16
+
+// Physical registers, in the order of the name tables
+enum {
+    R_R10, R_R11, R_R12, R_R13, R_R9, R_R8, R_RCX,
+    R_RDX, R_RSI, R_RDI, R_RBX, R_R14, R_R15
+};
+
+#define REGISTER_BIT(r) (1u << (r))
+
+#define CALLER_SAVED (REGISTER_BIT(R_R10) | REGISTER_BIT(R_R11) | REGISTER_BIT(R_R9)  \
+                     | REGISTER_BIT(R_R8) | REGISTER_BIT(R_RCX) | REGISTER_BIT(R_RDX) \
+                     | REGISTER_BIT(R_RSI) | REGISTER_BIT(R_RDI))
+#define CALLEE_SAVED (REGISTER_BIT(R_RBX) | REGISTER_BIT(R_R12) | REGISTER_BIT(R_R13) \
+                     | REGISTER_BIT(R_R14) | REGISTER_BIT(R_R15))
+#define ALL_REGISTERS (CALLER_SAVED | CALLEE_SAVED)
+
+// Return a new virtual register of the current function.
+int new_vreg(void);
+
+// Emit one instruction. Besides %d, %l (long), %s and %% the format
+// knows the register operands %R, %D and %B, which print the 64, 32
+// and 8 bit name of the register given as int argument. Outside of a
+// function the line is written at once.
+void emit(const char* fmt, ...);
+
+// The instruction emitted last destroys the given physical registers.
+void emit_clobber(unsigned int registers);
+
+// The instruction emitted last writes physical register r, which keeps
+// its value until the next instruction that clobbers it.
+void emit_hold(int r);
+
+// Register r is live at this point. Nothing is written, the mark only
+// stretches the interval of r, e.g. to the end of a loop.
+void emit_use(int r);
+
+// Start buffering the instructions of function name.
+void regalloc_begin(char* name);
+
+// Emit the frame setup of the current function, with locals bytes of
+// local variables. Spill slots and saved registers are added to it.
+void emit_frame_setup(int locals);
+
+// Emit the frame teardown and return of the current function.
+void emit_frame_teardown(void);
+
+// Allocate the registers of the current function and write it out.
+void regalloc_end(void);
+
+// Print the registers, register pressure and spills of every function
+// generated since the last report.
+void report_register_statistics(char* filename);
+
+extern FILE* outfile;
+
+#endif
@@ -0,0 +1,30 @@
+#ifndef SCAN_KERNELS_H
+#define SCAN_KERNELS_H
+
+// Kernels that find the end of a run of characters of one class.
+// Every kernel is given the span [p, end) and returns a pointer to the
+// first character that does not belong to the run (or end).
+// Vector versions look at 16 (SSE2) or 32 (AVX2) characters per step
+// and fall back to the scalar loop for the tail of the buffer.
+typedef struct scan_kernels {
+    char* name;
+
+    // ' ', '\t', '\n', '\r'. The number of skipped '\n' is stored in newlines.
+    char* (*skip_whitespace)(char* p, char* end, int* newlines);
+
+    // 'a'-'z', 'A'-'Z', '0'-'9', '_'
+    char* (*skip_identifier)(char* p, char* end);
+
+    // '0'-'9'
+    char* (*skip_digits)(char* p, char* end);
+
+    // Body of a string literal, stops at '"', '\\' and '\n'
+    char* (*skip_string)(char* p, char* end);
+} t_scan_kernels;
+
+extern t_scan_kernels scan_kernels;
+
+// Pick the widest kernels the CPU supports.
+void select_scan_kernels(void);
+
+#endif
@@ -7,6 +7,7 @@
 #include <ctype.h>
 
 #include "error.h"
+#include "intern.h"
 
 #define TEXTLEN     512
 
@@ -15,6 +16,7 @@ enum {
     T_MINUS,        // '-'
     T_STAR,         // '*'
     T_SLASH,        // '/'
+    T_PERCENT,      // '%'
     T_SEMICOLON,    // ';'
     T_ASSIGNMENT,   // '='
     T_COLON,        // ':'
@@ -97,13 +99,19 @@ enum {
 typedef struct token {
     int token;
     int value;
+    int offset;         // Offset of the first character of the token in the input buffer
+    int length;         // Number of characters the token spans in the input buffer
+    char* name;         // Interned text of identifiers and string literals
 } t_token;
 
-extern FILE* infile;
 extern int line;
-extern int last_char;
+// Value of the last string literal, escapes resolved
 extern char text[TEXTLEN + 1];
 
+// Interned name of the last identifier or string literal. Symbols are
+// looked up by this handle and compared by address.
+extern char* interned_text;
+
 extern t_token token;
 extern char* infile_name;
 
@@ -4,11 +4,13 @@
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
+#include <stdint.h>
 
 #include "definitions.h"
 #include "error.h"
 
 #define NUM_SYMBOLS 1024
+#define SYMBOL_INDEX_SIZE   16      // Initial slots of a symbol index, power of two
 
 // Linked-list of symbols for global variables and functions
 t_symbol_list *global_symbols;
@@ -30,6 +32,9 @@ t_symbol_list *enum_symbols;
 t_symbol_list *typedef_symbols;
 
 // FUNCTIONS
+// All names passed to the symbol table are interned (see intern.h),
+// lookups compare them by address.
+
 // Add a symbol to a symbol list
 void add_symbol(t_symbol_list* list, t_symbol_entry* s_entry);
 
@@ -88,6 +93,15 @@ t_symbol_entry* find_enum_symbol(char* name);
 t_symbol_entry* find_enum_value(char* name);
 t_symbol_entry* find_typedef_symbol(char* name);
 
+// Index the member list of a struct or union once it is complete
+void index_members(t_symbol_entry* composite);
+
+// Find a member of a struct or union in constant time
+t_symbol_entry* find_member(t_symbol_entry* composite, char* name);
+
+
+// Forget all entries of a list. The index is kept, so this is O(1).
+void clear_symbol_list(t_symbol_list* list);
 
 // Sets parameter list to NULL
 void clear_parameter_symbols(void);
@@ -103,6 +117,9 @@ void copy_function_parameters(int id);
 // Initializes the different lists for the symbols
 void setup_symbol_table(void);
 
+// Print the probe counts of the lookups since the last report to stderr
+void report_symbol_statistics(char* filename);
+
 // EXTERN
 extern void generate_global_symbol(t_symbol_entry* symbol);
 
@@ -4,14 +4,19 @@
 #include <stdio.h>
 #include <stdarg.h>
 #include <stdlib.h>
+#include <unistd.h>
 
 #include "types.h"
 #include "definitions.h"
+#include "scanner.h"
+#include "input.h"
+#include "preprocess.h"
 
 #define TEST_MSG_LENGTH 256
 
 void test_types();
 void test_scanner();
+void test_preprocessor();
 
 void report_test_failed(const char* msg, ...);
 
@@ -0,0 +1,41 @@
+#include <stdio.h>
+
+// More values live at once than there are allocatable registers, some
+// of them across calls, so the allocator has to spill and to save the
+// callee-saved registers it hands out.
+//
+// Expected output:
+// 174540 516853 13575
+
+long bump(long x) {
+    return x * 3 + 1;
+}
+
+long many(long x) {
+    long a; long b; long c; long d; long e; long f; long g; long h;
+    long i; long j; long k; long l; long m; long n; long o; long p;
+
+    a = x + 1; b = x + 2; c = x + 3; d = x + 4;
+    e = x * 5; f = x * 6; g = x * 7; h = x * 8;
+    i = a + b; j = c + d; k = e - f; l = g - h;
+    m = bump(a + e); n = bump(i + k); o = a * b; p = c * d;
+
+    return a + 2 * b + 3 * c + 4 * d + 5 * e + 6 * f + 7 * g + 8 * h
+        + 9 * i + 10 * j + 11 * k + 12 * l + 13 * m + 14 * n + 15 * o + 16 * p;
+}
+
+int main() {
+    long x; long s; long t; long u;
+
+    s = 0;
+    t = 1;
+
+    for (x = -20; x < 20; x++) {
+        u = many(x);
+        s = s + u;
+        t = (t * 31 + u) & 1048575;
+    }
+
+    printf("%ld %ld %ld\n", s, t, many(7) - bump(many(-7)));
+    return 0;
+}
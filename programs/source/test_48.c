@@ -0,0 +1,99 @@
+#include <stdio.h>
+
+// Values merged at join points (phis), variables swapped inside a loop,
+// which needs a parallel copy on the back edge, and locals whose
+// address is taken, which have to stay in memory.
+//
+// Expected output:
+// 102334155 23010 301002
+// 653586 500025
+
+void add_to(long* p, long v) {
+    *p = *p + v;
+}
+
+long fib(long n) {
+    long a; long b; long t; long i;
+
+    a = 0;
+    b = 1;
+
+    for (i = 0; i < n; i++) {
+        t = a;
+        a = b;
+        b = t + b;
+    }
+
+    return a;
+}
+
+long rotate(long n) {
+    long x; long y; long z; long t; long i;
+
+    x = 1;
+    y = 2;
+    z = 3;
+
+    for (i = 0; i < n; i++) {
+        t = x;
+        x = y;
+        y = z;
+        z = t;
+        if ((i & 3) == 1) {
+            x = x * 10;
+        }
+    }
+
+    return x * 10000 + y * 100 + z;
+}
+
+long pick(long c, long v) {
+    long r;
+
+    if (c > 0) {
+        r = v * 2;
+    } else {
+        if (c < 0) {
+            r = v - 7;
+        } else {
+            r = 0;
+        }
+    }
+
+    while (r > 100) {
+        r = r / 3;
+    }
+
+    return r + c;
+}
+
+long memory(long n) {
+    long total; long kept; long* p; long i;
+
+    total = 0;
+    kept = 5;
+    p = &kept;
+
+    for (i = 0; i < n; i++) {
+        add_to(&total, i);
+        *p = *p + 1;
+        total = total + kept;
+    }
+
+    return total * 1000 + kept;
+}
+
+int main() {
+    long i; long s;
+
+    s = 0;
+
+    for (i = -5; i < 60; i++) {
+        s = s * 3 + pick(i, i * i);
+        s = s & 1048575;
+    }
+
+    printf("%ld %ld %ld\n", fib(40), rotate(7), rotate(8));
+    printf("%ld %ld\n", s, memory(20));
+    return 0;
+}
@@ -0,0 +1,133 @@
+#include <stdio.h>
+
+// Comparison results that are stored and then tested, which the
+// peephole optimizer fuses into conditional jumps unless the result is
+// still needed, and nested branches and loops whose jumps land on other
+// jumps and get threaded.
+//
+// Expected output:
+// 650524 10 969
+// 1006 53
+
+int g;
+int h;
+
+int relations(int a, int b) {
+    int lt; int le; int gt; int ge; int eq; int ne; int r;
+
+    r = 0;
+    lt = a < b;
+    if (lt) { r = r + 1; }
+    le = a <= b;
+    if (le) { r = r + 2; }
+    gt = a > b;
+    if (gt) { r = r + 4; }
+    ge = a >= b;
+    if (ge) { r = r + 8; }
+    eq = a == b;
+    if (eq) { r = r + 16; }
+    ne = a != b;
+    if (ne) { r = r + 32; }
+
+    return r;
+}
+
+// The stored comparison is still needed after the branch
+int kept(int a, int b) {
+    int c;
+
+    c = a < b;
+    if (c) {
+        g = g + 1;
+    }
+
+    return c * 100 + g;
+}
+
+int nested(int a, int b, int c) {
+    int r;
+
+    r = 0;
+
+    if (a > 0) {
+        if (b > 0) {
+            if (c > 0) {
+                r = 1;
+            } else {
+                r = 2;
+            }
+        } else {
+            r = 3;
+        }
+    } else {
+        if (b == c) {
+            r = 4;
+        }
+    }
+
+    return r;
+}
+
+int loops(int n) {
+    int i; int j; int s;
+
+    s = 0;
+
+    for (i = 0; i < n; i++) {
+        j = 0;
+        while (j < i) {
+            if (j == 5) {
+                j = i;
+            } else {
+                if ((i & 1) == 0) {
+                    j++;
+                } else {
+                    s = s + i * j;
+                    j++;
+                }
+            }
+        }
+    }
+
+    return s;
+}
+
+// Jumps out of the inner ifs land on the jump back to the loop head
+int climb(int limit) {
+    h = 1;
+
+    while (h < limit) {
+        while ((h & 7) != 0) {
+            h = h + 1;
+        }
+        h = h + 5;
+        if (h > 500) {
+            if (h > 700) {
+                h = h + 1;
+            }
+        }
+    }
+
+    return h;
+}
+
+int main() {
+    int a; int b; int c; int s;
+
+    s = 0;
+
+    for (a = -2; a < 3; a++) {
+        for (b = -2; b < 3; b++) {
+            s = s * 7 + relations(a, b) + kept(a, b);
+            s = s & 1048575;
+            for (c = -1; c < 2; c++) {
+                s = s * 5 + nested(a, b, c);
+                s = s & 1048575;
+            }
+        }
+    }
+
+    printf("%d %d %d\n", s, g, loops(20));
+    printf("%d %d\n", climb(1000), climb(50));
+    return 0;
+}
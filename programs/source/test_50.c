@@ -0,0 +1,82 @@
+#include <stdio.h>
+
+// '%' and multiply, divide and modulo by constants, which are strength
+// reduced, checked against the same operations on divisors read from
+// globals at runtime.
+//
+// Expected output:
+// -3 -1 -1 -7 3 -1
+// -666 -2 -2 0
+// 85210 0
+// 3474 249000
+
+int d2; int d3; int d4; int d5; int d7; int d8; int d10; int d16; int d1000; int dm3; int dm8;
+int m3; int m5; int m7; int m9; int m10; int m12; int m24; int mm1; int mm4;
+int checked; int wrong;
+
+int check(int got, int expected) {
+    checked++;
+
+    if (got != expected) {
+        wrong++;
+    }
+
+    return got;
+}
+
+long divide(int x) {
+    long s;
+    s = 0;
+    s = s + check(x / 2, x / d2) + check(x % 2, x % d2);
+    s = s + check(x / 3, x / d3) + check(x % 3, x % d3);
+    s = s + check(x / 4, x / d4) + check(x % 4, x % d4);
+    s = s + check(x / 5, x / d5) + check(x % 5, x % d5);
+    s = s + check(x / 7, x / d7) + check(x % 7, x % d7);
+    s = s + check(x / 8, x / d8) + check(x % 8, x % d8);
+    s = s + check(x / 10, x / d10) + check(x % 10, x % d10);
+    s = s + check(x / 16, x / d16) + check(x % 16, x % d16);
+    s = s + check(x / 1000, x / d1000) + check(x % 1000, x % d1000);
+    s = s + check(x / -3, x / dm3) + check(x % -3, x % dm3);
+    s = s + check(x / -8, x / dm8) + check(x % -8, x % dm8);
+    return s;
+}
+
+int multiply(int x) {
+    int s;
+    s = check(x * 0, 0) + check(x * 1, x) + check(x * 2, x + x);
+    s = s + check(x * 3, x * m3) + check(x * 5, x * m5) + check(x * 7, x * m7);
+    s = s + check(x * 9, x * m9) + check(x * 10, x * m10) + check(x * 12, x * m12);
+    s = s + check(x * 24, x * m24) + check(x * -1, x * mm1) + check(x * -4, x * mm4);
+    return s;
+}
+
+int main() {
+    int x; int i; long total; int products;
+
+    d2 = 2; d3 = 3; d4 = 4; d5 = 5; d7 = 7; d8 = 8; d10 = 10; d16 = 16; d1000 = 1000; dm3 = -3; dm8 = -8;
+    m3 = 3; m5 = 5; m7 = 7; m9 = 9; m10 = 10; m12 = 12; m24 = 24; mm1 = -1; mm4 = -4;
+
+    x = -7;
+    printf("%d %d %d %d ", x / 2, x % 2, x / 4, x % 8);
+    printf("%d %d\n", x / -2, x % -2);
+
+    x = -2000;
+    printf("%d %d %d %d\n", x / 3, x % 3, x % 1000 / 1000 - 2, x % 16);
+
+    total = 0;
+    products = 0;
+
+    for (x = -1000; x <= 1500; x++) {
+        total = total + divide(x);
+        products = products + multiply(x) % 1000;
+    }
+
+    for (i = 0; i < 4; i++) {
+        x = 2000000000 + i * 47483647;
+        total = total + divide(x) + divide(-x);
+    }
+
+    printf("%d %d\n", checked, wrong);
+    printf("%ld %d\n", total % 10000, products);
+    return 0;
+}
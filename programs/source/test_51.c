@@ -0,0 +1,71 @@
+#include <stdio.h>
+
+// '&&' and '||' evaluate their right operand only when the left one
+// does not decide, as values and as conditions.
+//
+// Expected output:
+// 547573 99 538498
+// 440
+
+int calls;
+int trace;
+int zero;
+
+int t(int v) {
+    calls++;
+    trace = (trace * 7 + v + 1) % 1000003;
+    return v;
+}
+
+int main() {
+    int a; int b; int r; int s; int n; int i;
+
+    r = 0;
+
+    for (a = 0; a < 3; a++) {
+        for (b = 0; b < 3; b++) {
+            r = r * 3 + (t(a) && t(b));
+            r = r * 3 + (t(a) || t(b));
+            r = r * 3 + (t(a) && (t(b) || t(2)));
+            r = r % 1000003;
+
+            if (t(a) && t(b)) {
+                r = r + 1;
+            }
+
+            if (t(a) || t(b)) {
+                r = r + 2;
+            }
+
+            if (!t(a) || t(b) && !t(a - 1)) {
+                r = r + 4;
+            }
+
+            n = b;
+
+            while (n > 0 && t(n)) {
+                n--;
+            }
+        }
+    }
+
+    printf("%d %d %d\n", r, calls, trace);
+
+    // The right operand would divide by zero
+    s = 0;
+
+    for (i = 0; i < 4; i++) {
+        if (zero != 0 && 100 / zero > 3) {
+            s = s + 1;
+        }
+
+        if (zero == 0 || 100 / zero > 3) {
+            s = s + 10;
+        }
+
+        s = s + (zero && 100 / zero) + (!zero || 100 / zero) * 100;
+    }
+
+    printf("%d\n", s);
+    return 0;
+}
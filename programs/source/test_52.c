@@ -0,0 +1,68 @@
+#include <stdio.h>
+
+// Constant folding and algebraic identities: x - x and x * 0 for a
+// side-effect-free x, x * 0 where x has a side effect that must still
+// happen, and p + 0 that keeps the pointer type for later arithmetic.
+//
+// Expected output:
+// -290987703 7
+// 3451
+
+long* malloc(long size);
+
+int calls;
+
+int counted(int x) {
+    calls++;
+    return x;
+}
+
+int identities(int x) {
+    int a; int b; int c; int d; int e;
+
+    a = x - x;
+    b = x * 0 + 0 * x;
+    c = x * 1 + 0 + (x + 0) * 1 - x / 1;
+    d = counted(x) * 0;
+    e = (2 + 3) * 4 - 20 / 3 + (1 << 4) - (7 % 4) + x * (8 - 8);
+
+    return a * 10000 + b * 1000 + c * 100 + d * 10 + e;
+}
+
+// Each step only lands on a member if p + 0 is still a long*
+long pointers(long* p) {
+    long* first; long* third; long* last; long v;
+
+    first = p + 0;
+    third = (p + 0) + 2;
+    last = 0 + third + 1 - 0;
+    v = *first * 1000 + *third * 100 + *last * 10;
+    first = first + 1;
+    v = v + *first;
+
+    return v;
+}
+
+int main() {
+    int x; long s; long* cells; long* p;
+
+    s = 0;
+
+    for (x = -3; x < 4; x++) {
+        s = s * 10 + identities(x);
+    }
+
+    printf("%ld %d\n", s, calls);
+
+    cells = malloc(32);
+    p = cells;
+    *p = 3;
+    p = p + 1;
+    *p = 1;
+    p = p + 1;
+    *p = 4;
+    p = p + 1;
+    *p = 5;
+    printf("%ld\n", pointers(cells));
+    return 0;
+}
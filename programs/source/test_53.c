@@ -0,0 +1,73 @@
+#include <stdio.h>
+
+// Constant expressions with enum values, sizeof and casts in array
+// sizes, global initializers, enum values and case labels.
+//
+// Expected output:
+// 688662 8 36 -4
+// 1 4 8 8 16 16 68 4
+// 97 98 127 0 7
+// 9200869 1 -3 4 8 9200869000
+// 32
+
+enum { SHIFT = 3, SIZE = 1 << SHIFT, MASK = SIZE - 1, BIG = SIZE * 4 + (sizeof(long) >> 1), NEG = -5, NEXT };
+
+struct pair {
+    long a;
+    long b;
+};
+
+typedef struct pair pair_t;
+
+int table[SIZE * 2 + 1] = { 1 << SHIFT, SIZE | 1, ~MASK & 255, sizeof(int) * 3, (char)300, -7 / 2, 17 % 5, NEG };
+int sizes[] = { sizeof(char), sizeof(int), sizeof(long), sizeof(int*), sizeof(struct pair), sizeof(pair_t), sizeof table, sizeof(table[0]) };
+char bytes[MASK] = { 'a', (char)(256 + 'b'), 127 };
+int one = (1 < 2) && (3 > 2 || 0);
+long scaled = (long)(-1) * 3;
+int size;
+
+int classify(int x) {
+    switch (x) {
+        case NEG: return 100;
+        case NEG + 1: return 101;
+        case -1: return 102;
+        case SIZE * 2: return 103;
+        case sizeof(long): return 104;
+        case 'a' - 'A': return 105;
+    }
+
+    return 0;
+}
+
+int main() {
+    int i; int s; long w;
+
+    s = 0;
+
+    for (i = 0; i < sizeof(table) / sizeof(int); i++) {
+        s = (s * 3 + table[i]) % 1000003;
+    }
+
+    printf("%d %d %d %d\n", s, SIZE, BIG, NEXT);
+
+    printf("%d", sizes[0]);
+
+    for (i = 1; i < sizeof(sizes) / sizeof(sizes[0]); i++) {
+        printf(" %d", sizes[i]);
+    }
+
+    printf("\n%d %d %d %d %d\n", bytes[0], bytes[1], bytes[2], bytes[3], sizeof bytes);
+
+    s = 0;
+
+    for (i = -6; i < 40; i++) {
+        s = (s * 7 + classify(i)) % 16777216;
+    }
+
+    w = (long)s * 1000;
+    printf("%d %d %ld %d %d %ld\n", s, one, scaled, sizeof s, sizeof w, w);
+
+    size = sizeof(pair_t) + sizeof(s + w) + sizeof(char*);
+    printf("%d\n", size);
+    return 0;
+}
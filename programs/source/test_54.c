@@ -0,0 +1,104 @@
+#include <stdio.h>
+
+// Constants and copies propagated through the IR: a branch on a
+// constant whose dead side is removed, a switch on a constant selector,
+// loops whose bounds are propagated copies, and values swapped through
+// copies inside a loop.
+//
+// Expected output:
+// 145 156 25 9
+// 201 45 0 0
+
+int g;
+
+int folded(int x) {
+    int n; int m; int i; int s; int debug; int k; int t;
+
+    n = 10;
+    m = n;
+    debug = 0;
+    s = 0;
+    k = 3;
+
+    for (i = 0; i < m; i++) {
+        if (debug) {
+            printf("never %d\n", i);
+            g = g + 1000;
+        }
+        if (k == 3) {
+            s = s + i * k;
+        } else {
+            s = s - 1;
+        }
+        t = k;
+        k = t;
+    }
+
+    if (n > 5 && m == 10 || x) {
+        s = s + n;
+    }
+
+    t = x;
+
+    while (t > 0) {
+        s = s + t;
+        t = t - 1;
+    }
+
+    return s + (debug || x > 2);
+}
+
+int selector(int x) {
+    int k; int s;
+
+    k = 3;
+    s = x;
+
+    switch (k + 1) {
+        case 3: return 1000;
+        case 4: s = s + 7;
+        case 5: s = s * 2;
+    }
+
+    switch (k * k - 9) {
+        default: s = s + 1;
+    }
+
+    return s;
+}
+
+int swapped(int a, int b) {
+    int x; int y; int tmp; int i; int limit;
+
+    x = a;
+    y = b;
+    limit = 5;
+
+    for (i = 0; i < limit; i++) {
+        tmp = x;
+        x = y;
+        y = tmp;
+    }
+
+    return x * 100 + y;
+}
+
+int counted(int n) {
+    int x; int y; int i;
+
+    x = 0;
+    y = 0;
+
+    for (i = 0; i < n; i++) {
+        y = x;
+        x = x + 1;
+    }
+
+    return y * 10 + x;
+}
+
+int main() {
+    printf("%d %d %d %d\n", folded(0), folded(4), selector(5), selector(0 - 3));
+    printf("%d %d %d %d\n", swapped(1, 2), counted(5), counted(0), g);
+    return 0;
+}
@@ -0,0 +1,31 @@
+#include <stdio.h>
+
+// Calls with more than six arguments, so some are passed on the stack,
+// and calls nested inside the argument lists of other calls.
+//
+// Expected output:
+// 204 2774
+// 3 -6
+
+long eight(long a, long b, long c, long d, long e, long f, long g, long h) {
+    return a + 2 * b + 3 * c + 4 * d + 5 * e + 6 * f + 7 * g + 8 * h;
+}
+
+long diff(long a, long b) {
+    return a - b;
+}
+
+int nine(int a, int b, int c, int d, int e, int f, int g, int h, int i) {
+    return (a - b) * (c - d) + (e - f) * (g - h) + i;
+}
+
+int main() {
+    long x; long y;
+
+    x = eight(1, 2, 3, 4, 5, 6, 7, 8);
+    y = eight(diff(10, 1), eight(1, 1, 1, 1, 1, 1, 1, 1), x, diff(x, 100), -5, diff(3, 4), eight(0, 0, 0, 0, 0, 0, 0, 1), x + 1);
+    printf("%ld %ld\n", x, y);
+
+    printf("%d %d\n", nine(9, 8, 7, 6, 5, 4, 3, 2, 1), nine(nine(1, 2, 3, 4, 5, 6, 7, 8, 9), 2, diff(7, 3), 1, 5, nine(0, 0, 0, 0, 0, 0, 0, 0, -3), 8, 6, diff(eight(1, 0, 0, 0, 0, 0, 0, 0), 50)));
+    return 0;
+}
@@ -0,0 +1,32 @@
+#include <stdio.h>
+
+// Division and modulo by runtime values while other values are live,
+// including one in rdx, which the division overwrites.
+//
+// Expected output:
+// -93426
+
+long mix(long a, long b, long c, long d) {
+    long q; long r;
+
+    q = a / b;
+    r = c % d;
+    return q * 1000 + r + a % b + c / d + a + b + c + d;
+}
+
+int main() {
+    long a; long b; long c; long d; long s;
+
+    s = 0;
+
+    for (a = -50; a < 50; a = a + 7) {
+        for (b = 1; b < 12; b = b + 3) {
+            c = a * b - 3;
+            d = b + 2;
+            s = s + mix(a, b, c, d) + mix(c, d, a, 0 - b) + (a / d) * (c % b) + d;
+        }
+    }
+
+    printf("%ld\n", s);
+    return 0;
+}
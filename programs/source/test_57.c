@@ -0,0 +1,112 @@
+#include <stdio.h>
+
+// Switch dispatch over dense case values (jump table), sparse ones
+// (compare tree), negative values and the ends of the int range, a
+// switch with only a default, and fallthrough between cases. The output
+// is the same when compiled with -linear-switch.
+//
+// Expected output:
+// -439464 977855
+// 9 10 2 7 1
+// 0 0 0 0 0
+// -1 -1 7 7
+// 1 11111 11000
+
+int dense(int x) {
+    switch (x) {
+        case 0: return 10;
+        case 1: return 11;
+        case 2: return 12;
+        case 3: return 13;
+        case 4: return 14;
+        case 5: return 15;
+        case 6: return 16;
+        case 8: return 18;
+        case 9: return 19;
+        default: return 0 - 1;
+    }
+
+    return 0;
+}
+
+int sparse(int x) {
+    switch (x) {
+        case -1000000: return 1;
+        case -77: return 2;
+        case -1: return 3;
+        case 0: return 4;
+        case 13: return 5;
+        case 500: return 6;
+        case 4096: return 7;
+        case 1000000: return 8;
+        case 2147483647: return 9;
+        case -2147483647 - 1: return 10;
+    }
+
+    return 0;
+}
+
+int negative(int x) {
+    switch (x) {
+        case -5: return 50;
+        case -4: return 40;
+        case -3: return 30;
+        case -2: return 20;
+        case -1: return 10;
+        case 0: return 0;
+        case 1: return 100;
+    }
+
+    return 7;
+}
+
+int only_default(int x) {
+    int r;
+
+    r = 1;
+
+    switch (x) {
+        default: r = x * 2;
+    }
+
+    return r + 1;
+}
+
+int fallthrough(int x) {
+    int r;
+
+    r = 0;
+
+    switch (x) {
+        case 1: r = r + 1;
+        case 2: r = r + 10;
+        case 3: r = r + 100;
+        case 7: r = r + 1000;
+        case 8: return r + 10000;
+        default: r = r + 100000;
+    }
+
+    return r;
+}
+
+int main() {
+    int x; int s; int t;
+
+    s = 0;
+    t = 0;
+
+    for (x = -12; x < 16; x++) {
+        s = s * 3 + dense(x) + negative(x) + only_default(x);
+        s = s % 1000003;
+        t = t * 7 + fallthrough(x) % 1000;
+        t = t % 1000003;
+    }
+
+    printf("%d %d\n", s, t);
+
+    printf("%d %d %d %d %d\n", sparse(2147483647), sparse(-2147483647 - 1), sparse(-77), sparse(4096), sparse(-1000000));
+    printf("%d %d %d %d %d\n", sparse(2147483646), sparse(-2147483647), sparse(1), sparse(-2), sparse(1000001));
+    printf("%d %d %d %d\n", dense(2147483647), dense(-2147483647 - 1), negative(-2147483647 - 1), negative(2147483647));
+    printf("%d %d %d\n", only_default(0), fallthrough(1), fallthrough(7));
+    return 0;
+}
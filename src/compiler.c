@@ -1,9 +1,16 @@
 #include <stdlib.h>
 #include <errno.h>
 #include <unistd.h>
+#include <time.h>
 
 #include "../include/scanner.h"
+#include "../include/input.h"
+#include "../include/preprocess.h"
+#include "../include/scan_kernels.h"
 #include "../include/ast.h"
+#include "../include/generation.h"
+#include "../include/peephole.h"
+#include "../include/output.h"
 
 #define MAX_OBJECTS 100
 
@@ -28,14 +35,24 @@ enum {
     F_LINK = 0x8,
     F_HELP = 0x400,
     F_VERBOSE = 0x800,
-    F_AST_PRINT = 0x1600
+    F_AST_PRINT = 0x1000,
+    F_SCAN_ONLY = 0x2000,
+    F_COMPACT_AST = 0x4000,
+    F_PARSE_ONLY = 0x8000,
+    F_EMIT_IR = 0x10000,
+    F_LINEAR_SWITCH = 0x20000
 };
 
 const char* usage_string =
-"Usage: ./bcc [-vchST] [-o output_name] file [file ...]\n"
+"Usage: ./bcc [-vchSTLCP] [-emit-ir] [-linear-switch] [-o output_name] file [file ...]\n"
 "       -c generate object files but don't link\n"
 "       -S compile but neither assemble nor link\n"
 "       -T print syntax tree to stdout\n"
+"       -L only scan the input and report tokens per second\n"
+"       -P only parse the input and report syntax tree nodes per second\n"
+"       -C generate code from the compact (struct of arrays) syntax tree\n"
+"       -emit-ir print the intermediate representation to stdout\n"
+"       -linear-switch dispatch switch statements by a runtime table scan\n"
 "       -h print this message to stdout\n"
 "       -v print verbose output of all stages\n";
 
@@ -44,6 +61,7 @@ char* token_names[] = {
     "T_MINUS",
     "T_STAR",
     "T_SLASH",
+    "T_PERCENT",
     "T_INTLIT",
     "T_SEMICOLON",
     "T_PRINT",
@@ -97,15 +115,13 @@ t_symbol_entry* sym_table;
 
 t_symbol_entry* function_id;
 
-FILE* infile;
-
 // File where assembly instructions are printed to
 FILE* outfile;
 
 // Buffer for holding identifiers during scaning
 char text[TEXTLEN+1];
+char* interned_text;
 
-int last_char;
 int line;
 
 int current_function_id;
@@ -116,9 +132,7 @@ int local_next_pos = NUM_SYMBOLS - 1;
 t_token token;
 
 static void init() {
-    last_char = 0;
     line = 0;
-    free_all_registers();
 
     sym_table = (t_symbol_entry*)calloc(sizeof(t_symbol_entry), NUM_SYMBOLS);
 }
@@ -133,6 +147,68 @@ static void scanner_test() {
     }
 }
 
+// Scan the current input without parsing it and report the throughput
+// of the scanner.
+static void scanner_benchmark(char* filename) {
+    struct timespec start, end;
+    long tokens = 0;
+    double seconds;
+
+    clock_gettime(CLOCK_MONOTONIC, &start);
+
+    while (scan(&token) && token.token != T_EOF) {
+        tokens++;
+    }
+
+    clock_gettime(CLOCK_MONOTONIC, &end);
+
+    seconds = (end.tv_sec - start.tv_sec) + (end.tv_nsec - start.tv_nsec) / 1e9;
+    fprintf(stderr, "%s: %ld tokens in %.3fs (%.0f tokens/s, %s kernels)\n",
+            filename, tokens, seconds,
+            seconds > 0 ? tokens / seconds : 0.0, scan_kernels.name);
+}
+
+// Parse the current input without generating code and report the
+// throughput of the parser. Global declarations still write their
+// assembly, which is discarded.
+static void parser_benchmark(char* filename) {
+    struct timespec start, end;
+    long nodes;
+    double seconds;
+
+    if ((outfile = fopen("/dev/null", "w")) == NULL) {
+        fprintf(stderr, "Unable to open /dev/null: %s\n", strerror(errno));
+        exit(1);
+    }
+
+    parse_only = 1;
+    nodes = ast_arena.allocations;
+    clock_gettime(CLOCK_MONOTONIC, &start);
+
+    clear_symbol_table();
+    clear_global_strings();
+    scan(&token);
+    global_declarations();
+
+    clock_gettime(CLOCK_MONOTONIC, &end);
+    out_flush();
+    fclose(outfile);
+
+    nodes = ast_arena.allocations - nodes;
+    seconds = (end.tv_sec - start.tv_sec) + (end.tv_nsec - start.tv_nsec) / 1e9;
+    fprintf(stderr, "%s: %ld AST nodes in %.3fs (%.0f nodes/s)\n",
+            filename, nodes, seconds, seconds > 0 ? nodes / seconds : 0.0);
+}
+
+// Compare the memory the AST arena needed with what one malloc()
+// per node, never freed, would have kept.
+static void report_ast_memory(char* filename) {
+    arena_reset(&ast_arena);
+
+    fprintf(stderr, "%s: %ld AST nodes, %zu bytes allocated, largest function %zu bytes, arena holds %zu bytes\n",
+            filename, ast_arena.allocations, ast_arena.allocated, ast_arena.peak, ast_arena.reserved);
+}
+
 static int process_args(int argc, char** argv, int* last_idx) {
 
     int flags = F_LINK | F_COMPILE | F_ASSEMBLE;
@@ -145,6 +221,16 @@ static int process_args(int argc, char** argv, int* last_idx) {
             break;
         }
 
+        if (strcmp(argv[i], "-emit-ir") == 0) {
+            flags |= F_EMIT_IR;
+            continue;
+        }
+
+        if (strcmp(argv[i], "-linear-switch") == 0) {
+            flags |= F_LINEAR_SWITCH;
+            continue;
+        }
+
         int arg_length = strlen(argv[i]);
 
         for (int j = 1; j < arg_length; j++) {
@@ -173,6 +259,15 @@ static int process_args(int argc, char** argv, int* last_idx) {
                 case 'T':
                     flags |= F_AST_PRINT;
                     break;
+                case 'L':
+                    flags |= F_SCAN_ONLY;
+                    break;
+                case 'C':
+                    flags |= F_COMPACT_AST;
+                    break;
+                case 'P':
+                    flags |= F_PARSE_ONLY;
+                    break;
             }
         }
     }
@@ -192,7 +287,7 @@ char* alter_suffix(const char* str, char n_suffix) {
         return NULL;
     }
 
-    n_str = malloc(sizeof(char)*idx+2);
+    n_str = malloc(sizeof(char) * idx + 3);
     n_str[idx+2] = '\0';
     n_str[idx+1] = n_suffix;
     n_str[idx] = '.';
@@ -207,9 +302,8 @@ char* alter_suffix(const char* str, char n_suffix) {
 // and return name of file that contains assembly code.
 // The new name of the assembled file is the old filename with
 // the suffix replaced by '.s'
-static char* do_compile(char* filename) {
-
-    char cmd[TEXTLEN];
+// The file is preprocessed while it is scanned.
+static char* do_compile(char* filename, int flags) {
 
     char* outfile_name = alter_suffix(filename, 's');
 
@@ -217,27 +311,40 @@ static char* do_compile(char* filename) {
         report_error("Error: Provided file %s has no suffix, use .c\n", filename);
     }
 
-    snprintf(cmd, TEXTLEN, "%s %s %s", "cpp -nostdinc -isystem ", INCDIR, filename);
+    pp_start(filename);
 
-    if ((infile = popen(cmd, "r")) == NULL) {
-        fprintf(stderr, "Unable to open %s: %s\n", filename, strerror(errno));
-        exit(1);
+    if (flags & F_SCAN_ONLY) {
+        scanner_benchmark(filename);
+        return NULL;
     }
 
-    infile_name = filename;
+    if (flags & F_PARSE_ONLY) {
+        parser_benchmark(filename);
+        return NULL;
+    }
 
     if ((outfile = fopen(outfile_name, "w")) == NULL) {
         fprintf(stderr, "Unable to open %s: %s\n", outfile_name, strerror(errno));
         exit(1);
     }
 
-    line = 1;
     clear_symbol_table();
+    clear_global_strings();
     scan(&token);
     generate_preamble();
     global_declarations();
+    out_flush();
     fclose(outfile);
 
+    if (flags & F_VERBOSE) {
+        report_ast_memory(filename);
+        report_symbol_statistics(filename);
+        report_intern_statistics(filename);
+        report_propagation_statistics(filename);
+        report_register_statistics(filename);
+        report_peephole_statistics(filename);
+    }
+
     return outfile_name;
 }
 
@@ -293,9 +400,12 @@ void do_link() {
 
 int main(int argc, char** argv) {
 
+    select_scan_kernels();
+
 #ifdef DEBUG
     test_types();
     test_scanner();
+    test_preprocessor();
 #endif
 
 #ifndef DEBUG
@@ -309,9 +419,18 @@ int main(int argc, char** argv) {
     }
 
     setup_symbol_table();
+    compact_ast_layout = (flags & F_COMPACT_AST) != 0;
+    print_syntax_tree = (flags & F_AST_PRINT) != 0;
+    print_ir = (flags & F_EMIT_IR) != 0;
+    linear_switch = (flags & F_LINEAR_SWITCH) != 0;
 
     while (l_idx < argc) {
-        char* asm_file = do_compile(argv[l_idx]);
+        char* asm_file = do_compile(argv[l_idx], flags);
+
+        if (flags & (F_SCAN_ONLY | F_PARSE_ONLY)) {
+            l_idx++;
+            continue;
+        }
 
         if ((flags & F_LINK) || (flags & F_ASSEMBLE)) {
             char* obj_file = do_assemble(asm_file);
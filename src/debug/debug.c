@@ -4,19 +4,22 @@
     Forward Declarations.
 */
 static char* ast_names[] = {
-    "A_ADD", "A_SUBTRACT", "A_MULTIPLY", "A_DIVIDE",
+    "A_ADD", "A_SUBTRACT", "A_MULTIPLY", "A_DIVIDE", "A_MOD",
     "A_EQUALS", "A_NOT_EQUALS", "A_LESS_THAN", "A_GREATER_THAN",
     "A_LESS_EQUAL", "A_GREATER_EQUAL",
     "A_INTLIT", "A_IDENTIFIER", "A_LVIDENT",
     "A_ASSIGN", "A_PRINT", "A_GLUE", "A_IF", "A_WHILE",
     "A_FOR", "A_FUNCTION", "A_WIDEN", "A_SCALE", "A_FUNCTION_CALL",
     "A_RETURN", "A_ADDR", "A_DEREFERENCE", "A_STRLIT", "A_LSHIFT",
-    "A_RSHIFT", "A_OR", "A_AND", "A_LOGIC_NOT",
+    "A_RSHIFT", "A_OR", "A_AND", "A_LOGIC_NOT", "A_LOGIC_AND", "A_LOGIC_OR",
     "A_POST_DECREMENT", "A_POST_INCREMENT", "A_NEGATE",
     "A_PRE_INCREMENT", "A_PRE_DECREMENT",
-    "A_INVERT", "A_XOR"
+    "A_INVERT", "A_XOR",
+    "A_BREAK", "A_CONTINUE", "A_SWITCH", "A_DEFAULT", "A_CASE"
 };
 
+int print_syntax_tree;
+
 void print_ast(t_astnode* root, int depth) {
 
     if (root == NULL) {return;}
@@ -45,4 +48,36 @@ void print_ast(t_astnode* root, int depth) {
     if (root->right != NULL) {
         print_ast(root->right, root->op == A_WIDEN ? depth : depth+2);
     }
-}
\ No newline at end of file
+}
+
+// Same output as print_ast(), read from the columns of compact_ast
+void print_compact_ast(t_ast_index root, int depth) {
+
+    if (root == 0) {return;}
+
+    char prefBuff[depth+1];
+
+    for (int i = 0; i < depth; i++) {prefBuff[i]='-';}
+    prefBuff[depth] = '\0';
+
+    if (depth > 0) {
+        prefBuff[0] = '|';
+    }
+
+    int op = compact_ast.op[root];
+    char* ast_name = ast_names[op-A_ADD];
+
+    if (compact_ast.rvalue[root]) {
+        printf("%s%s rvalue\n", prefBuff, ast_name);
+    } else {
+        printf("%s%s\n", prefBuff, ast_name);
+    }
+
+    if (compact_ast.left[root] != 0) {
+        print_compact_ast(compact_ast.left[root], op == A_WIDEN ? depth : depth+2);
+    }
+
+    if (compact_ast.right[root] != 0) {
+        print_compact_ast(compact_ast.right[root], op == A_WIDEN ? depth : depth+2);
+    }
+}
@@ -1,22 +1,14 @@
 #include "../include/code_generation.h"
 
 static int local_offset;
-static int stack_offset;
 
 /*
     Forward declarations
 */
 static int allocate_register(void);
-static void free_register(int indx);
 
 static int cgcompare(int r1, int r2, char* how);
 
-static int free_registers[NUM_FREE_REGISTERS];
-
-static char *byte_register_list[] = { "%r10b", "%r11b", "%r12b", "%r13b", "%r9b", "%r8b", "%cl", "%dl", "%sil", "%rdi"};
-static char *register_list[] = { "%r10", "%r11", "%r12", "%r13", "%r9", "%r8", "%rcx", "%rdx", "%rsi", "%rdi"};
-static char *double_register_list[] = { "%r10d", "%r11d", "%r12d", "%r13d", "%r9d", "%r8d", "%ecx", "%edx", "%esi", "%edi" };
-
 
 static char* cmplist[] = {"sete", "setne", "setl", "setg", "setle", "setge"};
 static char* inv_cmplist[] = {"jne", "je", "jge", "jle", "jg", "jl"};
@@ -48,16 +40,9 @@ static int isCompOperator(int tokenType) {
     }
 }
 
+// Registers are virtual until the function is complete, see regalloc.c
 static int allocate_register(void) {
-    for (int i = 0; i < 4; i++) {
-        if (free_registers[i]) {
-            free_registers[i] = 0;
-            return i;
-        }
-    }
-
-    fprintf(stderr, "No more registers available for allocation.\n");
-    exit(1);
+    return new_vreg();
 }
 
 static int new_local_offset(int type) {
@@ -66,46 +51,45 @@ static int new_local_offset(int type) {
 }
 
 static int cgcompare(int r1, int r2, char* how) {
-    fprintf(outfile, "\tcmpq\t%s, %s\n", register_list[r2], register_list[r1]);
-    fprintf(outfile, "\t%s\t%s\n", how, byte_register_list[r2]);
-    fprintf(outfile, "\tandq\t$255, %s\n", register_list[r2]);
+    emit("\tcmpq\t%R, %R\n", r2, r1);
+    emit("\t%s\t%B\n", how, r2);
+    emit("\tandq\t$255, %R\n", r2);
     return r2;
 }
 
 void cglabel(int l) {
-    fprintf(outfile, "L%d:\n", l);
+    emit("L%d:\n", l);
 }
 
 void cgjump(int l) {
-    fprintf(outfile, "\tjmp\tL%d\n", l);
+    emit("\tjmp\tL%d\n", l);
 }
 
 void cgpreamble() {
-    free_all_registers();
-    fprintf(outfile,
+    out_string(
             "# internal switch(expr) routine\n"
-            "# %%rsi = switch table, %%rax = expr\n"
+            "# %rsi = switch table, %rax = expr\n"
             "# from SubC: http://www.t3x.org/subc/\n"
             "\n"
             "switch:\n"
-            "        pushq   %%rsi\n"
-            "        movq    %%rdx, %%rsi\n"
-            "        movq    %%rax, %%rbx\n"
+            "        pushq   %rsi\n"
+            "        movq    %rdx, %rsi\n"
+            "        movq    %rax, %rbx\n"
             "        cld\n"
             "        lodsq\n"
-            "        movq    %%rax, %%rcx\n"
+            "        movq    %rax, %rcx\n"
             "next:\n"
             "        lodsq\n"
-            "        movq    %%rax, %%rdx\n"
+            "        movq    %rax, %rdx\n"
             "        lodsq\n"
-            "        cmpq    %%rdx, %%rbx\n"
+            "        cmpq    %rdx, %rbx\n"
             "        jnz     no\n"
-            "        popq    %%rsi\n"
-            "        jmp     *%%rax\n"
+            "        popq    %rsi\n"
+            "        jmp     *%rax\n"
             "no:\n"
             "        loop    next\n"
             "        lodsq\n"
-            "        popq    %%rsi\n" "        jmp     *%%rax\n" "\n");
+            "        popq    %rsi\n" "        jmp     *%rax\n" "\n");
 }
 
 void cgpostamble() {}
@@ -131,14 +115,14 @@ enum { no_seg, text_seg, data_seg } currSeg = no_seg;
 
 void cgtextseg() {
   if (currSeg != text_seg) {
-    fputs("\t.text\n", outfile);
+    out_string("\t.text\n");
     currSeg = text_seg;
   }
 }
 
 void cgdataseg() {
   if (currSeg != data_seg) {
-    fputs("\t.data\n", outfile);
+    out_string("\t.data\n");
     currSeg = data_seg;
   }
 }
@@ -152,34 +136,27 @@ int cggreaterequal(int r1, int r2) {return cgcompare(r1, r2, "setge");}
 
 
 int cg_invert(int r1) {
-    fprintf(outfile, "\tnotq\t%s\n", register_list[r1]);
+    emit("\tnotq\t%R\n", r1);
     return r1;
 }
 
 int cg_negate(int r1) {
-    fprintf(outfile, "\tnegq\t%s\n", register_list[r1]);
+    emit("\tnegq\t%R\n", r1);
     return r1;
 }
 
 
-static void free_register(int indx) {
-    if (free_registers[indx] != 0) {
-        fprintf(stderr, "Error trying to free register %d\n", indx);
-        exit(1);
+void cgmoveint(int value, int r) {
+    if (value == 0) {
+        emit("\txorl\t%D, %D\n", r, r);
+    } else {
+        emit("\tmovq\t$%d, %R\n", value, r);
     }
-
-    free_registers[indx] = 1;
 }
 
-void free_all_registers(void) {
-    free_registers[0] = free_registers[1]
-        = free_registers[2] = free_registers[3] = 1;
-}
-
-
 int cgloadint(int value) {
     int r = allocate_register();
-    fprintf(outfile, "\tmovq\t$%d, %s\n", value, register_list[r]);
+    cgmoveint(value, r);
     return r;
 }
 
@@ -187,39 +164,39 @@ int cgloadglob(t_symbol_entry* symbol, int op) {
   int r = allocate_register();
 
   if (pointer_type(symbol->type)) {
-      if (op == A_PRE_INCREMENT) {fprintf(outfile, "\tincq\t%s(\%%rip)\n", symbol->name);}
-      if (op == A_PRE_DECREMENT) {fprintf(outfile, "\tdecq\t%s(\%%rip)\n", symbol->name);}
-      fprintf(outfile, "\tmovq\t%s(\%%rip), %s\n", symbol->name, register_list[r]);
-      if (op == A_POST_INCREMENT) {fprintf(outfile, "\tincq\t%s(\%%rip)\n", symbol->name);}
-      if (op == A_POST_DECREMENT) {fprintf(outfile, "\tdecq\t%s(\%%rip)\n", symbol->name);}
+      if (op == A_PRE_INCREMENT) {emit("\tincq\t%s(%%rip)\n", symbol->name);}
+      if (op == A_PRE_DECREMENT) {emit("\tdecq\t%s(%%rip)\n", symbol->name);}
+      emit("\tmovq\t%s(%%rip), %R\n", symbol->name, r);
+      if (op == A_POST_INCREMENT) {emit("\tincq\t%s(%%rip)\n", symbol->name);}
+      if (op == A_POST_DECREMENT) {emit("\tdecq\t%s(%%rip)\n", symbol->name);}
 
   } else {
       // Print out the code to initialise it
       switch (symbol->type) {
         case TYPE_CHAR:
-                if (op == A_PRE_INCREMENT) {fprintf(outfile, "\tincb\t%s(\%%rip)\n", symbol->name);}
-                if (op == A_PRE_DECREMENT) {fprintf(outfile, "\tdecb\t%s(\%%rip)\n", symbol->name);}
+                if (op == A_PRE_INCREMENT) {emit("\tincb\t%s(%%rip)\n", symbol->name);}
+                if (op == A_PRE_DECREMENT) {emit("\tdecb\t%s(%%rip)\n", symbol->name);}
 
-                fprintf(outfile, "\tmovzbq\t%s(%%rip), %s\n", symbol->name, register_list[r]);
+                emit("\tmovzbq\t%s(%%rip), %R\n", symbol->name, r);
 
-                if (op == A_POST_INCREMENT) {fprintf(outfile, "\tincb\t%s(\%%rip)\n", symbol->name);}
-                if (op == A_POST_DECREMENT) {fprintf(outfile, "\tdecb\t%s(\%%rip)\n", symbol->name);}
+                if (op == A_POST_INCREMENT) {emit("\tincb\t%s(%%rip)\n", symbol->name);}
+                if (op == A_POST_DECREMENT) {emit("\tdecb\t%s(%%rip)\n", symbol->name);}
             break;
 
         case TYPE_INT:
-            if (op == A_PRE_INCREMENT) {fprintf(outfile, "\tincl\t%s(\%%rip)\n", symbol->name);}
-            if (op == A_PRE_DECREMENT) {fprintf(outfile, "\tdecl\t%s(\%%rip)\n", symbol->name);}
-            fprintf(outfile, "\tmovslq\t%s(\%%rip), %s\n", symbol->name, register_list[r]);
-            if (op == A_POST_INCREMENT) {fprintf(outfile, "\tincl\t%s(\%%rip)\n", symbol->name);}
-            if (op == A_POST_DECREMENT) {fprintf(outfile, "\tdecl\t%s(\%%rip)\n", symbol->name);}
+            if (op == A_PRE_INCREMENT) {emit("\tincl\t%s(%%rip)\n", symbol->name);}
+            if (op == A_PRE_DECREMENT) {emit("\tdecl\t%s(%%rip)\n", symbol->name);}
+            emit("\tmovslq\t%s(%%rip), %R\n", symbol->name, r);
+            if (op == A_POST_INCREMENT) {emit("\tincl\t%s(%%rip)\n", symbol->name);}
+            if (op == A_POST_DECREMENT) {emit("\tdecl\t%s(%%rip)\n", symbol->name);}
             break;
 
         case TYPE_LONG:
-            if (op == A_PRE_INCREMENT) {fprintf(outfile, "\tincq\t%s(\%%rip)\n", symbol->name);}
-            if (op == A_PRE_DECREMENT) {fprintf(outfile, "\tdecq\t%s(\%%rip)\n", symbol->name);}
-            fprintf(outfile, "\tmovq\t%s(\%%rip), %s\n", symbol->name, register_list[r]);
-            if (op == A_POST_INCREMENT) {fprintf(outfile, "\tincq\t%s(\%%rip)\n", symbol->name);}
-            if (op == A_POST_DECREMENT) {fprintf(outfile, "\tdecq\t%s(\%%rip)\n", symbol->name);}
+            if (op == A_PRE_INCREMENT) {emit("\tincq\t%s(%%rip)\n", symbol->name);}
+            if (op == A_PRE_DECREMENT) {emit("\tdecq\t%s(%%rip)\n", symbol->name);}
+            emit("\tmovq\t%s(%%rip), %R\n", symbol->name, r);
+            if (op == A_POST_INCREMENT) {emit("\tincq\t%s(%%rip)\n", symbol->name);}
+            if (op == A_POST_DECREMENT) {emit("\tdecq\t%s(%%rip)\n", symbol->name);}
             break;
 
         default:
@@ -234,12 +211,14 @@ int cgloadglob(t_symbol_entry* symbol, int op) {
 int cgstorderef(int r1, int r2, int type) {
     switch (cgprimsize(type)) {
         case 1:
-            fprintf(outfile, "\tmovb\t%s, (%s)\n", byte_register_list[r1], register_list[r2]);
+            emit("\tmovb\t%B, (%R)\n", r1, r2);
             break;
         case 2:
         case 4:
+            emit("\tmovl\t%D, (%R)\n", r1, r2);
+            break;
         case 8:
-            fprintf(outfile, "\tmovq\t%s, (%s)\n", register_list[r1], register_list[r2]);
+            emit("\tmovq\t%R, (%R)\n", r1, r2);
             break;
         default:
             fprintf(stderr, "Cant cgstoderef on type: %d\n", type);
@@ -248,20 +227,54 @@ int cgstorderef(int r1, int r2, int type) {
     return r1;
 }
 
+// Suffix and value of a store of a constant of the given type,
+// characters are cut to their byte
+static char store_suffix(int type, int* value) {
+    if (pointer_type(type)) {
+        return 'q';
+    }
+
+    switch (type) {
+        case TYPE_CHAR:
+            *value &= 0xff;
+            return 'b';
+        case TYPE_INT: return 'l';
+        case TYPE_LONG: return 'q';
+        default:
+            report_error("Bad type in store_suffix: %d.\n", type);
+            return 0;
+    }
+}
+
+void cgstorderefconst(int value, int r, int type) {
+    char suffix[2] = { store_suffix(type, &value), 0 };
+    emit("\tmov%s\t$%d, (%R)\n", suffix, value, r);
+}
+
+void cgstoreglobconst(int value, t_symbol_entry* symbol) {
+    char suffix[2] = { store_suffix(symbol->type, &value), 0 };
+    emit("\tmov%s\t$%d, %s(%%rip)\n", suffix, value, symbol->name);
+}
+
+void cgstorelocalconst(int value, t_symbol_entry* symbol) {
+    char suffix[2] = { store_suffix(symbol->type, &value), 0 };
+    emit("\tmov%s\t$%d, %d(%%rbp)\n", suffix, value, symbol->offset);
+}
+
 int cgstoreglob(int r, t_symbol_entry* symbol) {
 
     if (pointer_type(symbol->type)) {
-        fprintf(outfile, "\tmovq\t%s, %s(\%%rip)\n", register_list[r], symbol->name);
+        emit("\tmovq\t%R, %s(%%rip)\n", r, symbol->name);
     } else {
         switch (symbol->type) {
             case TYPE_CHAR:
-                fprintf(outfile, "\tmovb\t%s, %s(\%%rip)\n", byte_register_list[r], symbol->name);
+                emit("\tmovb\t%B, %s(%%rip)\n", r, symbol->name);
                 break;
             case TYPE_INT:
-                fprintf(outfile, "\tmovl\t%s, %s(\%%rip)\n", double_register_list[r], symbol->name);
+                emit("\tmovl\t%D, %s(%%rip)\n", r, symbol->name);
                 break;
             case TYPE_LONG:
-                fprintf(outfile, "\tmovq\t%s, %s(\%%rip)\n", register_list[r], symbol->name);
+                emit("\tmovq\t%R, %s(%%rip)\n", r, symbol->name);
                 break;
             default:
                 report_error("Bad type in cgloadglob: %d.\n", symbol->type);
@@ -276,35 +289,35 @@ int cgloadlocal(t_symbol_entry* symbol, int op) {
     int r = allocate_register();
 
     if (pointer_type(symbol->type)) {
-        if (op == A_PRE_INCREMENT) {fprintf(outfile, "\tincq\t%d(\%%rbp)\n", symbol->offset);}
-        if (op == A_PRE_DECREMENT) {fprintf(outfile, "\tdecq\t%d(\%%rbp)\n", symbol->offset);}
-        fprintf(outfile, "\tmovq\t%d(\%%rbp), %s\n", symbol->offset, register_list[r]);
-        if (op == A_POST_INCREMENT) {fprintf(outfile, "\tincq\t%d(\%%rbp)\n", symbol->offset);}
-        if (op == A_POST_DECREMENT) {fprintf(outfile, "\tdecq\t%d(\%%rbp)\n", symbol->offset);}
+        if (op == A_PRE_INCREMENT) {emit("\tincq\t%d(%%rbp)\n", symbol->offset);}
+        if (op == A_PRE_DECREMENT) {emit("\tdecq\t%d(%%rbp)\n", symbol->offset);}
+        emit("\tmovq\t%d(%%rbp), %R\n", symbol->offset, r);
+        if (op == A_POST_INCREMENT) {emit("\tincq\t%d(%%rbp)\n", symbol->offset);}
+        if (op == A_POST_DECREMENT) {emit("\tdecq\t%d(%%rbp)\n", symbol->offset);}
     } else {
         switch (symbol->type) {
             case TYPE_CHAR:
-                if (op == A_PRE_INCREMENT) {fprintf(outfile, "\tincb\t%d(\%%rbp)\n", symbol->offset);}
-                if (op == A_PRE_DECREMENT) {fprintf(outfile, "\tdecb\t%d(\%%rbp)\n", symbol->offset);}
-                fprintf(outfile, "\tmovzbq\t%d(%%rbp), %s\n", symbol->offset,  register_list[r]);
-                if (op == A_POST_INCREMENT) { fprintf(outfile, "\tincb\t%d(\%%rbp)\n", symbol->offset);}
-                if (op == A_POST_DECREMENT) {fprintf(outfile, "\tdecb\t%d(\%%rbp)\n", symbol->offset);}
+                if (op == A_PRE_INCREMENT) {emit("\tincb\t%d(%%rbp)\n", symbol->offset);}
+                if (op == A_PRE_DECREMENT) {emit("\tdecb\t%d(%%rbp)\n", symbol->offset);}
+                emit("\tmovzbq\t%d(%%rbp), %R\n", symbol->offset, r);
+                if (op == A_POST_INCREMENT) { emit("\tincb\t%d(%%rbp)\n", symbol->offset);}
+                if (op == A_POST_DECREMENT) {emit("\tdecb\t%d(%%rbp)\n", symbol->offset);}
                 break;
 
             case TYPE_INT:
-                if (op == A_PRE_INCREMENT) {fprintf(outfile, "\tincl\t%d(\%%rbp)\n", symbol->offset);}
-                if (op == A_PRE_DECREMENT) {fprintf(outfile, "\tdecl\t%d(\%%rbp)\n", symbol->offset);}
-                fprintf(outfile, "\tmovslq\t%d(\%%rbp), %s\n", symbol->offset, register_list[r]);
-                if (op == A_POST_INCREMENT) {fprintf(outfile, "\tincl\t%d(\%%rbp)\n", symbol->offset);}
-                if (op == A_POST_DECREMENT) {fprintf(outfile, "\tdecl\t%d(\%%rbp)\n", symbol->offset);}
+                if (op == A_PRE_INCREMENT) {emit("\tincl\t%d(%%rbp)\n", symbol->offset);}
+                if (op == A_PRE_DECREMENT) {emit("\tdecl\t%d(%%rbp)\n", symbol->offset);}
+                emit("\tmovslq\t%d(%%rbp), %R\n", symbol->offset, r);
+                if (op == A_POST_INCREMENT) {emit("\tincl\t%d(%%rbp)\n", symbol->offset);}
+                if (op == A_POST_DECREMENT) {emit("\tdecl\t%d(%%rbp)\n", symbol->offset);}
                 break;
 
             case TYPE_LONG:
-                if (op == A_PRE_INCREMENT) {fprintf(outfile, "\tincq\t%d(\%%rbp)\n", symbol->offset);}
-                if (op == A_PRE_DECREMENT) {fprintf(outfile, "\tdecq\t%d(\%%rbp)\n", symbol->offset);}
-                fprintf(outfile, "\tmovq\t%d(\%%rbp), %s\n", symbol->offset, register_list[r]);
-                if (op == A_POST_INCREMENT) {fprintf(outfile, "\tincq\t%d(\%%rbp)\n", symbol->offset);}
-                if (op == A_POST_DECREMENT) {fprintf(outfile, "\tdecq\t%d(\%%rbp)\n", symbol->offset);}
+                if (op == A_PRE_INCREMENT) {emit("\tincq\t%d(%%rbp)\n", symbol->offset);}
+                if (op == A_PRE_DECREMENT) {emit("\tdecq\t%d(%%rbp)\n", symbol->offset);}
+                emit("\tmovq\t%d(%%rbp), %R\n", symbol->offset, r);
+                if (op == A_POST_INCREMENT) {emit("\tincq\t%d(%%rbp)\n", symbol->offset);}
+                if (op == A_POST_DECREMENT) {emit("\tdecq\t%d(%%rbp)\n", symbol->offset);}
                 break;
 
             default:
@@ -319,17 +332,17 @@ int cgloadlocal(t_symbol_entry* symbol, int op) {
 
 int cgstorelocal(int r, t_symbol_entry* symbol) {
     if (pointer_type(symbol->type)) {
-        fprintf(outfile, "\tmovq\t%s, %d(\%%rbp)\n", register_list[r], symbol->offset);
+        emit("\tmovq\t%R, %d(%%rbp)\n", r, symbol->offset);
     } else {
         switch (symbol->type) {
             case TYPE_CHAR:
-                fprintf(outfile, "\tmovb\t%s, %d(\%%rbp)\n", byte_register_list[r], symbol->offset);
+                emit("\tmovb\t%B, %d(%%rbp)\n", r, symbol->offset);
                 break;
             case TYPE_INT:
-                fprintf(outfile, "\tmovl\t%s, %d(\%%rbp)\n", double_register_list[r], symbol->offset);
+                emit("\tmovl\t%D, %d(%%rbp)\n", r, symbol->offset);
                 break;
             case TYPE_LONG:
-                fprintf(outfile, "\tmovq\t%s, %d(\%%rbp)\n", register_list[r], symbol->offset);
+                emit("\tmovq\t%R, %d(%%rbp)\n", r, symbol->offset);
                 break;
             default:
                 fprintf(stderr, "Bad type in cgloadglob: %d.\n", symbol->type);
@@ -361,8 +374,8 @@ void cgglobsym(t_symbol_entry* symbol) {
     }
 
     cgdataseg();
-    fprintf(outfile, "\t.data\n" "\t.globl\t%s\n", symbol->name);
-    fprintf(outfile, "%s:", symbol->name);
+    emit("\t.data\n" "\t.globl\t%s\n", symbol->name);
+    emit("%s:", symbol->name);
 
     for (i = 0; i < symbol->num_elements; i++) {
         init_value = 0;
@@ -372,19 +385,19 @@ void cgglobsym(t_symbol_entry* symbol) {
         }
 
         switch(size) {
-            case 1: fprintf(outfile, "\t.byte\t%d\n", init_value); break;
-            case 4: fprintf(outfile, "\t.long\t%d\n", init_value); break;
+            case 1: emit("\t.byte\t%d\n", init_value); break;
+            case 4: emit("\t.long\t%d\n", init_value); break;
             case 8:
 
                 if (symbol->initializer_list != NULL && type == pointer_to(TYPE_CHAR)) {
-                    fprintf(outfile, "\t.quad\tL%d\n", init_value);
+                    emit("\t.quad\tL%d\n", init_value);
                 } else {
-                    fprintf(outfile, "\t.quad\t%d\n", init_value);
+                    emit("\t.quad\t%d\n", init_value);
                 }
                 break;
             default:
                 for (int i = 0; i < size; i++) {
-                    fprintf(outfile, "\t.byte\t0\n");
+                    emit("\t.byte\t0\n");
                 }
                 break;
         }
@@ -394,39 +407,67 @@ void cgglobsym(t_symbol_entry* symbol) {
 void cgreturn(int reg, t_symbol_entry* symbol) {
     switch (symbol->type) {
         case TYPE_CHAR:
-            fprintf(outfile, "\tmovzbl\t%s, %%eax\n", byte_register_list[reg]);
+            emit("\tmovzbl\t%B, %%eax\n", reg);
             break;
         case TYPE_INT:
-            fprintf(outfile, "\tmovl\t%s, %%eax\n", double_register_list[reg]);
+            emit("\tmovl\t%D, %%eax\n", reg);
             break;
         case TYPE_LONG:
-            fprintf(outfile, "\tmovq\t%s, %%rax\n", register_list[reg]);
+            emit("\tmovq\t%R, %%rax\n", reg);
             break;
         default:
             report_error("Bad function type in cgreturn: %d.\n", symbol->type);
             break;
     }
+}
 
-    cgjump(symbol->endlabel);
+void cgreturnconst(int value, t_symbol_entry* symbol) {
+    switch (symbol->type) {
+        case TYPE_CHAR:
+            emit("\tmovl\t$%d, %%eax\n", value & 0xff);
+            break;
+        case TYPE_INT:
+            emit("\tmovl\t$%d, %%eax\n", value);
+            break;
+        case TYPE_LONG:
+            emit("\tmovq\t$%d, %%rax\n", value);
+            break;
+        default:
+            report_error("Bad function type in cgreturnconst: %d.\n", symbol->type);
+            break;
+    }
 }
 
 int cgcall(t_symbol_entry* symbol, int argc) {
     // Get a new register
     int outr = allocate_register();
 
-    fprintf(outfile, "\tcall\t%s\n", symbol->name);
+    emit("\tcall\t%s\n", symbol->name);
+    emit_clobber(CALLER_SAVED);
 
-    if (argc > 6) {
-        fprintf(outfile, "\taddq\t$%d, %%rsp\n", 8*(argc-6));
-    } else {
-        fprintf(outfile, "\tmovq\t%%rax, %s\n", register_list[outr]);
+    if (argc > NUM_PARAMETER_REGISTERS) {
+        emit("\taddq\t$%d, %%rsp\n", 8*(argc-NUM_PARAMETER_REGISTERS));
+    }
+
+    // Only the low bytes of a char or int result are defined, the rest
+    // of the register is extended as a load of the type would
+    switch (symbol->type) {
+        case TYPE_CHAR:
+            emit("\tmovzbq\t%%al, %R\n", outr);
+            break;
+        case TYPE_INT:
+            emit("\tmovslq\t%%eax, %R\n", outr);
+            break;
+        default:
+            emit("\tmovq\t%%rax, %R\n", outr);
+            break;
     }
 
     return outr;
 }
 
 int cgxor(int r1, int r2) {
-    fprintf(outfile, "\txorq\t%s, %s\n", register_list[r1], register_list[r2]);
+    emit("\txorq\t%R, %R\n", r1, r2);
     return r2; // Return register with result
 }
 
@@ -434,16 +475,40 @@ void cgglobstr(int label, char* text) {
     cglabel(label);
 
     for (;*text != '\0'; text++) {
-        fprintf(outfile, "\t.byte\t%d\n", *text);
+        emit("\t.byte\t%d\n", *text);
     }
 
-    fprintf(outfile, "\t.byte\t0\n");
+    emit("\t.byte\t0\n");
 }
 
 int cgloadglobstr(int label) {
     int r = allocate_register();
 
-    fprintf(outfile, "\tleaq\tL%d(%%rip), %s\n", label, register_list[r]);
+    emit("\tleaq\tL%d(%%rip), %R\n", label, r);
+
+    return r;
+}
+
+void cgmove(int r1, int r2) {
+    emit("\tmovq\t%R, %R\n", r1, r2);
+}
+
+int cgcopy(int r) {
+    int copy = allocate_register();
+
+    cgmove(r, copy);
+    return copy;
+}
+
+int cgtruncate(int r, int type) {
+    switch (cgprimsize(type)) {
+        case 1:
+            emit("\tmovzbq\t%B, %R\n", r, r);
+            break;
+        case 4:
+            emit("\tmovslq\t%D, %R\n", r, r);
+            break;
+    }
 
     return r;
 }
@@ -452,70 +517,212 @@ int cgwiden(int r, int oldtyxpe, int newtype) {
     return r;
 }
 
-int cgadd(int r1, int r2) {
-    fprintf(outfile, "\taddq\t%s, %s\n", register_list[r1], register_list[r2]);
+int cgarithconst(int ASTop, int r, int value) {
+    switch (ASTop) {
+        case A_ADD: emit("\taddq\t$%d, %R\n", value, r); break;
+        case A_SUBTRACT: emit("\tsubq\t$%d, %R\n", value, r); break;
+        case A_MULTIPLY: return cgmulconst(r, value);
+        case A_DIVIDE: case A_MOD: return cgdivconst(ASTop, r, value);
+        case A_AND: emit("\tandq\t$%d, %R\n", value, r); break;
+        case A_OR: emit("\torq\t$%d, %R\n", value, r); break;
+        case A_XOR: emit("\txorq\t$%d, %R\n", value, r); break;
+        default:
+            report_error("Bad ASTop in cgarithconst: %d.\n", ASTop);
+    }
 
-    free_register(r1);
+    return r;
+}
+
+int cgadd(int r1, int r2) {
+    emit("\taddq\t%R, %R\n", r1, r2);
     return r2;
 }
 
 int cgmul(int r1, int r2) {
-    fprintf(outfile, "\timulq\t%s, %s\n", register_list[r1], register_list[r2]);
-
-    free_register(r1);
+    emit("\timulq\t%R, %R\n", r1, r2);
     return r2;
 }
 
 int cgsub(int r1, int r2) {
-    fprintf(outfile, "\tsubq\t%s, %s\n", register_list[r2], register_list[r1]);
-
-    free_register(r2);
+    emit("\tsubq\t%R, %R\n", r2, r1);
     return r1;
 }
 
 int cgshift_l(int r1, int r2) {
-    fprintf(outfile, "\tmovb\t%s, %%cl\n", byte_register_list[r2]);
-    fprintf(outfile, "\tshlq\t%%cl, %s\n", register_list[r1]);
-    free_register(r2);
+    emit("\tmovb\t%B, %%cl\n", r2);
+    emit_clobber(REGISTER_BIT(R_RCX));
+    emit("\tshlq\t%%cl, %R\n", r1);
     return r1;
 }
 
 int cgshift_r(int r1, int r2) {
-    fprintf(outfile, "\tmovb\t%s, %%cl\n", byte_register_list[r2]);
-    fprintf(outfile, "\tshrq\t%%cl, %s\n", register_list[r1]);
-    free_register(r2);
+    emit("\tmovb\t%B, %%cl\n", r2);
+    emit_clobber(REGISTER_BIT(R_RCX));
+    emit("\tshrq\t%%cl, %R\n", r1);
     return r1;
 }
 
 int cg_or(int r1, int r2) {
-    fprintf(outfile, "\torq\t\t%s, %s\n", register_list[r1], register_list[r2]);
-    free_register(r1);
+    emit("\torq\t\t%R, %R\n", r1, r2);
     return r2;
 }
 
 int cg_and(int r1, int r2) {
-    fprintf(outfile, "\tandq\t\t%s, %s\n", register_list[r1], register_list[r2]);
-    free_register(r1);
+    emit("\tandq\t\t%R, %R\n", r1, r2);
     return r2;
 }
 
 int cg_logic_not(int r1) {
-    fprintf(outfile, "\ttestq\t%s, %s\n", register_list[r1], register_list[r1]);
-    fprintf(outfile, "\tsete\t%s\n", byte_register_list[r1]);
-    fprintf(outfile, "\tmovzbq\t%s, %s\n", byte_register_list[r1], register_list[r1]);
+    emit("\ttestq\t%R, %R\n", r1, r1);
+    emit("\tsete\t%B\n", r1);
+    emit("\tmovzbq\t%B, %R\n", r1, r1);
     return r1;
 }
 
 int cgdiv(int r1, int r2) {
 
-    fprintf(outfile, "\tmovq\t%s,%%rax\n", register_list[r1]);
-    fprintf(outfile, "\tcqo\n");
-    fprintf(outfile, "\tidivq\t%s\n", register_list[r2]);
-    fprintf(outfile, "\tmovq\t%%rax,%s\n", register_list[r1]);
-    free_register(r2);
+    emit("\tmovq\t%R,%%rax\n", r1);
+    emit("\tcqo\n");
+    emit_clobber(REGISTER_BIT(R_RDX));
+    emit("\tidivq\t%R\n", r2);
+    emit_clobber(REGISTER_BIT(R_RDX));
+    emit("\tmovq\t%%rax,%R\n", r1);
     return r1;
 }
 
+int cgmod(int r1, int r2) {
+
+    emit("\tmovq\t%R,%%rax\n", r1);
+    emit("\tcqo\n");
+    emit_clobber(REGISTER_BIT(R_RDX));
+    emit("\tidivq\t%R\n", r2);
+    emit_clobber(REGISTER_BIT(R_RDX));
+    emit_hold(R_RDX);
+    emit("\tmovq\t%%rdx,%R\n", r1);
+    emit_clobber(REGISTER_BIT(R_RDX));
+    return r1;
+}
+
+int cgmulconst(int r, int value) {
+    long factor = value < 0 ? -(long)value : value;
+    int shift = 0, scale = 0;
+
+    if (value == 0) {
+        cgmoveint(0, r);
+        return r;
+    }
+
+    while ((factor & 1) == 0) {
+        factor >>= 1;
+        shift++;
+    }
+
+    // leaq (r,r,s) multiplies by 3, 5 or 9
+    if (factor == 3 || factor == 5 || factor == 9) {
+        scale = factor - 1;
+        factor = 1;
+    }
+
+    if (factor != 1) {
+        emit("\timulq\t$%d, %R, %R\n", value, r, r);
+        return r;
+    }
+
+    if (scale) {emit("\tleaq\t(%R,%R,%d), %R\n", r, r, scale, r);}
+    if (shift) {emit("\tsalq\t$%d, %R\n", shift, r);}
+    if (value < 0) {emit("\tnegq\t%R\n", r);}
+    return r;
+}
+
+// Magic number of the signed division by d, |d| > 1 and not a power of
+// two: the quotient is the high half of x * magic, plus x if d > 0 and
+// magic < 0, minus x if d < 0 and magic > 0, shifted right by shift and
+// rounded towards zero. See Hacker's Delight, chapter 10.
+static void division_magic(long d, long* magic, int* shift) {
+    const unsigned long two63 = 1UL << 63;
+    unsigned long ad = d < 0 ? -(unsigned long)d : (unsigned long)d;
+    unsigned long t = two63 + ((unsigned long)d >> 63);
+    unsigned long anc = t - 1 - t % ad;
+    unsigned long q1 = two63 / anc, r1 = two63 - q1 * anc;
+    unsigned long q2 = two63 / ad, r2 = two63 - q2 * ad;
+    unsigned long delta;
+    int p = 63;
+
+    do {
+        p++;
+        q1 *= 2;
+        r1 *= 2;
+        if (r1 >= anc) {q1++; r1 -= anc;}
+        q2 *= 2;
+        r2 *= 2;
+        if (r2 >= ad) {q2++; r2 -= ad;}
+        delta = ad - r2;
+    } while (q1 < delta || (q1 == delta && r1 == 0));
+
+    *magic = d < 0 ? -(long)(q2 + 1) : (long)(q2 + 1);
+    *shift = p - 64;
+}
+
+int cgdivconst(int ASTop, int r, int value) {
+    long d = value < 0 ? -(long)value : value;
+    long magic;
+    int shift = 0;
+
+    if (d == 1) {
+        if (ASTop == A_MOD) {
+            cgmoveint(0, r);
+        } else if (value < 0) {
+            emit("\tnegq\t%R\n", r);
+        }
+        return r;
+    }
+
+    if ((d & (d - 1)) == 0) {
+        while ((1L << shift) < d) {shift++;}
+
+        // A negative dividend is biased by d - 1 so that the shift
+        // rounds towards zero
+        emit("\tmovq\t%R, %%rax\n", r);
+        if (shift > 1) {emit("\tsarq\t$63, %%rax\n");}
+        emit("\tshrq\t$%d, %%rax\n", 64 - shift);
+        emit("\taddq\t%%rax, %R\n", r);
+
+        if (ASTop == A_MOD) {
+            emit("\tandq\t$%l, %R\n", d - 1, r);
+            emit("\tsubq\t%%rax, %R\n", r);
+        } else {
+            emit("\tsarq\t$%d, %R\n", shift, r);
+            if (value < 0) {emit("\tnegq\t%R\n", r);}
+        }
+        return r;
+    }
+
+    division_magic(value, &magic, &shift);
+
+    emit(magic == (int)magic ? "\tmovq\t$%l, %%rax\n" : "\tmovabsq\t$%l, %%rax\n", magic);
+    emit("\timulq\t%R\n", r);
+    emit_clobber(REGISTER_BIT(R_RDX));
+    emit_hold(R_RDX);
+
+    if (value > 0 && magic < 0) {emit("\taddq\t%R, %%rdx\n", r);}
+    if (value < 0 && magic > 0) {emit("\tsubq\t%R, %%rdx\n", r);}
+    if (shift) {emit("\tsarq\t$%d, %%rdx\n", shift);}
+
+    // Add one to a negative quotient
+    emit("\tmovq\t%%rdx, %%rax\n");
+    emit("\tshrq\t$63, %%rax\n");
+    emit("\taddq\t%%rdx, %%rax\n");
+    emit_clobber(REGISTER_BIT(R_RDX));
+
+    if (ASTop == A_MOD) {
+        emit("\timulq\t$%d, %%rax, %%rax\n", value);
+        emit("\tsubq\t%%rax, %R\n", r);
+    } else {
+        emit("\tmovq\t%%rax, %R\n", r);
+    }
+    return r;
+}
+
 void cgfunctionpreamble(t_symbol_entry* symbol) {
     char* name = symbol->name;
     t_symbol_entry* parameter, *local_var;
@@ -527,52 +734,64 @@ void cgfunctionpreamble(t_symbol_entry* symbol) {
     cgtextseg();
     local_offset = 0;
 
-    fprintf(outfile,
-        "\t.text\n"
-        "\t.globl\t%s\n"
-        "\t.type\t%s, @function\n"
-        "%s:\n" "\tpushq\t%%rbp\n"
-        "\tmovq\t%%rsp, %%rbp\n", name, name, name);
+    emit("\t.text\n"
+         "\t.globl\t%s\n"
+         "\t.type\t%s, @function\n"
+         "%s:\n" "\tpushq\t%%rbp\n"
+         "\tmovq\t%%rsp, %%rbp\n", name, name, name);
 
-    // Copy in-register parameters onto stack
+    regalloc_begin(name);
+
+    // Copy in-register parameters onto stack, unless they are kept in registers
     for (parameter = symbol->member, p_count = 0; parameter != NULL; parameter = parameter->next, p_count++) {
-        if (p_count > 6) {
+        if (p_count >= NUM_PARAMETER_REGISTERS) {
             parameter->offset = param_offset;
             param_offset += 8;
-        } else {
+        } else if (parameter->variable < 0) {
             parameter->offset = new_local_offset(parameter->type);
-            cgstorelocal(param_register--, parameter);
+            cgstorelocal(param_register - p_count, parameter);
         }
     }
 
     for (local_var = local_symbols->head; local_var != NULL; local_var = local_var->next) {
-        local_var->offset = new_local_offset(local_var->type);
+        if (local_var->variable < 0) {
+            local_var->offset = new_local_offset(local_var->type);
+        }
     }
 
-    stack_offset = (local_offset + 15) & ~15;
-    fprintf(outfile, "\taddq\t$%d, %%rsp\n",-stack_offset);
+    emit_frame_setup(local_offset);
+}
+
+int cgparameter(int position) {
+    int r = allocate_register();
+    int parameter_register = FIRST_PARAMETER_REGISTER - position + 1;
+
+    emit("\tmovq\t%R, %R\n", parameter_register, r);
+    emit_clobber(REGISTER_BIT(parameter_register));
+    return r;
+}
+
+void cgholdparameter(int position) {
+    emit_hold(FIRST_PARAMETER_REGISTER - position + 1);
 }
 
 void cgfunctionpostamble(t_symbol_entry* symbol) {
     cglabel(symbol->endlabel);
-    fprintf(outfile, "\taddq\t$%d,%%rsp\n", stack_offset);
-    fputs("\tpopq %rbp\n" "\tret\n", outfile);
+    emit_frame_teardown();
+    regalloc_end();
 }
 
 void generate_preamble() {cgpreamble();}
 void generate_postamble() {cgpostamble();}
-void generate_free_registers() {free_all_registers();}
 
 int cgcompare_and_set(int ASTop, int r1, int r2) {
     if (!isCompOperator(ASTop)) {
         fprintf(stderr, "Bad ASTop in cgcompare_and_set()\n");
     }
 
-    fprintf(outfile, "\tcmpq\t%s, %s\n", register_list[r2], register_list[r1]);
-    fprintf(outfile, "\t%s\t%s\n", cmplist[ASTop - A_EQUALS], byte_register_list[r2]);
-    fprintf(outfile, "\tmovzbq\t%s, %s\n", byte_register_list[r2], register_list[r2]);
-
-    free_register(r1);
+    emit("\tcmpq\t%R, %R\n", r2, r1);
+    emit("\t%s\t%B\n", cmplist[ASTop - A_EQUALS], r2);
+    emit("\tmovzbq\t%B, %R\n", r2, r2);
     return r2;
 }
 
@@ -582,16 +801,67 @@ int cgcompare_and_jump(int ASTop, int r1, int r2, int label) {
         fprintf(stderr, "Bad ASTop in cgcompare_and_jump()");
     }
 
-    fprintf(outfile, "\tcmpq\t%s, %s\n", register_list[r2], register_list[r1]);
-    fprintf(outfile, "\t%s\tL%d\n", inv_cmplist[ASTop - A_EQUALS], label);
-    free_all_registers();
+    emit("\tcmpq\t%R, %R\n", r2, r1);
+    emit("\t%s\tL%d\n", inv_cmplist[ASTop - A_EQUALS], label);
+    return NOREG;
+}
+
+int cgcompare_const_and_set(int ASTop, int r, int value) {
+    int r2 = allocate_register();
+
+    if (!isCompOperator(ASTop)) {
+        fprintf(stderr, "Bad ASTop in cgcompare_const_and_set()\n");
+    }
+
+    emit("\tcmpq\t$%d, %R\n", value, r);
+    emit("\t%s\t%B\n", cmplist[ASTop - A_EQUALS], r2);
+    emit("\tmovzbq\t%B, %R\n", r2, r2);
+    return r2;
+}
+
+int cgcompare_const_and_jump(int ASTop, int r, int value, int label) {
+
+    if (!isCompOperator(ASTop)) {
+        fprintf(stderr, "Bad ASTop in cgcompare_const_and_jump()");
+    }
+
+    emit("\tcmpq\t$%d, %R\n", value, r);
+    emit("\t%s\tL%d\n", inv_cmplist[ASTop - A_EQUALS], label);
     return NOREG;
 }
 
+void cgjumptable(int reg, int low, int count, int* caselabel, int default_label) {
+    int index = cgcopy(reg);
+    int base = allocate_register();
+    int table = label();
+
+    if (low != 0) {
+        emit("\tsubq\t$%d, %R\n", low, index);
+    }
+
+    // Below low wraps around to a large unsigned index
+    emit("\tcmpq\t$%d, %R\n", count - 1, index);
+    emit("\tja\tL%d\n", default_label);
+    emit("\tleaq\tL%d(%%rip), %R\n", table, base);
+    emit("\tjmp\t*(%R,%R,8)\n", base, index);
+
+    emit("\t.p2align\t3\n");
+    cglabel(table);
+
+    for (int i = 0; i < count; i++) {
+        emit("\t.quad\tL%d\n", caselabel[i]);
+    }
+}
+
 int cgaddress(t_symbol_entry* symbol) {
     int r = allocate_register();
 
-    fprintf(outfile, "\tleaq\t%s(%%rip), %s\n", symbol->name, register_list[r]);
+    if (symbol->class == C_LOCAL || symbol->class == C_PARAMETER) {
+        emit("\tleaq\t%d(%%rbp), %R\n", symbol->offset, r);
+    } else {
+        emit("\tleaq\t%s(%%rip), %R\n", symbol->name, r);
+    }
+
     return r;
 }
 
@@ -599,21 +869,21 @@ int cgderef(int r, int type) {
     int new_type = value_at(type);
     switch (cgprimsize(new_type)) {
         case 1:
-            fprintf(outfile, "\tmovzbq\t(%s), %s\n", register_list[r], register_list[r]);
+            emit("\tmovzbq\t(%R), %R\n", r, r);
             break;
         case 2:
-            fprintf(outfile, "\tmovslq\t(%s), %s\n", register_list[r], register_list[r]);
-            break;
         case 4:
+            emit("\tmovslq\t(%R), %R\n", r, r);
+            break;
         case 8:
-            fprintf(outfile, "\tmovq\t(%s), %s\n", register_list[r], register_list[r]);
+            emit("\tmovq\t(%R), %R\n", r, r);
             break;
     }
     return r;
 }
 
 int cgshlconst(int r, int val) {
-    fprintf(outfile, "\tsalq\t$%d, %s\n", val, register_list[r]);
+    emit("\tsalq\t$%d, %R\n", val, r);
     return r;
 }
 
@@ -626,12 +896,21 @@ int cg_get_local_offset(int type, int isparam) {
     return -local_offset;
 }
 
+void cg_copy_argument_const(int value, int arg_position) {
+    if (arg_position > NUM_PARAMETER_REGISTERS) {
+        emit("\tpushq\t$%d\n", value);
+    } else {
+        cgmoveint(value, FIRST_PARAMETER_REGISTER - arg_position + 1);
+        emit_hold(FIRST_PARAMETER_REGISTER - arg_position + 1);
+    }
+}
+
 void cg_copy_argument(int r, int arg_position) {
-    if (arg_position > 6) {
-        fprintf(outfile, "\tpushq\t%s\n", register_list[r]);
+    if (arg_position > NUM_PARAMETER_REGISTERS) {
+        emit("\tpushq\t%R\n", r);
     } else {
-        fprintf(outfile, "\tmovq\t%s, %s\n", register_list[r],
-            register_list[FIRST_PARAMETER_REGISTER - arg_position + 1]);
+        emit("\tmovq\t%R, %R\n", r, FIRST_PARAMETER_REGISTER - arg_position + 1);
+        emit_hold(FIRST_PARAMETER_REGISTER - arg_position + 1);
     }
 }
 
@@ -682,15 +961,17 @@ void cgswitch(int reg,
         case_count = 1;
     }
 
-    fprintf(outfile, "\t.quad\t%d\n", case_count);
+    emit("\t.quad\t%d\n", case_count);
 
     for (i = 0; i < case_count; i++) {
-        fprintf(outfile, "\t.quad\t%d, L%d\n", casevalues[i], caselabel[i]);
+        emit("\t.quad\t%d, L%d\n", casevalues[i], caselabel[i]);
     }
 
-    fprintf(outfile, "\t.quad\tL%d\n", default_label);
+    emit("\t.quad\tL%d\n", default_label);
     cglabel(top_label);
-    fprintf(outfile, "\tmovq\t%s, %%rax\n", register_list[reg]);
-    fprintf(outfile, "\tleaq\tL%d(%%rip), %%rdx\n", l);
-    fprintf(outfile, "\tjmp\tswitch\n");
+    emit("\tmovq\t%R, %%rax\n", reg);
+    emit("\tleaq\tL%d(%%rip), %%rdx\n", l);
+    emit_clobber(REGISTER_BIT(R_RDX));
+    emit("\tjmp\tswitch\n");
+    emit_clobber(ALL_REGISTERS);
 }
\ No newline at end of file
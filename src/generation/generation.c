@@ -1,184 +1,77 @@
 #include "../include/generation.h"
 
-// Forward declarations
-static int generate_if_AST(t_astnode* n, int loop_start_label, int loop_end_label);
-static int generate_while_AST(t_astnode* n);
-static int generate_switch_AST(t_astnode* n);
-
-static int generate_function_call(t_astnode* n);
-
-
-/*
-    Given AST, the register (if available) that holds
-    the previous rvalue, and the AST op of the parent,
-    generate assembly code.
-
-    Return register index with the tree's final value.
-*/
-int generate_ast(t_astnode* n,
-                 int if_label,
-                 int loop_start_label,
-                 int loop_end_label,
-                 int parent_ast_op) {
-    if (n == NULL) {
-        return NOREG;
+// Labels of the string literals emitted to the current file, keyed by
+// the interned text, so every literal is emitted once per file
+typedef struct string_label {
+    char* text;
+    int label;
+} t_string_label;
+
+static t_string_label* string_labels;
+static unsigned int string_capacity;
+static unsigned int string_count;
+
+static t_string_label* find_string_label(char* text) {
+    uintptr_t h = (uintptr_t)text * 0x9e3779b97f4a7c15ull;
+    unsigned int mask = string_capacity - 1;
+    unsigned int i;
+
+    for (i = (h >> 32) & mask; string_labels[i].text != NULL; i = (i + 1) & mask) {
+        if (string_labels[i].text == text) {
+            break;
+        }
     }
 
-    int leftreg, rightreg;
-
-    switch (n->op) {
-        case A_IF:
-            return generate_if_AST(n, loop_start_label, loop_end_label);
-        case A_WHILE:
-            return generate_while_AST(n);
-        case A_GLUE:
-            generate_ast(n->left, if_label, loop_start_label, loop_end_label, n->op);
-            generate_free_registers();
-            generate_ast(n->right, if_label, loop_start_label, loop_end_label, n->op);
-            generate_free_registers();
-            return NOREG;
-        case A_FUNCTION:
-            cgfunctionpreamble(n->symbol);
-            generate_ast(n->left, if_label, loop_start_label, loop_end_label, n->op);
-            cgfunctionpostamble(n->symbol);
-            return NOREG;
-        case A_FUNCTION_CALL:
-            return generate_function_call(n);
-        case A_SWITCH:
-            return generate_switch_AST(n);
-    }
+    return &string_labels[i];
+}
 
-    if (n->left) {
-        leftreg = generate_ast(n->left, if_label, loop_start_label, loop_end_label, n->op);
-    }
+static void grow_string_labels(void) {
+    t_string_label* old = string_labels;
+    unsigned int old_capacity = string_capacity;
+
+    string_capacity = old_capacity ? old_capacity * 2 : 64;
+    string_labels = calloc(string_capacity, sizeof(t_string_label));
 
-    if (n->right) {
-        rightreg = generate_ast(n->right, if_label, loop_start_label, loop_end_label, n->op);
+    if (string_labels == NULL) {
+        fprintf(stderr, "Out of memory for string literals\n");
+        exit(1);
     }
 
-    switch (n->op) {
-        case A_BREAK: cgjump(loop_end_label); return NOREG;
-        case A_CONTINUE: cgjump(loop_start_label); return NOREG;
-        case A_ADD: return cgadd(leftreg, rightreg);
-        case A_SUBTRACT: return cgsub(leftreg, rightreg);
-        case A_MULTIPLY: return cgmul(leftreg, rightreg);
-        case A_DIVIDE: return cgdiv(leftreg, rightreg);
-        case A_INTLIT: return cgloadint(n->value);
-        case A_LSHIFT: return cgshift_l(leftreg, rightreg);
-        case A_RSHIFT: return cgshift_r(leftreg, rightreg);
-        case A_OR: return cg_or(leftreg, rightreg);
-        case A_AND: return cg_and(leftreg, rightreg);
-        case A_LOGIC_NOT: return cg_logic_not(leftreg);
-        case A_IDENTIFIER:
-            if (n->symbol->class == C_LOCAL || n->symbol->class == C_PARAMETER) {
-                return cgloadlocal(n->symbol, n->op);
-            } else {
-                return cgloadglob(n->symbol, n->op);
-            }
-        case A_ASSIGN: 
-            switch (n->right->op) {
-                case A_IDENTIFIER: 
-                    if (n->right->symbol->class == C_LOCAL) {
-                        return cgstorelocal(leftreg, n->right->symbol);
-                    } else {
-                        return cgstoreglob(leftreg, n->right->symbol);
-                    }
-                case A_DEREFERENCE:
-                    return (cgstorderef(leftreg, rightreg, n->right->type));
-                default: fprintf(stderr, "Cant assign in generate_ast(), op: %d\n", n->op);
-            }
-        case A_EQUALS:
-        case A_NOT_EQUAL:
-        case A_LESS_THAN:
-        case A_GREATER_THAN:
-        case A_LESS_EQUAL:
-        case A_GREATER_EQUAL:
-            if (parent_ast_op == A_IF || parent_ast_op == A_WHILE) {
-                return cgcompare_and_jump(n->op, leftreg, rightreg, if_label);
-            } else {
-                return cgcompare_and_set(n->op, leftreg, rightreg);
-            }
-        case A_WIDEN:
-            // Widen children type to parent type
-            return cgwiden(leftreg, n->left->type, n->type);
-        case A_RETURN:
-            cgreturn(leftreg, function_id);
-            return NOREG;
-        case A_FUNCTION_CALL:
-            return generate_function_call(n);
-        case A_ADDR:
-            return cgaddress(n->symbol);
-        case A_DEREFERENCE:
-            // If rvalue -> dereference, else leave for for assignment to store through pointer
-            if (n->rvalue) {
-                return cgderef(leftreg, n->left->type);
-            } else {
-                return leftreg;
-            }
-        case A_INVERT: return cg_invert(leftreg);
-        case A_NEGATE: return cg_negate(leftreg);
-        case A_POST_INCREMENT:
-        case A_POST_DECREMENT:
-                if (n->symbol->class == C_GLOBAL) {
-                    return cgloadglob(n->symbol, n->op);
-                } else {
-                    return cgloadlocal(n->symbol, n->op);
-                }
-        case A_PRE_INCREMENT:
-        case A_PRE_DECREMENT:
-            if (n->symbol->class == C_GLOBAL) {
-                return cgloadglob(n->left->symbol, n->op);
-            } else {
-                return cgloadlocal(n->left->symbol, n->op);
-            }
-        case A_SCALE:
-            switch (n->size) {
-                case 2: return cgshlconst(leftreg, 1);
-                case 4: return cgshlconst(leftreg, 2);
-                case 8: return cgshlconst(leftreg, 3);
-                default:
-                    rightreg = cgloadint(n->size);
-                    return cgmul(leftreg, rightreg);
-            }
-        case A_STRLIT:
-            return cgloadglobstr(n->value);
-        case A_XOR:
-            return cgxor(leftreg, rightreg);
-        default:
-            fprintf(stderr, "Unknown AST operator %d\n", n->op);
-            exit(1);
+    for (unsigned int i = 0; i < old_capacity; i++) {
+        if (old[i].text != NULL) {
+            *find_string_label(old[i].text) = old[i];
+        }
     }
 
-    return NOREG;
+    free(old);
 }
 
-static int generate_function_call(t_astnode* n) {
-    t_astnode* gluetree = n->left;
-    int reg;
-    int args = 0;
+int generate_global_string(char* text) {
+    t_string_label* s;
 
-    while (gluetree) {
-        reg = generate_ast(gluetree->right, NOLABEL, NOLABEL, NOLABEL, gluetree->op);
+    if ((string_count + 1) * 2 > string_capacity) {
+        grow_string_labels();
+    }
 
-        // Copy into nth function parameter
-        cg_copy_argument(reg, gluetree->size);
+    if ((s = find_string_label(text))->text != NULL) {
+        return s->label;
+    }
 
-        // Keep number of arguments
-        args = (args == 0) ? gluetree->size : args;
+    s->text = text;
+    s->label = label();
+    string_count++;
 
-        generate_free_registers();
-        gluetree = gluetree->left;
-    }
+    cgglobstr(s->label, text);
 
-    return cgcall(n->symbol, args);
+    return s->label;
 }
 
-int generate_global_string(char* text) {
-    int l = label();
-
-    cgglobstr(l, text);
+void clear_global_strings(void) {
+    if (string_labels != NULL) {
+        memset(string_labels, 0, string_capacity * sizeof(t_string_label));
+    }
 
-    return l;
+    string_count = 0;
 }
 
 int label(void) {
@@ -186,106 +79,430 @@ int label(void) {
     return id++;
 }
 
-static int generate_if_AST(t_astnode* n,
-                           int loop_start_label,
-                           int loop_end_label) {
-    int lfalse, lend;
+void generate_global_symbol(t_symbol_entry* symbol) {
+    cgglobsym(symbol);
+}
+// Registers of the IR being emitted. A virtual register of the IR that
+// is defined more than once is fixed to one register of the code
+// generator, the others take over the register their defining
+// instruction left the result in. Blocks are laid out after their
+// dominators, so that definition is emitted before the uses.
+static int* reg_of;
+static char* fixed;
+
+// Registers defined once by IR_CONST get no register of their own. The
+// value becomes an immediate operand where the instruction has a form
+// for it and is loaded at the use otherwise.
+static char* constant;
+static int* constant_value;
+
+// Return the register of operand v, a constant is loaded into a new one.
+static int reg(int v) {
+    return constant[v] ? cgloadint(constant_value[v]) : reg_of[v];
+}
 
-    // Two labels:
-    //      one for false statement
-    //      one for end of if statement
-    lfalse = label();
+// Return the register of operand v of ins that the instruction may
+// overwrite: its own register after its last use, else a copy.
+static int take(t_ir_instr* ins, int v, int dead) {
+    if (constant[v]) {
+        return cgloadint(constant_value[v]);
+    }
 
-    if (n->right) {
-        lend = label();
+    if ((ins->dead & dead) && !fixed[v]) {
+        return reg_of[v];
     }
 
-    generate_ast(n->left, lfalse, NOLABEL, NOLABEL, n->op);
-    generate_free_registers();
+    return cgcopy(reg_of[v]);
+}
 
-    generate_ast(n->middle, NOLABEL, loop_start_label, loop_end_label, n->op);
-    generate_free_registers();
+static void define(t_ir_instr* ins, int r) {
+    if (!fixed[ins->dst]) {
+        reg_of[ins->dst] = r;
+    } else if (r != reg_of[ins->dst]) {
+        cgmove(r, reg_of[ins->dst]);
+    }
+}
 
-    if (n->right) {
-        cgjump(lend);
+// Keep the registers of the set alive at this point of the code.
+static void use_live(t_ir_function* fn, unsigned long* live) {
+    for (int i = 0; i < fn->nglobals; i++) {
+        if (IR_TEST(live, i) && !constant[fn->global_vreg[i]]) {
+            emit_use(reg_of[fn->global_vreg[i]]);
+        }
     }
+}
+
+// Cases with fewer values in their range are compared one by one
+#define MIN_TABLE_CASES 4
+
+// Percentage of the entries of a jump table that must be cases
+#define MIN_TABLE_DENSITY 40
 
-    cglabel(lfalse);
+typedef struct switch_case {
+    int value;
+    int label;
+} t_switch_case;
 
-    if (n->right) {
-        generate_ast(n->right, NOLABEL, NOLABEL, NOLABEL, n->op);
-        generate_free_registers();
-        cglabel(lend);
+// Run of cases dispatched through one jump table, or one case
+typedef struct case_cluster {
+    int first;
+    int count;
+} t_case_cluster;
+
+int linear_switch;
+
+static t_switch_case* switch_cases;
+static t_case_cluster* switch_clusters;
+static int switch_reg, switch_default;
+
+static void generate_table(t_case_cluster* c) {
+    int low = switch_cases[c->first].value;
+    int count = switch_cases[c->first + c->count - 1].value - low + 1;
+    int* labels = arena_alloc(&ir_arena, count * sizeof(int));
+
+    for (int i = 0; i < count; i++) {
+        labels[i] = switch_default;
     }
 
-    return NOREG;
+    for (int i = c->first; i < c->first + c->count; i++) {
+        labels[switch_cases[i].value - low] = switch_cases[i].label;
+    }
+
+    cgjumptable(switch_reg, low, count, labels, switch_default);
 }
 
-static int generate_while_AST(t_astnode* n) {
-    int lstart, lend;
+// Dispatch over the clusters [lo, hi) by a balanced tree of compares
+// against the lowest value of the middle cluster.
+static void generate_cluster_tree(int lo, int hi) {
+    int singles = 1;
+    int upper;
+
+    for (int i = lo; i < hi; i++) {
+        singles = singles && switch_clusters[i].count == 1;
+    }
 
-    lstart = label();
-    lend = label();
-    cglabel(lstart);
+    if (hi - lo == 1 && !singles) {
+        generate_table(&switch_clusters[lo]);
+        return;
+    }
 
-    generate_ast(n->left, lend, lstart, lend, n->op);
-    generate_free_registers();
+    if (hi - lo <= 3 && singles) {
+        for (int i = lo; i < hi; i++) {
+            t_switch_case* c = &switch_cases[switch_clusters[i].first];
+            cgcompare_const_and_jump(A_NOT_EQUAL, switch_reg, c->value, c->label);
+        }
 
-    generate_ast(n->right, NOLABEL, lstart, lend, n->op);
-    generate_free_registers();
+        cgjump(switch_default);
+        return;
+    }
 
-    cgjump(lstart);
-    cglabel(lend);
+    int mid = lo + (hi - lo) / 2;
+    upper = label();
 
-    return NOREG;
+    cgcompare_const_and_jump(A_LESS_THAN, switch_reg, switch_cases[switch_clusters[mid].first].value, upper);
+    generate_cluster_tree(lo, mid);
+    cglabel(upper);
+    generate_cluster_tree(mid, hi);
 }
 
-int generate_switch_AST(t_astnode* n) {
-    int *case_value, *case_label;
-    int label_jmp_top, label_end, label_default;
+// Dense runs of cases go through jump tables, the runs and the
+// remaining sparse cases are found by a compare tree. The case values
+// come sorted from the parser.
+static void generate_switch(t_ir_instr* ins) {
+    int n = ins->argc;
+    int clusters = 0;
+    int i, j;
 
-    int reg;
-    int case_count = 0;
+    switch_reg = reg(ins->src1);
+    switch_default = ins->targets[n]->label;
 
-    case_value = (int*)malloc(sizeof(int) * (n->value + 1));
-    case_label = (int*)malloc(sizeof(int) * (n->value + 1));
+    if (n == 0) {
+        cgjump(switch_default);
+        return;
+    }
 
-   label_jmp_top = label();
-   label_end = label();
+    switch_cases = arena_alloc(&ir_arena, n * sizeof(t_switch_case));
+    switch_clusters = arena_alloc(&ir_arena, n * sizeof(t_case_cluster));
 
-   label_default = label_end;
+    for (i = 0; i < n; i++) {
+        switch_cases[i].value = ins->args[i];
+        switch_cases[i].label = ins->targets[i]->label;
+    }
+
+    // Grow every run while it stays dense enough
+    for (i = 0; i < n; i = j) {
+        for (j = i + 1; j < n; j++) {
+            long long range = (long long)switch_cases[j].value - switch_cases[i].value + 1;
 
-   reg = generate_ast(n->left, NOLABEL, NOLABEL, NOLABEL, 0);
-   cgjump(label_jmp_top);
-   generate_free_registers();
+            if ((long long)(j - i + 1) * 100 < MIN_TABLE_DENSITY * range) {
+                break;
+            }
+        }
 
-   int i;
-   t_astnode * c;
-   for (i = 0, c = n->right; c != NULL; i++, c = c->right) {
-       case_label[i] = label();
-       case_value[i] = c->value;
+        if (j - i < MIN_TABLE_CASES) {
+            j = i + 1;
+        }
 
-       cglabel(case_label[i]);
+        switch_clusters[clusters].first = i;
+        switch_clusters[clusters++].count = j - i;
+    }
 
-       if (c->op == A_DEFAULT) {
-           label_default = case_label[i];
-       } else {
-           case_count++;
-       }
+    generate_cluster_tree(0, clusters);
+}
 
-       generate_ast(c->left, NOLABEL, NOLABEL, label_end, 0);
-       generate_free_registers();
-   }
+// Comparison with the operands swapped, by IR_EQ .. IR_GE
+static const int swapped_comparison[] = { IR_EQ, IR_NE, IR_GT, IR_LT, IR_GE, IR_LE };
+
+// Comparison that holds when the one given does not, by IR_EQ .. IR_GE
+static const int inverted_comparison[] = { IR_NE, IR_EQ, IR_GE, IR_LE, IR_GT, IR_LT };
+
+// Emit an operation whose operands may be swapped, taking a constant
+// operand as immediate.
+static void generate_commutative(t_ir_instr* ins, int ASTop, int (*cg)(int r1, int r2)) {
+    if (constant[ins->src2]) {
+        define(ins, cgarithconst(ASTop, take(ins, ins->src1, IR_DEAD_SRC1), constant_value[ins->src2]));
+    } else if (constant[ins->src1]) {
+        define(ins, cgarithconst(ASTop, take(ins, ins->src2, IR_DEAD_SRC2), constant_value[ins->src1]));
+    } else {
+        define(ins, cg(reg_of[ins->src1], take(ins, ins->src2, IR_DEAD_SRC2)));
+    }
+}
 
-   cgjump(label_end);
+// Emit a comparison that sets a register or, for IR_BRANCH, jumps,
+// comparing against a constant operand as immediate.
+static void generate_comparison(t_ir_instr* ins, int op, int label) {
+    int src1 = ins->src1, src2 = ins->src2;
 
-   cgswitch(reg, case_count, label_jmp_top, case_label, case_value, label_default);
-   cglabel(label_end);
+    if (constant[src1] && !constant[src2]) {
+        src1 = ins->src2;
+        src2 = ins->src1;
+        op = swapped_comparison[op - IR_EQ];
+    }
 
-   return NOREG;
+    if (constant[src2]) {
+        int r = reg(src1);
+
+        if (ins->op == IR_BRANCH) {
+            cgcompare_const_and_jump(A_EQUALS + op - IR_EQ, r, constant_value[src2], label);
+        } else {
+            define(ins, cgcompare_const_and_set(A_EQUALS + op - IR_EQ, r, constant_value[src2]));
+        }
+    } else if (ins->op == IR_BRANCH) {
+        cgcompare_and_jump(A_EQUALS + op - IR_EQ, reg_of[src1], reg_of[src2], label);
+    } else {
+        define(ins, cgcompare_and_set(A_EQUALS + op - IR_EQ, reg_of[src1], take(ins, src2, IR_DEAD_SRC2)));
+    }
 }
 
+static void generate_instruction(t_ir_function* fn, t_ir_instr* ins) {
+    t_ir_block* next = ins->block->next;
+    int* labels;
+    int top;
+
+    switch (ins->op) {
+        case IR_CONST:
+            if (fixed[ins->dst]) {
+                cgmoveint(ins->value, reg_of[ins->dst]);
+            } else if (!constant[ins->dst]) {
+                define(ins, cgloadint(ins->value));
+            }
+            break;
+        case IR_COPY:
+            if (fixed[ins->dst] && constant[ins->src1]) {
+                cgmoveint(constant_value[ins->src1], reg_of[ins->dst]);
+            } else if (fixed[ins->dst]) {
+                cgmove(reg_of[ins->src1], reg_of[ins->dst]);
+            } else {
+                define(ins, take(ins, ins->src1, IR_DEAD_SRC1));
+            }
+            break;
+        case IR_TRUNCATE: define(ins, cgtruncate(take(ins, ins->src1, IR_DEAD_SRC1), ins->type)); break;
+        case IR_STRING: define(ins, cgloadglobstr(ins->value)); break;
+        case IR_ADDRESS: define(ins, cgaddress(ins->symbol)); break;
+        case IR_PARAM: define(ins, cgparameter(ins->value)); break;
+        case IR_LOAD_LOCAL: define(ins, cgloadlocal(ins->symbol, ins->value)); break;
+        case IR_LOAD_GLOBAL: define(ins, cgloadglob(ins->symbol, ins->value)); break;
+
+        case IR_STORE_LOCAL:
+            if (constant[ins->src1]) {
+                cgstorelocalconst(constant_value[ins->src1], ins->symbol);
+            } else {
+                cgstorelocal(reg_of[ins->src1], ins->symbol);
+            }
+            break;
+        case IR_STORE_GLOBAL:
+            if (constant[ins->src1]) {
+                cgstoreglobconst(constant_value[ins->src1], ins->symbol);
+            } else {
+                cgstoreglob(reg_of[ins->src1], ins->symbol);
+            }
+            break;
+        case IR_LOAD: define(ins, cgderef(take(ins, ins->src1, IR_DEAD_SRC1), ins->type)); break;
+        case IR_STORE:
+            if (constant[ins->src1]) {
+                cgstorderefconst(constant_value[ins->src1], reg(ins->src2), ins->type);
+            } else {
+                cgstorderef(reg_of[ins->src1], reg(ins->src2), ins->type);
+            }
+            break;
+
+        // The emitters leave the result in the register of one operand
+        case IR_ADD: generate_commutative(ins, A_ADD, cgadd); break;
+        case IR_MUL: generate_commutative(ins, A_MULTIPLY, cgmul); break;
+        case IR_AND: generate_commutative(ins, A_AND, cg_and); break;
+        case IR_OR: generate_commutative(ins, A_OR, cg_or); break;
+        case IR_XOR: generate_commutative(ins, A_XOR, cgxor); break;
+        case IR_SUB:
+            if (constant[ins->src2]) {
+                define(ins, cgarithconst(A_SUBTRACT, take(ins, ins->src1, IR_DEAD_SRC1), constant_value[ins->src2]));
+            } else {
+                define(ins, cgsub(take(ins, ins->src1, IR_DEAD_SRC1), reg_of[ins->src2]));
+            }
+            break;
+        case IR_DIV:
+        case IR_MOD:
+            if (constant[ins->src2] && constant_value[ins->src2] != 0) {
+                define(ins, cgarithconst(ins->op == IR_DIV ? A_DIVIDE : A_MOD,
+                                         take(ins, ins->src1, IR_DEAD_SRC1), constant_value[ins->src2]));
+            } else if (ins->op == IR_DIV) {
+                define(ins, cgdiv(take(ins, ins->src1, IR_DEAD_SRC1), reg(ins->src2)));
+            } else {
+                define(ins, cgmod(take(ins, ins->src1, IR_DEAD_SRC1), reg(ins->src2)));
+            }
+            break;
+        case IR_SHL: define(ins, cgshift_l(take(ins, ins->src1, IR_DEAD_SRC1), reg(ins->src2))); break;
+        case IR_SHR: define(ins, cgshift_r(take(ins, ins->src1, IR_DEAD_SRC1), reg(ins->src2))); break;
+        case IR_SHL_CONST: define(ins, cgshlconst(take(ins, ins->src1, IR_DEAD_SRC1), ins->value)); break;
+        case IR_NEG: define(ins, cg_negate(take(ins, ins->src1, IR_DEAD_SRC1))); break;
+        case IR_INVERT: define(ins, cg_invert(take(ins, ins->src1, IR_DEAD_SRC1))); break;
+        case IR_LOGIC_NOT: define(ins, cg_logic_not(take(ins, ins->src1, IR_DEAD_SRC1))); break;
+
+        case IR_EQ:
+        case IR_NE:
+        case IR_LT:
+        case IR_GT:
+        case IR_LE:
+        case IR_GE:
+            generate_comparison(ins, ins->op, 0);
+            break;
+
+        case IR_CALL:
+            // All arguments are computed, so no call in between
+            // destroys the ones already in their registers
+            for (int i = ins->argc; i > 0; i--) {
+                if (constant[ins->args[i - 1]]) {
+                    cg_copy_argument_const(constant_value[ins->args[i - 1]], i);
+                } else {
+                    cg_copy_argument(reg_of[ins->args[i - 1]], i);
+                }
+            }
 
-void generate_global_symbol(t_symbol_entry* symbol) {
-    cgglobsym(symbol);
-}
\ No newline at end of file
+            define(ins, cgcall(ins->symbol, ins->argc));
+            break;
+
+        case IR_JUMP:
+            use_live(fn, ins->block->live_out);
+
+            if (ins->targets[0] != next) {
+                cgjump(ins->targets[0]->label);
+            }
+            break;
+
+        case IR_BRANCH:
+            // The comparison jumps unless it holds, so when the false
+            // target comes next it is inverted to jump to the true one
+            if (ins->targets[0] != next && ins->targets[1] == next) {
+                generate_comparison(ins, inverted_comparison[ins->value - IR_EQ], ins->targets[0]->label);
+            } else {
+                generate_comparison(ins, ins->value, ins->targets[1]->label);
+
+                if (ins->targets[0] != next) {
+                    cgjump(ins->targets[0]->label);
+                }
+            }
+
+            use_live(fn, ins->block->live_out);
+            break;
+
+        case IR_SWITCH:
+            if (linear_switch) {
+                labels = arena_alloc(&ir_arena, (ins->argc + 1) * sizeof(int));
+
+                for (int i = 0; i < ins->argc; i++) {
+                    labels[i] = ins->targets[i]->label;
+                }
+
+                // The table is placed before the dispatch, cgswitch() needs
+                // room for one entry even without cases
+                top = label();
+                cgjump(top);
+                cgswitch(reg(ins->src1), ins->argc, top, labels,
+                         ins->argc ? ins->args : arena_alloc(&ir_arena, sizeof(int)),
+                         ins->targets[ins->argc]->label);
+            } else {
+                generate_switch(ins);
+            }
+
+            use_live(fn, ins->block->live_out);
+            break;
+
+        case IR_RETURN:
+            if (ins->src1 != NOREG && constant[ins->src1]) {
+                cgreturnconst(constant_value[ins->src1], fn->symbol);
+            } else if (ins->src1 != NOREG) {
+                cgreturn(reg_of[ins->src1], fn->symbol);
+            }
+
+            if (next != NULL) {
+                cgjump(fn->symbol->endlabel);
+            }
+            break;
+
+        default:
+            fprintf(stderr, "Unknown IR operator %d\n", ins->op);
+            exit(1);
+    }
+}
+
+void generate_ir(t_ir_function* fn) {
+    cgfunctionpreamble(fn->symbol);
+    ir_liveness(fn);
+
+    for (t_ir_instr* ins = fn->first->first; ins != NULL; ins = ins->next) {
+        if (ins->op == IR_PARAM) {
+            cgholdparameter(ins->value);
+        }
+    }
+
+    reg_of = arena_alloc(&ir_arena, (fn->nvregs + 1) * sizeof(int));
+    fixed = arena_alloc(&ir_arena, fn->nvregs + 1);
+    constant = arena_alloc(&ir_arena, fn->nvregs + 1);
+    constant_value = arena_alloc(&ir_arena, (fn->nvregs + 1) * sizeof(int));
+
+    for (t_ir_block* b = fn->first; b != NULL; b = b->next) {
+        for (t_ir_instr* ins = b->first; ins != NULL; ins = ins->next) {
+            if (ins->op == IR_CONST && fn->defs[ins->dst] == 1) {
+                constant[ins->dst] = 1;
+                constant_value[ins->dst] = ins->value;
+            }
+        }
+    }
+
+    for (int v = 0; v < fn->nvregs; v++) {
+        if (fn->defs[v] != 1) {
+            fixed[v] = 1;
+            reg_of[v] = new_vreg();
+        }
+    }
+
+    for (t_ir_block* b = fn->first; b != NULL; b = b->next) {
+        cglabel(b->label);
+        use_live(fn, b->live_in);
+
+        for (t_ir_instr* ins = b->first; ins != NULL; ins = ins->next) {
+            generate_instruction(fn, ins);
+        }
+    }
+
+    cgfunctionpostamble(fn->symbol);
+}
@@ -0,0 +1,53 @@
+#include <string.h>
+#include <unistd.h>
+
+#include "../../include/output.h"
+
+static char* buffer;
+static size_t used, capacity;
+
+void out_flush(void) {
+    size_t done = 0;
+
+    while (done < used) {
+        ssize_t n = write(fileno(outfile), buffer + done, used - done);
+
+        if (n < 0) {
+            report_error("out_flush(): write() failed.\n");
+        }
+
+        done += n;
+    }
+
+    used = 0;
+}
+
+void out_write(const char* s, size_t n) {
+    if (used + n > capacity) {
+        if (used > 0) {
+            out_flush();
+        }
+
+        // Text larger than a block gets a buffer of its size. Like stdio,
+        // what is buffered is still written when the compiler exits on
+        // an error.
+        if (n > capacity) {
+            if (buffer == NULL) {
+                atexit(out_flush);
+            }
+
+            capacity = n > OUTPUT_BLOCK_SIZE ? n : OUTPUT_BLOCK_SIZE;
+
+            if ((buffer = realloc(buffer, capacity)) == NULL) {
+                report_error("out_write(): realloc() failed.\n");
+            }
+        }
+    }
+
+    memcpy(buffer + used, s, n);
+    used += n;
+}
+
+void out_string(const char* s) {
+    out_write(s, strlen(s));
+}
@@ -0,0 +1,754 @@
+#include <string.h>
+
+#include "../../include/peephole.h"
+#include "../../include/output.h"
+
+#define MAX_OPERANDS 3
+
+// Paths followed when looking for the next use of a register
+#define SCAN_BUDGET 128
+
+enum { P_INSTRUCTION, P_LABEL, P_DIRECTIVE };
+
+enum {
+    NO_RULE = -1,
+    RULE_MOVE, RULE_JUMP_TO_NEXT, RULE_THREAD, RULE_FUSE, RULE_XOR, NUM_RULES
+};
+
+// x86 registers, as bits of a register set
+enum {
+    X_RAX, X_RBX, X_RCX, X_RDX, X_RSI, X_RDI, X_RBP, X_RSP,
+    X_R8, X_R9, X_R10, X_R11, X_R12, X_R13, X_R14, X_R15
+};
+
+#define X(r) (1u << (r))
+#define X_ALL 0xffffu
+#define X_ARGUMENTS (X(X_RDI) | X(X_RSI) | X(X_RDX) | X(X_RCX) | X(X_R8) | X(X_R9))
+#define X_CALLER_SAVED (X_ARGUMENTS | X(X_RAX) | X(X_R10) | X(X_R11))
+
+typedef struct asm_line {
+    int kind;
+    char* text;                     // Line as emitted, written while unchanged
+    char* op;                       // Mnemonic, or name of the label
+    char* operand[MAX_OPERANDS];
+    int operands;
+    int target;                     // Label number defined or jumped to, -1 if none
+    int changed;
+    int deleted;
+} t_asm_line;
+
+// Effect of an instruction on the registers and flags
+typedef struct effect {
+    unsigned int reads;
+    unsigned int writes;            // Written as a whole
+    int reads_flags;
+    int writes_flags;
+    int unknown;                    // Anything may be read
+} t_effect;
+
+static const struct {
+    char* name;
+    int reg;
+    int bytes;
+} register_names[] = {
+    { "rax", X_RAX, 8 }, { "eax", X_RAX, 4 }, { "ax", X_RAX, 2 }, { "al", X_RAX, 1 },
+    { "rbx", X_RBX, 8 }, { "ebx", X_RBX, 4 }, { "bx", X_RBX, 2 }, { "bl", X_RBX, 1 },
+    { "rcx", X_RCX, 8 }, { "ecx", X_RCX, 4 }, { "cx", X_RCX, 2 }, { "cl", X_RCX, 1 },
+    { "rdx", X_RDX, 8 }, { "edx", X_RDX, 4 }, { "dx", X_RDX, 2 }, { "dl", X_RDX, 1 },
+    { "rsi", X_RSI, 8 }, { "esi", X_RSI, 4 }, { "si", X_RSI, 2 }, { "sil", X_RSI, 1 },
+    { "rdi", X_RDI, 8 }, { "edi", X_RDI, 4 }, { "di", X_RDI, 2 }, { "dil", X_RDI, 1 },
+    { "rbp", X_RBP, 8 }, { "ebp", X_RBP, 4 }, { "bp", X_RBP, 2 }, { "bpl", X_RBP, 1 },
+    { "rsp", X_RSP, 8 }, { "esp", X_RSP, 4 }, { "sp", X_RSP, 2 }, { "spl", X_RSP, 1 },
+    { "r8", X_R8, 8 }, { "r8d", X_R8, 4 }, { "r8w", X_R8, 2 }, { "r8b", X_R8, 1 },
+    { "r9", X_R9, 8 }, { "r9d", X_R9, 4 }, { "r9w", X_R9, 2 }, { "r9b", X_R9, 1 },
+    { "r10", X_R10, 8 }, { "r10d", X_R10, 4 }, { "r10w", X_R10, 2 }, { "r10b", X_R10, 1 },
+    { "r11", X_R11, 8 }, { "r11d", X_R11, 4 }, { "r11w", X_R11, 2 }, { "r11b", X_R11, 1 },
+    { "r12", X_R12, 8 }, { "r12d", X_R12, 4 }, { "r12w", X_R12, 2 }, { "r12b", X_R12, 1 },
+    { "r13", X_R13, 8 }, { "r13d", X_R13, 4 }, { "r13w", X_R13, 2 }, { "r13b", X_R13, 1 },
+    { "r14", X_R14, 8 }, { "r14d", X_R14, 4 }, { "r14w", X_R14, 2 }, { "r14b", X_R14, 1 },
+    { "r15", X_R15, 8 }, { "r15d", X_R15, 4 }, { "r15w", X_R15, 2 }, { "r15b", X_R15, 1 },
+};
+
+// Condition codes of setcc and jcc, with their negation
+static const struct {
+    char* code;
+    char* inverse;
+} conditions[] = {
+    { "e", "ne" }, { "ne", "e" }, { "l", "ge" }, { "ge", "l" }, { "g", "le" }, { "le", "g" },
+};
+
+static char* rule_names[NUM_RULES] = {
+    "redundant moves", "jumps to the next instruction", "jumps threaded",
+    "compares and branches fused", "zeroing xors"
+};
+
+static t_arena peephole_arena;
+static t_asm_line* lines;
+static int line_count, line_capacity;
+
+// Line of every label of the function, by label number - first_label
+static int* label_line;
+static int first_label, label_range;
+
+static int statistics[NUM_RULES];
+
+static char* copy(const char* s, size_t n) {
+    char* p = arena_alloc(&peephole_arena, n + 1);
+    memcpy(p, s, n);
+    return p;
+}
+
+static int is_space(char c) {
+    return c == ' ' || c == '\t';
+}
+
+// Return the number of label L<n>, -1 for another name.
+static int label_number(const char* name) {
+    int n = 0;
+
+    if (name[0] != 'L' || name[1] < '0' || name[1] > '9') {
+        return -1;
+    }
+
+    for (name++; *name >= '0' && *name <= '9'; name++) {
+        n = n * 10 + *name - '0';
+    }
+
+    return *name == '\0' ? n : -1;
+}
+
+// Split one line, without its newline, into a record.
+static void parse_line(t_asm_line* l, const char* s, size_t n) {
+    const char* end = s + n;
+    const char* p = s;
+    const char* start;
+    int depth = 0;
+
+    l->text = copy(s, n);
+    l->target = -1;
+
+    if (n > 0 && s[n - 1] == ':') {
+        l->kind = P_LABEL;
+        l->op = copy(s, n - 1);
+        l->target = label_number(l->op);
+        return;
+    }
+
+    while (p < end && is_space(*p)) {
+        p++;
+    }
+
+    for (start = p; p < end && !is_space(*p); p++);
+    l->op = copy(start, p - start);
+    l->kind = l->op[0] == '.' ? P_DIRECTIVE : P_INSTRUCTION;
+
+    // Operands are separated by commas outside of parentheses
+    while (p < end) {
+        while (p < end && is_space(*p)) {
+            p++;
+        }
+
+        if (p == end || l->operands == MAX_OPERANDS) {
+            break;
+        }
+
+        for (start = p; p < end && (depth > 0 || *p != ','); p++) {
+            depth += (*p == '(') - (*p == ')');
+        }
+
+        const char* last = p;
+        while (last > start && is_space(last[-1])) {
+            last--;
+        }
+
+        l->operand[l->operands++] = copy(start, last - start);
+
+        if (p < end) {
+            p++;
+        }
+    }
+
+    if (l->op[0] == 'j' && l->operands == 1) {
+        l->target = label_number(l->operand[0]);
+    }
+}
+
+void peephole_begin(void) {
+    line_count = 0;
+    arena_reset(&peephole_arena);
+}
+
+void peephole_lines(const char* text, size_t n) {
+    const char* end = text + n;
+
+    while (text < end) {
+        const char* newline = memchr(text, '\n', end - text);
+        size_t length = newline ? (size_t)(newline - text) : (size_t)(end - text);
+
+        if (line_count == line_capacity) {
+            line_capacity = line_capacity ? line_capacity * 2 : 256;
+
+            if ((lines = realloc(lines, line_capacity * sizeof(t_asm_line))) == NULL) {
+                report_error("peephole_lines(): realloc() failed.\n");
+            }
+        }
+
+        memset(&lines[line_count], 0, sizeof(t_asm_line));
+        parse_line(&lines[line_count++], text, length);
+        text += length + 1;
+    }
+}
+
+// Return the register operand s names and its size in bytes, or -1.
+static int register_of(const char* s, int* bytes) {
+    if (s[0] != '%') {
+        return -1;
+    }
+
+    for (size_t i = 0; i < sizeof(register_names) / sizeof(register_names[0]); i++) {
+        if (strcmp(s + 1, register_names[i].name) == 0) {
+            if (bytes) {
+                *bytes = register_names[i].bytes;
+            }
+
+            return register_names[i].reg;
+        }
+    }
+
+    return -1;
+}
+
+// Return the registers mentioned anywhere in operand s.
+static unsigned int registers_in(const char* s) {
+    unsigned int set = 0;
+    char name[8];
+
+    for (; *s != '\0'; s++) {
+        size_t n = 0;
+
+        if (*s != '%') {
+            continue;
+        }
+
+        while (n < sizeof(name) - 1 && ((s[n + 1] >= 'a' && s[n + 1] <= 'z') || (s[n + 1] >= '0' && s[n + 1] <= '9'))) {
+            name[n] = s[n + 1];
+            n++;
+        }
+
+        name[n] = '\0';
+
+        for (size_t i = 0; i < sizeof(register_names) / sizeof(register_names[0]); i++) {
+            if (strcmp(name, register_names[i].name) == 0) {
+                set |= X(register_names[i].reg);
+            }
+        }
+    }
+
+    return set;
+}
+
+static int starts_with(const char* s, const char* prefix) {
+    return strncmp(s, prefix, strlen(prefix)) == 0;
+}
+
+// Account for a write of operand s. Writing part of a register keeps
+// the rest, so it reads the register as well.
+static void write_operand(t_effect* e, const char* s) {
+    int bytes;
+    int r = register_of(s, &bytes);
+
+    if (r < 0) {
+        e->reads |= registers_in(s);
+    } else if (bytes >= 4) {
+        e->writes |= X(r);
+    } else {
+        e->reads |= X(r);
+    }
+}
+
+static void effect_of(t_asm_line* l, t_effect* e) {
+    char* op = l->op;
+    int n = l->operands;
+
+    memset(e, 0, sizeof(t_effect));
+
+    if (l->kind != P_INSTRUCTION) {
+        e->unknown = l->kind == P_DIRECTIVE;
+        return;
+    }
+
+    for (int i = 0; i < n; i++) {
+        e->reads |= registers_in(l->operand[i]);
+    }
+
+    if (strcmp(op, "call") == 0) {
+        e->reads = X_ARGUMENTS | X(X_RAX);
+        e->writes = X_CALLER_SAVED;
+        e->writes_flags = 1;
+    } else if (strcmp(op, "ret") == 0) {
+        e->reads = (X_ALL & ~X_CALLER_SAVED) | X(X_RAX);
+    } else if (strcmp(op, "cqo") == 0) {
+        e->reads = X(X_RAX);
+        e->writes = X(X_RDX);
+    } else if (starts_with(op, "idiv")) {
+        e->reads |= X(X_RAX) | X(X_RDX);
+        e->writes = X(X_RAX) | X(X_RDX);
+        e->writes_flags = 1;
+    } else if (starts_with(op, "imul") && n == 1) {
+        e->reads |= X(X_RAX);
+        e->writes = X(X_RAX) | X(X_RDX);
+        e->writes_flags = 1;
+    } else if (starts_with(op, "push")) {
+        e->reads |= X(X_RSP);
+    } else if (starts_with(op, "pop") && n == 1) {
+        e->reads = X(X_RSP);
+        write_operand(e, l->operand[0]);
+    } else if (op[0] == 'j') {
+        e->reads_flags = strcmp(op, "jmp") != 0;
+    } else if (starts_with(op, "set") && n == 1) {
+        e->reads_flags = 1;
+        write_operand(e, l->operand[0]);
+    } else if ((starts_with(op, "mov") || starts_with(op, "lea")) && n == 2) {
+        e->reads = registers_in(l->operand[0]);
+        write_operand(e, l->operand[1]);
+    } else if (starts_with(op, "cmp") || starts_with(op, "test")) {
+        e->writes_flags = 1;
+    } else if (starts_with(op, "not") && n == 1) {
+        // Reads and writes its operand, the flags are left alone
+    } else if ((starts_with(op, "neg") || starts_with(op, "inc") || starts_with(op, "dec")) && n == 1) {
+        e->writes_flags = 1;
+    } else if (n == 3 && starts_with(op, "imul")) {
+        e->reads = registers_in(l->operand[0]) | registers_in(l->operand[1]);
+        write_operand(e, l->operand[2]);
+        e->writes_flags = 1;
+    } else if (n == 2 && (starts_with(op, "add") || starts_with(op, "sub") || starts_with(op, "imul")
+                          || starts_with(op, "and") || starts_with(op, "or") || starts_with(op, "xor")
+                          || starts_with(op, "sh") || starts_with(op, "sa"))) {
+        e->writes_flags = 1;
+    } else {
+        e->unknown = 1;
+    }
+}
+
+static int line_of_label(int label) {
+    if (label < first_label || label >= first_label + label_range) {
+        return -1;
+    }
+
+    return label_line[label - first_label];
+}
+
+// Return true if, on every path from line i on, the registers in set
+// and, if flags is set, the flags are written before they are read.
+static int dead_from(int i, unsigned int set, int flags) {
+    int stack[SCAN_BUDGET];
+    unsigned int stack_set[SCAN_BUDGET];
+    int stack_flags[SCAN_BUDGET];
+    int top = 0, budget = SCAN_BUDGET;
+    t_effect e;
+
+    stack[top] = i;
+    stack_set[top] = set;
+    stack_flags[top++] = flags;
+
+    while (top > 0) {
+        top--;
+        i = stack[top];
+        set = stack_set[top];
+        flags = stack_flags[top];
+
+        for (; i < line_count && (set != 0 || flags); i++) {
+            t_asm_line* l = &lines[i];
+
+            if (l->deleted || l->kind == P_LABEL) {
+                continue;
+            }
+
+            if (--budget == 0) {
+                return 0;
+            }
+
+            effect_of(l, &e);
+
+            if (e.unknown || (e.reads & set) || (flags && e.reads_flags)) {
+                return 0;
+            }
+
+            set &= ~e.writes;
+            flags = flags && !e.writes_flags;
+
+            if (l->op[0] == 'j') {
+                int target = line_of_label(l->target);
+
+                if (target < 0) {
+                    return 0;
+                }
+
+                if (top == SCAN_BUDGET) {
+                    return 0;
+                }
+
+                stack[top] = target;
+                stack_set[top] = set;
+                stack_flags[top++] = flags;
+
+                if (strcmp(l->op, "jmp") == 0) {
+                    break;
+                }
+            }
+
+            if (strcmp(l->op, "ret") == 0) {
+                break;
+            }
+        }
+    }
+
+    return 1;
+}
+
+// Return the line of the next instruction after line i, skipping labels
+// if labels is set, or -1.
+static int next_line(int i, int labels) {
+    for (i++; i < line_count; i++) {
+        if (lines[i].deleted) {
+            continue;
+        }
+
+        if (lines[i].kind == P_LABEL && labels) {
+            continue;
+        }
+
+        return i;
+    }
+
+    return -1;
+}
+
+static int is_move(t_asm_line* l) {
+    return l->kind == P_INSTRUCTION && strcmp(l->op, "movq") == 0 && l->operands == 2;
+}
+
+static int is_register_move(t_asm_line* l) {
+    return is_move(l) && register_of(l->operand[0], NULL) >= 0 && register_of(l->operand[1], NULL) >= 0;
+}
+
+// Delete line i, counted for rule unless it is NO_RULE: a rule that
+// removes several lines counts once.
+static void delete(int i, int rule) {
+    lines[i].deleted = 1;
+
+    if (rule != NO_RULE) {
+        statistics[rule]++;
+    }
+}
+
+// movq %a, %a, and movq %b, %a after movq %a, %b with neither register
+// written in between
+static int redundant_moves(void) {
+    int fired = 0;
+    t_effect e;
+
+    for (int i = 0; i < line_count; i++) {
+        t_asm_line* l = &lines[i];
+
+        if (l->deleted || !is_register_move(l)) {
+            continue;
+        }
+
+        if (strcmp(l->operand[0], l->operand[1]) == 0) {
+            delete(i, RULE_MOVE);
+            fired = 1;
+            continue;
+        }
+
+        unsigned int both = X(register_of(l->operand[0], NULL)) | X(register_of(l->operand[1], NULL));
+
+        for (int j = next_line(i, 0); j >= 0; j = next_line(j, 0)) {
+            t_asm_line* m = &lines[j];
+
+            if (m->kind != P_INSTRUCTION || m->op[0] == 'j' || strcmp(m->op, "ret") == 0) {
+                break;
+            }
+
+            if (is_register_move(m) && strcmp(m->operand[0], l->operand[1]) == 0
+                    && strcmp(m->operand[1], l->operand[0]) == 0) {
+                delete(j, RULE_MOVE);
+                fired = 1;
+                break;
+            }
+
+            effect_of(m, &e);
+
+            // Partial writes show up as reads, so any register destination
+            // other than of a compare ends the search
+            int last = m->operands > 0 ? register_of(m->operand[m->operands - 1], NULL) : -1;
+            int compare = starts_with(m->op, "cmp") || starts_with(m->op, "test") || starts_with(m->op, "push");
+
+            if (e.unknown || (e.writes & both) || (last >= 0 && (X(last) & both) && !compare)) {
+                break;
+            }
+        }
+    }
+
+    return fired;
+}
+
+// Change the condition of jump l to code.
+static void set_jump(t_asm_line* l, const char* code) {
+    size_t n = strlen(code);
+
+    l->op = arena_alloc(&peephole_arena, n + 2);
+    l->op[0] = 'j';
+    memcpy(l->op + 1, code, n);
+    l->changed = 1;
+}
+
+static int condition_of(const char* code) {
+    for (size_t i = 0; i < sizeof(conditions) / sizeof(conditions[0]); i++) {
+        if (strcmp(code, conditions[i].code) == 0) {
+            return i;
+        }
+    }
+
+    return -1;
+}
+
+// setcc %b; movzbq %b, %r; [movq $0, %z]; cmpq %z, %r | cmpq $0, %r | testq %r, %r;
+// je/jne L  =>  jcc L with the condition or its negation
+static int fuse_compares(void) {
+    int fired = 0;
+
+    for (int i = 0; i < line_count; i++) {
+        t_asm_line* set = &lines[i];
+        t_asm_line *extend, *zero = NULL, *test, *jump;
+        int k, j, cc, r, z = -1;
+
+        if (set->deleted || set->kind != P_INSTRUCTION || !starts_with(set->op, "set") || set->operands != 1
+                || (cc = condition_of(set->op + 3)) < 0) {
+            continue;
+        }
+
+        if ((k = next_line(i, 0)) < 0) {
+            continue;
+        }
+
+        extend = &lines[k];
+
+        if (strcmp(extend->op, "movzbq") != 0 || extend->operands != 2
+                || strcmp(extend->operand[0], set->operand[0]) != 0
+                || (r = register_of(extend->operand[1], NULL)) < 0
+                || r != register_of(set->operand[0], NULL)) {
+            continue;
+        }
+
+        if ((j = next_line(k, 0)) < 0) {
+            continue;
+        }
+
+        if (is_move(&lines[j]) && strcmp(lines[j].operand[0], "$0") == 0
+                && (z = register_of(lines[j].operand[1], NULL)) >= 0 && z != r) {
+            zero = &lines[j];
+
+            if ((j = next_line(j, 0)) < 0) {
+                continue;
+            }
+        }
+
+        test = &lines[j];
+
+        if (test->kind != P_INSTRUCTION || test->operands != 2
+                || register_of(test->operand[1], NULL) != r
+                || !((strcmp(test->op, "testq") == 0 && strcmp(test->operand[0], test->operand[1]) == 0)
+                     || (strcmp(test->op, "cmpq") == 0 && strcmp(test->operand[0], "$0") == 0)
+                     || (strcmp(test->op, "cmpq") == 0 && zero && register_of(test->operand[0], NULL) == z))) {
+            continue;
+        }
+
+        if ((j = next_line(j, 0)) < 0) {
+            continue;
+        }
+
+        jump = &lines[j];
+
+        if (jump->kind != P_INSTRUCTION || (strcmp(jump->op, "je") != 0 && strcmp(jump->op, "jne") != 0)) {
+            continue;
+        }
+
+        // The result and the zero must not be needed after the branch
+        if (!dead_from(j + 1, X(r) | (zero ? X(z) : 0), 0)
+                || (jump->target >= 0 && !dead_from(line_of_label(jump->target), X(r) | (zero ? X(z) : 0), 0))) {
+            continue;
+        }
+
+        set_jump(jump, strcmp(jump->op, "jne") == 0 ? conditions[cc].code : conditions[cc].inverse);
+        delete(i, NO_RULE);
+        delete(k, NO_RULE);
+        delete(test - lines, RULE_FUSE);
+
+        if (zero) {
+            delete(zero - lines, NO_RULE);
+        }
+
+        fired = 1;
+    }
+
+    return fired;
+}
+
+// Jumps to a label followed by jmp M go to M
+static int thread_jumps(void) {
+    int fired = 0;
+
+    for (int i = 0; i < line_count; i++) {
+        t_asm_line* l = &lines[i];
+        int hops = 0;
+
+        if (l->deleted || l->kind != P_INSTRUCTION || l->op[0] != 'j' || l->target < 0) {
+            continue;
+        }
+
+        for (int target = line_of_label(l->target); target >= 0 && hops < 8; hops++) {
+            int j = next_line(target, 1);
+
+            if (j < 0 || strcmp(lines[j].op, "jmp") != 0 || lines[j].target < 0 || lines[j].target == l->target) {
+                break;
+            }
+
+            l->target = lines[j].target;
+            l->operand[0] = lines[j].operand[0];
+            l->changed = 1;
+            statistics[RULE_THREAD]++;
+            fired = 1;
+            target = line_of_label(l->target);
+        }
+    }
+
+    return fired;
+}
+
+// jmp L or jcc L with only labels up to L:
+static int jumps_to_next(void) {
+    int fired = 0;
+
+    for (int i = 0; i < line_count; i++) {
+        t_asm_line* l = &lines[i];
+
+        if (l->deleted || l->kind != P_INSTRUCTION || l->op[0] != 'j' || l->target < 0) {
+            continue;
+        }
+
+        for (int j = next_line(i, 0); j >= 0 && lines[j].kind == P_LABEL; j = next_line(j, 0)) {
+            if (lines[j].target == l->target) {
+                delete(i, RULE_JUMP_TO_NEXT);
+                fired = 1;
+                break;
+            }
+        }
+    }
+
+    return fired;
+}
+
+// movq $0, %r => xorl %r32, %r32 where the flags are dead
+static void zeroing_xors(void) {
+    static char* names32[] = {
+        "%eax", "%ebx", "%ecx", "%edx", "%esi", "%edi", "%ebp", "%esp",
+        "%r8d", "%r9d", "%r10d", "%r11d", "%r12d", "%r13d", "%r14d", "%r15d"
+    };
+
+    for (int i = 0; i < line_count; i++) {
+        t_asm_line* l = &lines[i];
+        int r;
+
+        if (l->deleted || !is_move(l) || strcmp(l->operand[0], "$0") != 0
+                || (r = register_of(l->operand[1], NULL)) < 0 || !dead_from(i + 1, 0, 1)) {
+            continue;
+        }
+
+        l->op = "xorl";
+        l->operand[0] = l->operand[1] = names32[r];
+        l->changed = 1;
+        statistics[RULE_XOR]++;
+    }
+}
+
+static void index_labels(void) {
+    int last = -1;
+
+    first_label = -1;
+
+    for (int i = 0; i < line_count; i++) {
+        int n = lines[i].kind == P_LABEL ? lines[i].target : -1;
+
+        if (n >= 0) {
+            first_label = first_label < 0 || n < first_label ? n : first_label;
+            last = n > last ? n : last;
+        }
+    }
+
+    label_range = first_label < 0 ? 0 : last - first_label + 1;
+    label_line = arena_alloc(&peephole_arena, (label_range + 1) * sizeof(int));
+
+    for (int n = 0; n < label_range; n++) {
+        label_line[n] = -1;
+    }
+
+    for (int i = 0; i < line_count; i++) {
+        if (lines[i].kind == P_LABEL && lines[i].target >= 0) {
+            label_line[lines[i].target - first_label] = i;
+        }
+    }
+}
+
+static void write_line(t_asm_line* l) {
+    if (!l->changed) {
+        out_string(l->text);
+    } else {
+        out_write("\t", 1);
+        out_string(l->op);
+
+        for (int i = 0; i < l->operands; i++) {
+            out_string(i ? ", " : "\t");
+            out_string(l->operand[i]);
+        }
+    }
+
+    out_write("\n", 1);
+}
+
+void peephole_end(void) {
+    int rounds = 0;
+
+    index_labels();
+
+    // The rules feed each other, rerun them until none fires
+    while (rounds++ < 8) {
+        int fired = redundant_moves();
+        fired |= fuse_compares();
+        fired |= thread_jumps();
+        fired |= jumps_to_next();
+
+        if (!fired) {
+            break;
+        }
+    }
+
+    zeroing_xors();
+
+    for (int i = 0; i < line_count; i++) {
+        if (!lines[i].deleted) {
+            write_line(&lines[i]);
+        }
+    }
+}
+
+void report_peephole_statistics(char* filename) {
+    fprintf(stderr, "%s: peephole:", filename);
+
+    for (int rule = 0; rule < NUM_RULES; rule++) {
+        fprintf(stderr, "%s %d %s", rule ? "," : "", statistics[rule], rule_names[rule]);
+        statistics[rule] = 0;
+    }
+
+    fputc('\n', stderr);
+}
@@ -0,0 +1,635 @@
+#include <stdarg.h>
+#include <string.h>
+
+#include "../../include/regalloc.h"
+#include "../../include/peephole.h"
+#include "../../include/output.h"
+
+// Stands for a virtual register operand in the buffered text
+#define REGISTER_MARK '\001'
+#define MAX_OPERANDS 4
+#define SPILLED (-1)
+
+enum { I_TEXT, I_USE, I_FRAME_SETUP, I_FRAME_TEARDOWN };
+enum { W_QUAD, W_LONG, W_BYTE };
+
+typedef struct instruction {
+    char* text;                         // Line with a REGISTER_MARK per operand
+    int operand[MAX_OPERANDS];          // Virtual registers, in the order of the marks
+    unsigned char width[MAX_OPERANDS];
+    unsigned char operands;
+    unsigned char kind;
+    unsigned short clobbers;            // Physical registers destroyed
+    unsigned short holds;               // Physical registers written
+} t_instruction;
+
+// Instructions of a physical register may not be given to a virtual
+// register live anywhere in [first, last]
+typedef struct busy_range {
+    int first, last;
+} t_busy_range;
+
+typedef struct register_statistics {
+    char* name;
+    int vregs;
+    int peak;                           // Most virtual registers live at once
+    int spilled;
+    int saved;
+} t_register_statistics;
+
+static char* register_names[3][NUM_PHYSICAL_REGISTERS] = {
+    { "%r10", "%r11", "%r12", "%r13", "%r9", "%r8", "%rcx", "%rdx", "%rsi", "%rdi", "%rbx", "%r14", "%r15" },
+    { "%r10d", "%r11d", "%r12d", "%r13d", "%r9d", "%r8d", "%ecx", "%edx", "%esi", "%edi", "%ebx", "%r14d", "%r15d" },
+    { "%r10b", "%r11b", "%r12b", "%r13b", "%r9b", "%r8b", "%cl", "%dl", "%sil", "%dil", "%bl", "%r14b", "%r15b" }
+};
+
+// Order in which registers are handed out, caller-saved ones first as
+// they need no saving in the frame
+static const int allocation_order[] = {
+    R_R10, R_R11, R_R9, R_R8, R_RCX, R_RDX, R_RSI, R_RDI,
+    R_RBX, R_R12, R_R13, R_R14, R_R15
+};
+
+// Registers that load and store spilled operands around an instruction
+static const int scratch_registers[] = { R_R10, R_R11 };
+
+static t_arena text_arena;
+static t_instruction* code;
+static int code_count, code_capacity;
+
+static int in_function;
+static char* function_name;
+static int frame_locals;
+static int next_vreg = FIRST_VREG;
+
+// Text of the instruction being formatted
+static char* line;
+static size_t line_length, line_capacity;
+
+// Live intervals and locations of the virtual registers
+static int* interval_start;
+static int* interval_end;
+static int* location;
+static int* intervals;                  // Virtual registers by start
+static int vreg_capacity;
+
+static t_busy_range* busy[NUM_PHYSICAL_REGISTERS];
+static int busy_count[NUM_PHYSICAL_REGISTERS];
+static int busy_capacity[NUM_PHYSICAL_REGISTERS];
+
+static t_register_statistics* statistics;
+static int statistics_count, statistics_capacity;
+
+static void* grow(void* p, int* capacity, size_t element) {
+    *capacity = *capacity ? *capacity * 2 : 64;
+
+    if ((p = realloc(p, *capacity * element)) == NULL) {
+        report_error("grow(): realloc() failed.\n");
+    }
+
+    return p;
+}
+
+static void put(const char* s, size_t n) {
+    if (line_length + n + 1 > line_capacity) {
+        while (line_length + n + 1 > line_capacity) {
+            line_capacity = line_capacity ? line_capacity * 2 : 256;
+        }
+
+        if ((line = realloc(line, line_capacity)) == NULL) {
+            report_error("put(): realloc() failed.\n");
+        }
+    }
+
+    memcpy(line + line_length, s, n);
+    line_length += n;
+}
+
+static void put_int(long value) {
+    char digits[21];
+    char* p = digits + sizeof(digits);
+    unsigned long v = value < 0 ? -(unsigned long)value : (unsigned long)value;
+
+    do {
+        *--p = '0' + v % 10;
+        v /= 10;
+    } while (v);
+
+    if (value < 0) {
+        *--p = '-';
+    }
+
+    put(p, digits + sizeof(digits) - p);
+}
+
+static t_instruction* append(int kind) {
+    if (code_count == code_capacity) {
+        code = grow(code, &code_capacity, sizeof(t_instruction));
+    }
+
+    t_instruction* ins = &code[code_count++];
+    memset(ins, 0, sizeof(t_instruction));
+    ins->kind = kind;
+    return ins;
+}
+
+int new_vreg(void) {
+    return next_vreg++;
+}
+
+void emit(const char* fmt, ...) {
+    t_instruction ins;
+    const char* run;
+    va_list ap;
+    int r, width;
+
+    ins.operands = 0;
+    line_length = 0;
+
+    va_start(ap, fmt);
+    for (run = fmt; *fmt != '\0'; fmt++) {
+        if (*fmt != '%') {
+            continue;
+        }
+
+        put(run, fmt - run);
+        run = fmt + 2;
+
+        switch (*++fmt) {
+            case 'd': put_int(va_arg(ap, int)); break;
+            case 'l': put_int(va_arg(ap, long)); break;
+            case 's': {
+                char* s = va_arg(ap, char*);
+                put(s, strlen(s));
+                break;
+            }
+            case '%': put("%", 1); break;
+            case 'R':
+            case 'D':
+            case 'B':
+                width = *fmt == 'R' ? W_QUAD : *fmt == 'D' ? W_LONG : W_BYTE;
+                r = va_arg(ap, int);
+
+                if (r < FIRST_VREG) {
+                    put(register_names[width][r], strlen(register_names[width][r]));
+                } else if (!in_function || ins.operands == MAX_OPERANDS) {
+                    report_error("emit(): virtual register out of place.\n");
+                } else {
+                    ins.operand[ins.operands] = r;
+                    ins.width[ins.operands++] = width;
+                    put("\001", 1);
+                }
+                break;
+            default:
+                report_error("emit(): bad format.\n");
+        }
+    }
+    va_end(ap);
+
+    put(run, fmt - run);
+
+    if (!in_function) {
+        out_write(line, line_length);
+        return;
+    }
+
+    t_instruction* i = append(I_TEXT);
+    *i = ins;
+    i->kind = I_TEXT;
+    i->clobbers = i->holds = 0;
+    i->text = arena_alloc(&text_arena, line_length + 1);
+    memcpy(i->text, line, line_length);
+}
+
+void emit_clobber(unsigned int registers) {
+    if (in_function) {
+        code[code_count - 1].clobbers |= registers;
+    }
+}
+
+void emit_hold(int r) {
+    if (in_function) {
+        code[code_count - 1].holds |= REGISTER_BIT(r);
+    }
+}
+
+void emit_use(int r) {
+    if (in_function && r >= FIRST_VREG) {
+        t_instruction* ins = append(I_USE);
+        ins->operand[0] = r;
+        ins->operands = 1;
+    }
+}
+
+void regalloc_begin(char* name) {
+    in_function = 1;
+    function_name = name;
+    code_count = 0;
+    next_vreg = FIRST_VREG;
+    arena_reset(&text_arena);
+}
+
+void emit_frame_setup(int locals) {
+    frame_locals = locals;
+    append(I_FRAME_SETUP);
+}
+
+void emit_frame_teardown(void) {
+    append(I_FRAME_TEARDOWN);
+}
+
+static void add_busy(int r, int first, int last) {
+    if (busy_count[r] > 0 && busy[r][busy_count[r] - 1].last + 1 >= first) {
+        busy[r][busy_count[r] - 1].last = last;
+        return;
+    }
+
+    if (busy_count[r] == busy_capacity[r]) {
+        busy[r] = grow(busy[r], &busy_capacity[r], sizeof(t_busy_range));
+    }
+
+    busy[r][busy_count[r]].first = first;
+    busy[r][busy_count[r]++].last = last;
+}
+
+// Return true if physical register r is clobbered or holds a value
+// somewhere in [first, last].
+static int is_busy(int r, int first, int last) {
+    int lo = 0, hi = busy_count[r];
+
+    // First range that ends at or after first
+    while (lo < hi) {
+        int mid = (lo + hi) / 2;
+
+        if (busy[r][mid].last < first) {
+            lo = mid + 1;
+        } else {
+            hi = mid;
+        }
+    }
+
+    return lo < busy_count[r] && busy[r][lo].first <= last;
+}
+
+// Find the live interval of every virtual register and the ranges in
+// which the physical registers are taken by the instructions.
+static int compute_intervals(void) {
+    int vregs = next_vreg - FIRST_VREG;
+    int open[NUM_PHYSICAL_REGISTERS];
+    int count = 0;
+
+    if (vreg_capacity < vregs) {
+        vreg_capacity = vregs * 2;
+        interval_start = realloc(interval_start, vreg_capacity * sizeof(int));
+        interval_end = realloc(interval_end, vreg_capacity * sizeof(int));
+        location = realloc(location, vreg_capacity * sizeof(int));
+        intervals = realloc(intervals, vreg_capacity * sizeof(int));
+
+        if (!interval_start || !interval_end || !location || !intervals) {
+            report_error("compute_intervals(): realloc() failed.\n");
+        }
+    }
+
+    for (int v = 0; v < vregs; v++) {
+        interval_start[v] = -1;
+    }
+
+    for (int r = 0; r < NUM_PHYSICAL_REGISTERS; r++) {
+        busy_count[r] = 0;
+        open[r] = -1;
+    }
+
+    for (int i = 0; i < code_count; i++) {
+        t_instruction* ins = &code[i];
+
+        for (int k = 0; k < ins->operands; k++) {
+            int v = ins->operand[k] - FIRST_VREG;
+
+            if (interval_start[v] < 0) {
+                interval_start[v] = i;
+                intervals[count++] = v;
+            }
+
+            interval_end[v] = i;
+        }
+
+        for (int r = 0; r < NUM_PHYSICAL_REGISTERS; r++) {
+            if (ins->clobbers & REGISTER_BIT(r)) {
+                add_busy(r, open[r] < 0 ? i : open[r], i);
+                open[r] = -1;
+            }
+
+            if ((ins->holds & REGISTER_BIT(r)) && open[r] < 0) {
+                open[r] = i + 1;
+            }
+        }
+    }
+
+    for (int r = 0; r < NUM_PHYSICAL_REGISTERS; r++) {
+        if (open[r] >= 0 && open[r] < code_count) {
+            add_busy(r, open[r], code_count - 1);
+        }
+    }
+
+    // Intervals were added at their first use, so they are sorted by start
+    return count;
+}
+
+// Linear scan over the intervals with the given registers. An interval
+// that finds no free register takes the one of the active interval
+// that ends last, if that one outlives it, and the loser is spilled.
+// Return the number of spilled intervals.
+static int linear_scan(int count, const int* pool, int pool_size) {
+    int active[NUM_PHYSICAL_REGISTERS];
+    int active_count = 0;
+    int spills = 0;
+
+    for (int n = 0; n < count; n++) {
+        int v = intervals[n];
+        int start = interval_start[v], end = interval_end[v];
+        unsigned int taken = 0;
+        int k, j;
+
+        // Expire the intervals that ended before this one starts
+        for (j = 0, k = 0; j < active_count; j++) {
+            if (interval_end[active[j]] >= start) {
+                active[k++] = active[j];
+                taken |= REGISTER_BIT(location[active[j]]);
+            }
+        }
+        active_count = k;
+
+        location[v] = SPILLED;
+
+        for (j = 0; j < pool_size; j++) {
+            if (!(taken & REGISTER_BIT(pool[j])) && !is_busy(pool[j], start, end)) {
+                location[v] = pool[j];
+                break;
+            }
+        }
+
+        if (location[v] == SPILLED) {
+            spills++;
+
+            // Active intervals are kept sorted by end
+            if (active_count == 0 || interval_end[active[active_count - 1]] <= end
+                    || is_busy(location[active[active_count - 1]], start, end)) {
+                continue;
+            }
+
+            location[v] = location[active[--active_count]];
+            location[active[active_count]] = SPILLED;
+        }
+
+        for (k = active_count; k > 0 && interval_end[active[k - 1]] > end; k--) {
+            active[k] = active[k - 1];
+        }
+
+        active[k] = v;
+        active_count++;
+    }
+
+    return spills;
+}
+
+// Return the largest number of intervals that overlap.
+static int peak_pressure(int count) {
+    int* starts = calloc(code_count + 1, sizeof(int));
+    int live = 0, peak = 0;
+
+    if (starts == NULL) {
+        report_error("peak_pressure(): calloc() failed.\n");
+    }
+
+    for (int n = 0; n < count; n++) {
+        starts[interval_start[intervals[n]]]++;
+        starts[interval_end[intervals[n]] + 1]--;
+    }
+
+    for (int i = 0; i < code_count; i++) {
+        live += starts[i];
+        peak = live > peak ? live : peak;
+    }
+
+    free(starts);
+    return peak;
+}
+
+// Fill in the registers of the operands and hand the line on
+static void write_text(t_instruction* ins, const int* reg) {
+    char* run = ins->text;
+    char* p;
+    int k = 0;
+
+    line_length = 0;
+
+    for (p = run; *p != '\0'; p++) {
+        if (*p == REGISTER_MARK) {
+            put(run, p - run);
+            put(register_names[ins->width[k]][reg[k]], strlen(register_names[ins->width[k]][reg[k]]));
+            run = p + 1;
+            k++;
+        }
+    }
+
+    put(run, p - run);
+    peephole_lines(line, line_length);
+}
+
+// Hand on a line of the allocator's own, the format knows %d, %s and %%
+static void write_line(const char* fmt, ...) {
+    const char* run;
+    va_list ap;
+
+    line_length = 0;
+
+    va_start(ap, fmt);
+    for (run = fmt; *fmt != '\0'; fmt++) {
+        if (*fmt != '%') {
+            continue;
+        }
+
+        put(run, fmt - run);
+        run = fmt + 2;
+
+        switch (*++fmt) {
+            case 'd': put_int(va_arg(ap, int)); break;
+            case 's': {
+                char* s = va_arg(ap, char*);
+                put(s, strlen(s));
+                break;
+            }
+            default: put("%", 1); break;
+        }
+    }
+    va_end(ap);
+
+    put(run, fmt - run);
+    peephole_lines(line, line_length);
+}
+
+// Write an instruction whose operands have their locations. Spilled
+// operands go through a scratch register, loaded before the instruction
+// unless it is the first use and stored after it unless it is the last.
+static void write_instruction(int i, const int* slot_offset) {
+    t_instruction* ins = &code[i];
+    int reg[MAX_OPERANDS];
+    int spilled[2];
+    int spilled_count = 0;
+    int k, j;
+
+    for (k = 0; k < ins->operands; k++) {
+        int v = ins->operand[k] - FIRST_VREG;
+
+        if (location[v] != SPILLED) {
+            reg[k] = location[v];
+            continue;
+        }
+
+        for (j = 0; j < spilled_count && spilled[j] != v; j++);
+
+        if (j == spilled_count) {
+            if (spilled_count == 2) {
+                report_error("write_instruction(): too many spilled operands.\n");
+            }
+
+            spilled[spilled_count++] = v;
+
+            if (interval_start[v] != i) {
+                write_line("\tmovq\t%d(%%rbp), %s\n", slot_offset[v], register_names[W_QUAD][scratch_registers[j]]);
+            }
+        }
+
+        reg[k] = scratch_registers[j];
+    }
+
+    write_text(ins, reg);
+
+    for (j = 0; j < spilled_count; j++) {
+        if (interval_end[spilled[j]] != i) {
+            write_line("\tmovq\t%s, %d(%%rbp)\n", register_names[W_QUAD][scratch_registers[j]], slot_offset[spilled[j]]);
+        }
+    }
+}
+
+void regalloc_end(void) {
+    int count = compute_intervals();
+    int spills = linear_scan(count, allocation_order, NUM_PHYSICAL_REGISTERS);
+    int slots = 0, saved = 0;
+    int* slot_end = NULL;
+    int slot_capacity = 0;
+    unsigned int callee_saved = 0;
+    int base, frame;
+
+    // Spilled operands need the scratch registers, so keep them out
+    if (spills > 0) {
+        spills = linear_scan(count, allocation_order + 2, NUM_PHYSICAL_REGISTERS - 2);
+    }
+
+    // Spilled intervals share a stack slot unless they overlap
+    int* slot_of = malloc(sizeof(int) * (count + 1));
+
+    for (int n = 0; n < count; n++) {
+        int v = intervals[n];
+        int s;
+
+        if (location[v] != SPILLED) {
+            callee_saved |= REGISTER_BIT(location[v]);
+            continue;
+        }
+
+        for (s = 0; s < slots && slot_end[s] >= interval_start[v]; s++);
+
+        if (s == slots) {
+            if (slots == slot_capacity) {
+                slot_end = grow(slot_end, &slot_capacity, sizeof(int));
+            }
+            slots++;
+        }
+
+        slot_end[s] = interval_end[v];
+        slot_of[n] = s;
+    }
+
+    for (int i = 0; i < code_count; i++) {
+        callee_saved |= code[i].clobbers;
+    }
+    callee_saved &= CALLEE_SAVED;
+
+    for (int r = 0; r < NUM_PHYSICAL_REGISTERS; r++) {
+        saved += (callee_saved & REGISTER_BIT(r)) != 0;
+    }
+
+    base = (frame_locals + 7) & ~7;
+    frame = (base + 8 * (slots + saved) + 15) & ~15;
+
+    // Offsets of the spilled virtual registers, by register
+    int* slot_offset = malloc(sizeof(int) * (next_vreg - FIRST_VREG + 1));
+
+    for (int n = 0; n < count; n++) {
+        if (location[intervals[n]] == SPILLED) {
+            slot_offset[intervals[n]] = -(base + 8 * (slot_of[n] + 1));
+        }
+    }
+
+    peephole_begin();
+
+    for (int i = 0; i < code_count; i++) {
+        int offset = -(base + 8 * slots);
+
+        switch (code[i].kind) {
+            case I_TEXT:
+                write_instruction(i, slot_offset);
+                break;
+
+            case I_FRAME_SETUP:
+                write_line("\taddq\t$%d, %%rsp\n", -frame);
+
+                for (int r = 0; r < NUM_PHYSICAL_REGISTERS; r++) {
+                    if (callee_saved & REGISTER_BIT(r)) {
+                        offset -= 8;
+                        write_line("\tmovq\t%s, %d(%%rbp)\n", register_names[W_QUAD][r], offset);
+                    }
+                }
+                break;
+
+            case I_FRAME_TEARDOWN:
+                for (int r = 0; r < NUM_PHYSICAL_REGISTERS; r++) {
+                    if (callee_saved & REGISTER_BIT(r)) {
+                        offset -= 8;
+                        write_line("\tmovq\t%d(%%rbp), %s\n", offset, register_names[W_QUAD][r]);
+                    }
+                }
+
+                write_line("\taddq\t$%d,%%rsp\n" "\tpopq %%rbp\n" "\tret\n", frame);
+                break;
+        }
+    }
+
+    peephole_end();
+
+    if (statistics_count == statistics_capacity) {
+        statistics = grow(statistics, &statistics_capacity, sizeof(t_register_statistics));
+    }
+
+    statistics[statistics_count].name = function_name;
+    statistics[statistics_count].vregs = count;
+    statistics[statistics_count].peak = peak_pressure(count);
+    statistics[statistics_count].spilled = spills;
+    statistics[statistics_count++].saved = saved;
+
+    free(slot_of);
+    free(slot_offset);
+    free(slot_end);
+    in_function = 0;
+}
+
+void report_register_statistics(char* filename) {
+    for (int i = 0; i < statistics_count; i++) {
+        fprintf(stderr, "%s: %s: %d virtual registers, %d live at most, %d spilled, %d callee-saved registers\n",
+                filename, statistics[i].name, statistics[i].vregs, statistics[i].peak,
+                statistics[i].spilled, statistics[i].saved);
+    }
+
+    statistics_count = 0;
+}
@@ -0,0 +1,110 @@
+#include "../../include/ir.h"
+
+// Walk up the dominator tree from both blocks to their nearest common
+// dominator. Dominators come later in postorder.
+static t_ir_block* intersect(t_ir_block* a, t_ir_block* b) {
+    while (a != b) {
+        while (a->postorder < b->postorder) {
+            a = a->idom;
+        }
+
+        while (b->postorder < a->postorder) {
+            b = b->idom;
+        }
+    }
+
+    return a;
+}
+
+// Immediate dominators after Cooper, Harvey and Kennedy, "A Simple,
+// Fast Dominance Algorithm": iterate over the blocks in reverse
+// postorder until no immediate dominator changes.
+void ir_dominators(t_ir_function* fn) {
+    t_ir_block** order = arena_alloc(&ir_arena, fn->nblocks * sizeof(t_ir_block*));
+    t_ir_block** stack = arena_alloc(&ir_arena, fn->nblocks * sizeof(t_ir_block*));
+    int* next_target = arena_alloc(&ir_arena, fn->nblocks * sizeof(int));
+    char* visited = arena_alloc(&ir_arena, fn->nblocks);
+    t_ir_block *b, *idom;
+    int count = 0, top = 0;
+    int changed;
+
+    // Postorder of a depth first walk from the entry
+    visited[fn->first->id] = 1;
+    stack[top++] = fn->first;
+
+    while (top > 0) {
+        b = stack[top - 1];
+
+        if (next_target[b->id] < b->last->ntargets) {
+            t_ir_block* s = b->last->targets[next_target[b->id]++];
+
+            if (!visited[s->id]) {
+                visited[s->id] = 1;
+                stack[top++] = s;
+            }
+        } else {
+            b->postorder = count;
+            order[count++] = b;
+            top--;
+        }
+    }
+
+    for (b = fn->first; b != NULL; b = b->next) {
+        b->idom = NULL;
+        b->dom_child = b->dom_sibling = NULL;
+        b->frontier = NULL;
+    }
+
+    fn->first->idom = fn->first;
+
+    do {
+        changed = 0;
+
+        for (int i = count - 2; i >= 0; i--) {
+            b = order[i];
+            idom = NULL;
+
+            for (int p = 0; p < b->npreds; p++) {
+                if (b->preds[p]->idom != NULL) {
+                    idom = idom ? intersect(b->preds[p], idom) : b->preds[p];
+                }
+            }
+
+            if (b->idom != idom) {
+                b->idom = idom;
+                changed = 1;
+            }
+        }
+    } while (changed);
+
+    fn->first->idom = NULL;
+
+    // Children in reverse postorder, so the tree is walked in layout order
+    // as far as possible
+    for (int i = 0; i < count - 1; i++) {
+        b = order[i];
+        b->dom_sibling = b->idom->dom_child;
+        b->idom->dom_child = b;
+    }
+
+    // A join point is in the frontier of every block from its
+    // predecessors up to, but excluding, its immediate dominator
+    for (b = fn->first; b != NULL; b = b->next) {
+        if (b->npreds < 2) {
+            continue;
+        }
+
+        for (int p = 0; p < b->npreds; p++) {
+            for (t_ir_block* runner = b->preds[p]; runner != b->idom; runner = runner->idom) {
+                if (runner->frontier != NULL && runner->frontier->block == b) {
+                    break;
+                }
+
+                t_ir_block_list* entry = arena_alloc(&ir_arena, sizeof(t_ir_block_list));
+                entry->block = b;
+                entry->next = runner->frontier;
+                runner->frontier = entry;
+            }
+        }
+    }
+}
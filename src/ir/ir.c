@@ -0,0 +1,381 @@
+#include <string.h>
+
+#include "../../include/ir.h"
+#include "../../include/generation.h"
+
+t_arena ir_arena;
+
+int print_ir;
+
+static t_ir_function* function;
+static t_ir_block* current;
+
+static char* opnames[] = {
+    [IR_CONST] = "const", [IR_COPY] = "copy", [IR_STRING] = "string",
+    [IR_ADDRESS] = "address", [IR_PARAM] = "param", [IR_LOAD_LOCAL] = "load_local", [IR_LOAD_GLOBAL] = "load_global",
+    [IR_STORE_LOCAL] = "store_local", [IR_STORE_GLOBAL] = "store_global",
+    [IR_LOAD] = "load", [IR_STORE] = "store",
+    [IR_ADD] = "add", [IR_SUB] = "sub", [IR_MUL] = "mul", [IR_DIV] = "div", [IR_MOD] = "mod",
+    [IR_SHL] = "shl", [IR_SHR] = "shr", [IR_AND] = "and", [IR_OR] = "or", [IR_XOR] = "xor",
+    [IR_EQ] = "eq", [IR_NE] = "ne", [IR_LT] = "lt", [IR_GT] = "gt", [IR_LE] = "le", [IR_GE] = "ge",
+    [IR_SHL_CONST] = "shl", [IR_NEG] = "neg", [IR_INVERT] = "invert", [IR_LOGIC_NOT] = "not",
+    [IR_CALL] = "call", [IR_TRUNCATE] = "truncate", [IR_PHI] = "phi", [IR_JUMP] = "jump", [IR_BRANCH] = "branch",
+    [IR_SWITCH] = "switch", [IR_RETURN] = "return"
+};
+
+int* ir_operand(t_ir_instr* ins, int i) {
+    switch (i) {
+        case 0: return &ins->src1;
+        case 1: return &ins->src2;
+    }
+
+    if ((ins->op == IR_CALL || ins->op == IR_PHI) && i - 2 < ins->argc) {
+        return &ins->args[i - 2];
+    }
+
+    return NULL;
+}
+
+static int is_terminator(t_ir_instr* ins) {
+    return ins != NULL && ins->op >= IR_JUMP;
+}
+
+t_ir_function* ir_begin_function(t_symbol_entry* symbol) {
+    function = arena_alloc(&ir_arena, sizeof(t_ir_function));
+    function->symbol = symbol;
+
+    current = NULL;
+    ir_place_block(ir_new_block());
+    return function;
+}
+
+t_ir_block* ir_new_block(void) {
+    t_ir_block* b = arena_alloc(&ir_arena, sizeof(t_ir_block));
+    b->label = label();
+    return b;
+}
+
+void ir_place_block(t_ir_block* b) {
+    if (current != NULL && !is_terminator(current->last)) {
+        ir_jump(b);
+    }
+
+    if (function->last == NULL) {
+        function->first = b;
+    } else {
+        function->last->next = b;
+    }
+
+    function->last = b;
+    b->id = function->nblocks++;
+    current = b;
+}
+
+int ir_new_vreg(void) {
+    return function->nvregs++;
+}
+
+t_ir_instr* ir_new_instr(int op, int dst, int src1, int src2) {
+    t_ir_instr* ins = arena_alloc(&ir_arena, sizeof(t_ir_instr));
+
+    ins->op = op;
+    ins->dst = dst;
+    ins->src1 = src1;
+    ins->src2 = src2;
+    return ins;
+}
+
+void ir_insert(t_ir_block* b, t_ir_instr* pos, t_ir_instr* ins) {
+    ins->block = b;
+    ins->next = pos;
+    ins->prev = pos ? pos->prev : b->last;
+
+    if (ins->prev) {
+        ins->prev->next = ins;
+    } else {
+        b->first = ins;
+    }
+
+    if (pos) {
+        pos->prev = ins;
+    } else {
+        b->last = ins;
+    }
+}
+
+void ir_remove(t_ir_instr* ins) {
+    t_ir_block* b = ins->block;
+
+    if (ins->prev) {
+        ins->prev->next = ins->next;
+    } else {
+        b->first = ins->next;
+    }
+
+    if (ins->next) {
+        ins->next->prev = ins->prev;
+    } else {
+        b->last = ins->prev;
+    }
+}
+
+t_ir_instr* ir_append(int op, int dst, int src1, int src2) {
+    t_ir_instr* ins = ir_new_instr(op, dst, src1, src2);
+
+    // Code after a jump or return starts an unreachable block
+    if (is_terminator(current->last)) {
+        ir_place_block(ir_new_block());
+    }
+
+    ir_insert(current, NULL, ins);
+    return ins;
+}
+
+void ir_jump(t_ir_block* target) {
+    t_ir_instr* ins = ir_append(IR_JUMP, NOREG, NOREG, NOREG);
+
+    ins->targets = arena_alloc(&ir_arena, sizeof(t_ir_block*));
+    ins->targets[0] = target;
+    ins->ntargets = 1;
+}
+
+void ir_branch(int cmp, int src1, int src2, t_ir_block* if_true, t_ir_block* if_false) {
+    t_ir_instr* ins = ir_append(IR_BRANCH, NOREG, src1, src2);
+
+    ins->value = cmp;
+    ins->targets = arena_alloc(&ir_arena, 2 * sizeof(t_ir_block*));
+    ins->targets[0] = if_true;
+    ins->targets[1] = if_false;
+    ins->ntargets = 2;
+}
+
+t_ir_function* ir_end_function(void) {
+    t_ir_function* fn = function;
+    t_ir_block *b, *prev;
+    t_ir_block** stack;
+    char* reachable;
+    int top = 0;
+
+    if (!is_terminator(current->last)) {
+        ir_append(IR_RETURN, NOREG, NOREG, NOREG);
+    }
+
+    reachable = arena_alloc(&ir_arena, fn->nblocks);
+    stack = arena_alloc(&ir_arena, fn->nblocks * sizeof(t_ir_block*));
+
+    reachable[fn->first->id] = 1;
+    stack[top++] = fn->first;
+
+    while (top > 0) {
+        b = stack[--top];
+
+        for (int i = 0; i < b->last->ntargets; i++) {
+            if (!reachable[b->last->targets[i]->id]) {
+                reachable[b->last->targets[i]->id] = 1;
+                stack[top++] = b->last->targets[i];
+            }
+        }
+    }
+
+    // Unlink the unreachable blocks and number the others in layout order
+    fn->nblocks = 0;
+
+    for (b = fn->first, prev = NULL; b != NULL; b = b->next) {
+        if (!reachable[b->id]) {
+            continue;
+        }
+
+        if (prev == NULL) {
+            fn->first = b;
+        } else {
+            prev->next = b;
+        }
+
+        prev = b;
+    }
+
+    prev->next = NULL;
+    fn->last = prev;
+
+    for (b = fn->first; b != NULL; b = b->next) {
+        b->id = fn->nblocks++;
+    }
+
+    ir_build_cfg(fn);
+
+    function = NULL;
+    current = NULL;
+    return fn;
+}
+
+void ir_build_cfg(t_ir_function* fn) {
+    t_ir_block* b;
+
+    for (b = fn->first; b != NULL; b = b->next) {
+        b->npreds = 0;
+    }
+
+    for (b = fn->first; b != NULL; b = b->next) {
+        for (int i = 0; i < b->last->ntargets; i++) {
+            b->last->targets[i]->npreds++;
+        }
+    }
+
+    for (b = fn->first; b != NULL; b = b->next) {
+        b->preds = arena_alloc(&ir_arena, b->npreds * sizeof(t_ir_block*));
+        b->npreds = 0;
+    }
+
+    for (b = fn->first; b != NULL; b = b->next) {
+        for (int i = 0; i < b->last->ntargets; i++) {
+            t_ir_block* s = b->last->targets[i];
+
+            // A switch may reach a block through several cases
+            int j;
+            for (j = 0; j < s->npreds && s->preds[j] != b; j++);
+
+            if (j == s->npreds) {
+                s->preds[s->npreds++] = b;
+            }
+        }
+    }
+}
+
+static void print_vreg(FILE* out, int v) {
+    if (v == NOREG) {
+        fputs("-", out);
+    } else {
+        fprintf(out, "v%d", v);
+    }
+}
+
+static void print_instr(t_ir_instr* ins, FILE* out) {
+    fputs("    ", out);
+
+    if (ins->dst != NOREG) {
+        print_vreg(out, ins->dst);
+        fputs(" = ", out);
+    }
+
+    fputs(opnames[ins->op], out);
+
+    switch (ins->op) {
+        case IR_CONST:
+            fprintf(out, " %d", ins->value);
+            break;
+        case IR_STRING:
+            fprintf(out, " L%d", ins->value);
+            break;
+        case IR_ADDRESS:
+        case IR_PARAM:
+            fprintf(out, " %s", ins->symbol->name);
+            break;
+        case IR_LOAD_LOCAL:
+        case IR_LOAD_GLOBAL:
+            fprintf(out, " %s", ins->symbol->name);
+
+            switch (ins->value) {
+                case A_PRE_INCREMENT: fputs(" pre++", out); break;
+                case A_PRE_DECREMENT: fputs(" pre--", out); break;
+                case A_POST_INCREMENT: fputs(" post++", out); break;
+                case A_POST_DECREMENT: fputs(" post--", out); break;
+            }
+            break;
+        case IR_STORE_LOCAL:
+        case IR_STORE_GLOBAL:
+            fprintf(out, " %s, ", ins->symbol->name);
+            print_vreg(out, ins->src1);
+            break;
+        case IR_LOAD:
+            fprintf(out, ".%d ", get_primitive_size(value_at(ins->type)));
+            print_vreg(out, ins->src1);
+            break;
+        case IR_STORE:
+            fprintf(out, ".%d ", get_primitive_size(ins->type));
+            print_vreg(out, ins->src2);
+            fputs(", ", out);
+            print_vreg(out, ins->src1);
+            break;
+        case IR_TRUNCATE:
+            fprintf(out, ".%d ", get_primitive_size(ins->type));
+            print_vreg(out, ins->src1);
+            break;
+        case IR_PHI:
+            fprintf(out, " %s", ins->symbol->name);
+
+            for (int i = 0; i < ins->argc; i++) {
+                fputs(i ? ", [" : " [", out);
+                print_vreg(out, ins->args[i]);
+                fprintf(out, ", L%d]", ins->block->preds[i]->label);
+            }
+            break;
+        case IR_SHL_CONST:
+            fputs(" ", out);
+            print_vreg(out, ins->src1);
+            fprintf(out, ", %d", ins->value);
+            break;
+        case IR_CALL:
+            fprintf(out, " %s(", ins->symbol->name);
+
+            for (int i = 0; i < ins->argc; i++) {
+                fputs(i ? ", " : "", out);
+                print_vreg(out, ins->args[i]);
+            }
+
+            fputs(")", out);
+            break;
+        case IR_JUMP:
+            fprintf(out, " L%d", ins->targets[0]->label);
+            break;
+        case IR_BRANCH:
+            fprintf(out, " %s ", opnames[ins->value]);
+            print_vreg(out, ins->src1);
+            fputs(", ", out);
+            print_vreg(out, ins->src2);
+            fprintf(out, ", L%d, L%d", ins->targets[0]->label, ins->targets[1]->label);
+            break;
+        case IR_SWITCH:
+            fputs(" ", out);
+            print_vreg(out, ins->src1);
+
+            for (int i = 0; i < ins->argc; i++) {
+                fprintf(out, ", %d: L%d", ins->args[i], ins->targets[i]->label);
+            }
+
+            fprintf(out, ", default: L%d", ins->targets[ins->argc]->label);
+            break;
+        default:
+            if (ins->src1 != NOREG) {
+                fputs(" ", out);
+                print_vreg(out, ins->src1);
+            }
+
+            if (ins->src2 != NOREG) {
+                fputs(", ", out);
+                print_vreg(out, ins->src2);
+            }
+            break;
+    }
+
+    fputs("\n", out);
+}
+
+void ir_dump(t_ir_function* fn, FILE* out) {
+    fprintf(out, "function %s\n", fn->symbol->name);
+
+    for (t_ir_block* b = fn->first; b != NULL; b = b->next) {
+        fprintf(out, "L%d:", b->label);
+
+        for (int i = 0; i < b->npreds; i++) {
+            fprintf(out, "%s L%d", i ? "," : "    # from", b->preds[i]->label);
+        }
+
+        fputs("\n", out);
+
+        for (t_ir_instr* ins = b->first; ins != NULL; ins = ins->next) {
+            print_instr(ins, out);
+        }
+    }
+
+    fputs("\n", out);
+}
@@ -0,0 +1,145 @@
+#include <string.h>
+
+#include "../../include/ir.h"
+
+#define SET(set, i)         ((set)[(i) / 64] |= 1ul << ((i) % 64))
+
+void ir_liveness(t_ir_function* fn) {
+    int n = fn->nvregs;
+    int words;
+    int changed;
+    int* defined_in = arena_alloc(&ir_arena, (n + 1) * sizeof(int));
+    int* live = arena_alloc(&ir_arena, (n + 1) * sizeof(int));
+    int* global_vreg;
+    t_ir_block** blocks = arena_alloc(&ir_arena, fn->nblocks * sizeof(t_ir_block*));
+    unsigned long **use, **def;
+    t_ir_block* b;
+    t_ir_instr* ins;
+    int* p;
+
+    fn->defs = arena_alloc(&ir_arena, (n + 1) * sizeof(int));
+    fn->global_index = arena_alloc(&ir_arena, (n + 1) * sizeof(int));
+    fn->nglobals = 0;
+
+    for (int v = 0; v < n; v++) {
+        fn->global_index[v] = -1;
+        defined_in[v] = -1;
+    }
+
+    // A register used in a block before it is defined there lives
+    // across a block edge and takes part in the data flow
+    for (b = fn->first; b != NULL; b = b->next) {
+        blocks[b->id] = b;
+
+        for (ins = b->first; ins != NULL; ins = ins->next) {
+            for (int i = 0; (p = ir_operand(ins, i)) != NULL; i++) {
+                if (*p != NOREG && defined_in[*p] != b->id && fn->global_index[*p] < 0) {
+                    fn->global_index[*p] = fn->nglobals++;
+                }
+            }
+
+            if (ins->dst != NOREG) {
+                defined_in[ins->dst] = b->id;
+                fn->defs[ins->dst]++;
+            }
+        }
+    }
+
+    words = IR_BIT_WORDS(fn->nglobals);
+    global_vreg = fn->global_vreg = arena_alloc(&ir_arena, (fn->nglobals + 1) * sizeof(int));
+    use = arena_alloc(&ir_arena, fn->nblocks * sizeof(unsigned long*));
+    def = arena_alloc(&ir_arena, fn->nblocks * sizeof(unsigned long*));
+
+    for (int v = 0; v < n; v++) {
+        if (fn->global_index[v] >= 0) {
+            global_vreg[fn->global_index[v]] = v;
+        }
+
+        defined_in[v] = -1;
+    }
+
+    for (b = fn->first; b != NULL; b = b->next) {
+        b->live_in = arena_alloc(&ir_arena, (words + 1) * sizeof(unsigned long));
+        b->live_out = arena_alloc(&ir_arena, (words + 1) * sizeof(unsigned long));
+        use[b->id] = arena_alloc(&ir_arena, (words + 1) * sizeof(unsigned long));
+        def[b->id] = arena_alloc(&ir_arena, (words + 1) * sizeof(unsigned long));
+
+        for (ins = b->first; ins != NULL; ins = ins->next) {
+            for (int i = 0; (p = ir_operand(ins, i)) != NULL; i++) {
+                if (*p != NOREG && defined_in[*p] != b->id && fn->global_index[*p] >= 0) {
+                    SET(use[b->id], fn->global_index[*p]);
+                }
+            }
+
+            if (ins->dst != NOREG) {
+                defined_in[ins->dst] = b->id;
+
+                if (fn->global_index[ins->dst] >= 0) {
+                    SET(def[b->id], fn->global_index[ins->dst]);
+                }
+            }
+        }
+    }
+
+    // live_out = union of live_in of the successors,
+    // live_in = use | (live_out & ~def), backwards until nothing changes
+    do {
+        changed = 0;
+
+        for (int id = fn->nblocks - 1; id >= 0; id--) {
+            b = blocks[id];
+
+            for (int w = 0; w < words; w++) {
+                unsigned long out = 0, in;
+
+                for (int i = 0; i < b->last->ntargets; i++) {
+                    out |= b->last->targets[i]->live_in[w];
+                }
+
+                in = use[id][w] | (out & ~def[id][w]);
+
+                if (out != b->live_out[w] || in != b->live_in[w]) {
+                    b->live_out[w] = out;
+                    b->live_in[w] = in;
+                    changed = 1;
+                }
+            }
+        }
+    } while (changed);
+
+    // Walk every block backwards to find the last uses. live[v] holds
+    // the id of the block, plus one, while v is live in it.
+    for (b = fn->first; b != NULL; b = b->next) {
+        int mark = b->id + 1;
+
+        for (int g = 0; g < fn->nglobals; g++) {
+            if (IR_TEST(b->live_out, g)) {
+                live[global_vreg[g]] = mark;
+            }
+        }
+
+        for (ins = b->last; ins != NULL; ins = ins->prev) {
+            if (ins->dst != NOREG) {
+                live[ins->dst] = 0;
+            }
+
+            ins->dead = 0;
+
+            if (ins->src1 != NOREG && live[ins->src1] != mark) {
+                ins->dead |= IR_DEAD_SRC1;
+                live[ins->src1] = mark;
+            }
+
+            if (ins->src2 != NOREG && live[ins->src2] != mark) {
+                ins->dead |= IR_DEAD_SRC2;
+                live[ins->src2] = mark;
+            }
+
+            for (int i = 2; (p = ir_operand(ins, i)) != NULL; i++) {
+                if (*p != NOREG) {
+                    live[*p] = mark;
+                }
+            }
+        }
+    }
+}
@@ -0,0 +1,56 @@
+#include "../../include/ir.h"
+#include "../../include/ast.h"
+
+// Lowering of pointer nodes
+#define AST_NODE            t_astnode*
+#define AST_NONE            NULL
+#define AST_OP(n)           ((n)->op)
+#define AST_TYPE(n)         ((n)->type)
+#define AST_RVALUE(n)       ((n)->rvalue)
+#define AST_VALUE(n)        ((n)->value)
+#define AST_SIZE(n)         ((n)->size)
+#define AST_NEED(n)         ((n)->need)
+#define AST_SIDE_EFFECTS(n) ((n)->side_effects)
+#define AST_SYMBOL(n)       ((n)->symbol)
+#define AST_CASES(n)        ((n)->cases)
+#define AST_LEFT(n)         ((n)->left)
+#define AST_MIDDLE(n)       ((n)->middle)
+#define AST_RIGHT(n)        ((n)->right)
+#define LOWER(name)         name
+
+#include "lower_tree.h"
+
+#undef AST_NODE
+#undef AST_NONE
+#undef AST_OP
+#undef AST_TYPE
+#undef AST_RVALUE
+#undef AST_VALUE
+#undef AST_SIZE
+#undef AST_NEED
+#undef AST_SIDE_EFFECTS
+#undef AST_SYMBOL
+#undef AST_CASES
+#undef AST_LEFT
+#undef AST_MIDDLE
+#undef AST_RIGHT
+#undef LOWER
+
+// Lowering of the columns of compact_ast
+#define AST_NODE            t_ast_index
+#define AST_NONE            0
+#define AST_OP(n)           (compact_ast.op[n])
+#define AST_TYPE(n)         (compact_ast.type[n])
+#define AST_RVALUE(n)       (compact_ast.rvalue[n])
+#define AST_VALUE(n)        (compact_ast.value[n])
+#define AST_SIZE(n)         (compact_ast.value[n])
+#define AST_NEED(n)         (compact_ast.need[n])
+#define AST_SIDE_EFFECTS(n) (compact_ast.side_effects[n])
+#define AST_SYMBOL(n)       (compact_ast.reference[n].symbol)
+#define AST_CASES(n)        (compact_ast.reference[n].cases)
+#define AST_LEFT(n)         (compact_ast.left[n])
+#define AST_MIDDLE(n)       (compact_ast.middle[n])
+#define AST_RIGHT(n)        (compact_ast.right[n])
+#define LOWER(name)         compact_##name
+
+#include "lower_tree.h"
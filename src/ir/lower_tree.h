@@ -0,0 +1,450 @@
+/*
+    Lowering of a function tree into the IR. The walkers only reach the
+    nodes through the AST_* accessors, and lower.c includes this file
+    once for every AST layout after defining:
+
+        AST_NODE            reference to a node
+        AST_NONE            reference to no node
+        AST_OP(n), AST_TYPE(n), AST_RVALUE(n), AST_VALUE(n), AST_SIZE(n),
+        AST_NEED(n), AST_SIDE_EFFECTS(n),
+        AST_SYMBOL(n), AST_LEFT(n), AST_MIDDLE(n), AST_RIGHT(n)
+        LOWER(name)         name of the walker for this layout
+*/
+
+// Forward declarations
+static int LOWER(lower_expression)(AST_NODE n);
+static void LOWER(lower_statement)(AST_NODE n, t_ir_block* break_to, t_ir_block* continue_to);
+static void LOWER(lower_condition)(AST_NODE n, t_ir_block* if_true, t_ir_block* if_false);
+static int LOWER(lower_logic)(AST_NODE n, int dst);
+
+/*
+    Lower both operands of n into left and right. The operand that needs
+    more registers goes first, so that the result of the other one is not
+    kept live while it is evaluated, unless the order could be observed.
+*/
+static void LOWER(lower_operands)(AST_NODE n, int* left, int* right) {
+    if (AST_NEED(AST_RIGHT(n)) > AST_NEED(AST_LEFT(n))
+            && !AST_SIDE_EFFECTS(AST_LEFT(n)) && !AST_SIDE_EFFECTS(AST_RIGHT(n))) {
+        *right = LOWER(lower_expression)(AST_RIGHT(n));
+        *left = LOWER(lower_expression)(AST_LEFT(n));
+    } else {
+        *left = LOWER(lower_expression)(AST_LEFT(n));
+        *right = LOWER(lower_expression)(AST_RIGHT(n));
+    }
+}
+
+static int LOWER(lower_function_call)(AST_NODE n) {
+    AST_NODE gluetree = AST_LEFT(n);
+    t_ir_instr* call;
+    int* args = NULL;
+    int argc = 0;
+
+    // The glue nodes hold the arguments from the last to the first
+    if (gluetree) {
+        argc = AST_SIZE(gluetree);
+        args = arena_alloc(&ir_arena, argc * sizeof(int));
+    }
+
+    for (; gluetree; gluetree = AST_LEFT(gluetree)) {
+        args[AST_SIZE(gluetree) - 1] = LOWER(lower_expression)(AST_RIGHT(gluetree));
+    }
+
+    call = ir_append(IR_CALL, ir_new_vreg(), NOREG, NOREG);
+    call->symbol = AST_SYMBOL(n);
+    call->args = args;
+    call->argc = argc;
+    return call->dst;
+}
+
+static int LOWER(lower_assignment)(AST_NODE n) {
+    AST_NODE target = AST_RIGHT(n);
+    t_symbol_entry* symbol;
+    t_ir_instr* store;
+    int value, address;
+
+    switch (AST_OP(target)) {
+        case A_IDENTIFIER:
+            value = LOWER(lower_expression)(AST_LEFT(n));
+            symbol = AST_SYMBOL(target);
+
+            store = ir_append(symbol->class == C_GLOBAL ? IR_STORE_GLOBAL : IR_STORE_LOCAL,
+                              NOREG, value, NOREG);
+            store->symbol = symbol;
+            return value;
+
+        case A_DEREFERENCE:
+            // The address is the operand of the dereference
+            LOWER(lower_operands)(n, &value, &address);
+            store = ir_append(IR_STORE, NOREG, value, address);
+            store->type = AST_TYPE(target);
+            return value;
+
+        default:
+            fprintf(stderr, "Cant assign in lower_expression(), op: %d\n", AST_OP(target));
+            exit(1);
+    }
+}
+
+static int LOWER(lower_load)(t_symbol_entry* symbol, int increment) {
+    t_ir_instr* load = ir_append(symbol->class == C_GLOBAL ? IR_LOAD_GLOBAL : IR_LOAD_LOCAL,
+                                 ir_new_vreg(), NOREG, NOREG);
+    load->symbol = symbol;
+    load->value = increment;
+    return load->dst;
+}
+
+static int LOWER(lower_unary)(int op, AST_NODE n) {
+    int operand = LOWER(lower_expression)(AST_LEFT(n));
+    return ir_append(op, ir_new_vreg(), operand, NOREG)->dst;
+}
+
+static int LOWER(lower_binary)(int op, AST_NODE n) {
+    int left, right;
+
+    LOWER(lower_operands)(n, &left, &right);
+    return ir_append(op, ir_new_vreg(), left, right)->dst;
+}
+
+/*
+    Lower an expression and return the virtual register with its value.
+*/
+static int LOWER(lower_expression)(AST_NODE n) {
+    t_ir_instr* ins;
+    int operand;
+
+    switch (AST_OP(n)) {
+        case A_INTLIT:
+            ins = ir_append(IR_CONST, ir_new_vreg(), NOREG, NOREG);
+            ins->value = AST_VALUE(n);
+            return ins->dst;
+
+        case A_STRLIT:
+            ins = ir_append(IR_STRING, ir_new_vreg(), NOREG, NOREG);
+            ins->value = AST_VALUE(n);
+            return ins->dst;
+
+        case A_ADDR:
+            ins = ir_append(IR_ADDRESS, ir_new_vreg(), NOREG, NOREG);
+            ins->symbol = AST_SYMBOL(n);
+            return ins->dst;
+
+        case A_IDENTIFIER:
+            return LOWER(lower_load)(AST_SYMBOL(n), 0);
+
+        case A_POST_INCREMENT:
+        case A_POST_DECREMENT:
+            return LOWER(lower_load)(AST_SYMBOL(n), AST_OP(n));
+
+        case A_PRE_INCREMENT:
+        case A_PRE_DECREMENT:
+            return LOWER(lower_load)(AST_SYMBOL(AST_LEFT(n)), AST_OP(n));
+
+        case A_ASSIGN:
+            return LOWER(lower_assignment)(n);
+
+        case A_FUNCTION_CALL:
+            return LOWER(lower_function_call)(n);
+
+        case A_WIDEN:
+            return LOWER(lower_expression)(AST_LEFT(n));
+
+        case A_SCALE:
+            operand = LOWER(lower_expression)(AST_LEFT(n));
+
+            switch (AST_SIZE(n)) {
+                case 2:
+                case 4:
+                case 8:
+                    ins = ir_append(IR_SHL_CONST, ir_new_vreg(), operand, NOREG);
+                    ins->value = AST_SIZE(n) == 2 ? 1 : AST_SIZE(n) == 4 ? 2 : 3;
+                    return ins->dst;
+                default:
+                    ins = ir_append(IR_CONST, ir_new_vreg(), NOREG, NOREG);
+                    ins->value = AST_SIZE(n);
+                    return ir_append(IR_MUL, ir_new_vreg(), operand, ins->dst)->dst;
+            }
+
+        case A_DEREFERENCE:
+            // Not an rvalue: the address is stored through by the parent
+            operand = LOWER(lower_expression)(AST_LEFT(n));
+
+            if (!AST_RVALUE(n)) {
+                return operand;
+            }
+
+            ins = ir_append(IR_LOAD, ir_new_vreg(), operand, NOREG);
+            ins->type = AST_TYPE(AST_LEFT(n));
+            return ins->dst;
+
+        case A_NEGATE: return LOWER(lower_unary)(IR_NEG, n);
+        case A_INVERT: return LOWER(lower_unary)(IR_INVERT, n);
+        case A_LOGIC_NOT: return LOWER(lower_unary)(IR_LOGIC_NOT, n);
+        case A_LOGIC_AND:
+        case A_LOGIC_OR: return LOWER(lower_logic)(n, NOREG);
+
+        case A_ADD: return LOWER(lower_binary)(IR_ADD, n);
+        case A_SUBTRACT: return LOWER(lower_binary)(IR_SUB, n);
+        case A_MULTIPLY: return LOWER(lower_binary)(IR_MUL, n);
+        case A_DIVIDE: return LOWER(lower_binary)(IR_DIV, n);
+        case A_MOD: return LOWER(lower_binary)(IR_MOD, n);
+        case A_LSHIFT: return LOWER(lower_binary)(IR_SHL, n);
+        case A_RSHIFT: return LOWER(lower_binary)(IR_SHR, n);
+        case A_AND: return LOWER(lower_binary)(IR_AND, n);
+        case A_OR: return LOWER(lower_binary)(IR_OR, n);
+        case A_XOR: return LOWER(lower_binary)(IR_XOR, n);
+
+        case A_EQUALS:
+        case A_NOT_EQUAL:
+        case A_LESS_THAN:
+        case A_GREATER_THAN:
+        case A_LESS_EQUAL:
+        case A_GREATER_EQUAL:
+            return LOWER(lower_binary)(IR_EQ + AST_OP(n) - A_EQUALS, n);
+
+        default:
+            fprintf(stderr, "Unknown AST operator %d\n", AST_OP(n));
+            exit(1);
+    }
+}
+
+/*
+    Lower n into register dst as 0 or 1. A value that is not a comparison
+    is compared with zero.
+*/
+static void LOWER(lower_truth)(AST_NODE n, int dst) {
+    t_ir_instr* zero;
+    int left, right;
+
+    switch (AST_OP(n)) {
+        case A_EQUALS:
+        case A_NOT_EQUAL:
+        case A_LESS_THAN:
+        case A_GREATER_THAN:
+        case A_LESS_EQUAL:
+        case A_GREATER_EQUAL:
+            LOWER(lower_operands)(n, &left, &right);
+            ir_append(IR_EQ + AST_OP(n) - A_EQUALS, dst, left, right);
+            break;
+
+        case A_LOGIC_NOT:
+            ir_append(IR_LOGIC_NOT, dst, LOWER(lower_expression)(AST_LEFT(n)), NOREG);
+            break;
+
+        case A_LOGIC_AND:
+        case A_LOGIC_OR:
+            LOWER(lower_logic)(n, dst);
+            break;
+
+        default:
+            left = LOWER(lower_expression)(n);
+            zero = ir_append(IR_CONST, ir_new_vreg(), NOREG, NOREG);
+            ir_append(IR_NE, dst, left, zero->dst);
+            break;
+    }
+}
+
+/*
+    Lower '&&' or '||' used as a value into register dst, a new one if
+    dst is NOREG. The register is set to the result that the left
+    operand decides, the right operand is reached only if the left one
+    does not decide and sets it to its own truth value. Return the
+    register.
+*/
+static int LOWER(lower_logic)(AST_NODE n, int dst) {
+    t_ir_block* right = ir_new_block();
+    t_ir_block* end = ir_new_block();
+    t_ir_instr* decided = ir_append(IR_CONST, dst == NOREG ? ir_new_vreg() : dst, NOREG, NOREG);
+
+    if (AST_OP(n) == A_LOGIC_AND) {
+        decided->value = 0;
+        LOWER(lower_condition)(AST_LEFT(n), right, end);
+    } else {
+        decided->value = 1;
+        LOWER(lower_condition)(AST_LEFT(n), end, right);
+    }
+
+    ir_place_block(right);
+    LOWER(lower_truth)(AST_RIGHT(n), decided->dst);
+    ir_place_block(end);
+    return decided->dst;
+}
+
+/*
+    Lower the condition of an if or while statement into a branch to
+    if_true or if_false. '&&' and '||' branch on their left operand to
+    the block of the right one or straight to the target the left one
+    decides, '!' swaps the targets and a constant jumps. A value that is
+    not a comparison is tested against zero.
+*/
+static void LOWER(lower_condition)(AST_NODE n, t_ir_block* if_true, t_ir_block* if_false) {
+    t_ir_block* right_block;
+    t_ir_instr* zero;
+    int left, right;
+
+    switch (AST_OP(n)) {
+        case A_EQUALS:
+        case A_NOT_EQUAL:
+        case A_LESS_THAN:
+        case A_GREATER_THAN:
+        case A_LESS_EQUAL:
+        case A_GREATER_EQUAL:
+            LOWER(lower_operands)(n, &left, &right);
+            ir_branch(IR_EQ + AST_OP(n) - A_EQUALS, left, right, if_true, if_false);
+            break;
+
+        case A_LOGIC_AND:
+            right_block = ir_new_block();
+            LOWER(lower_condition)(AST_LEFT(n), right_block, if_false);
+            ir_place_block(right_block);
+            LOWER(lower_condition)(AST_RIGHT(n), if_true, if_false);
+            break;
+
+        case A_LOGIC_OR:
+            right_block = ir_new_block();
+            LOWER(lower_condition)(AST_LEFT(n), if_true, right_block);
+            ir_place_block(right_block);
+            LOWER(lower_condition)(AST_RIGHT(n), if_true, if_false);
+            break;
+
+        case A_LOGIC_NOT:
+            LOWER(lower_condition)(AST_LEFT(n), if_false, if_true);
+            break;
+
+        case A_INTLIT:
+            ir_jump(AST_VALUE(n) ? if_true : if_false);
+            break;
+
+        default:
+            left = LOWER(lower_expression)(n);
+            zero = ir_append(IR_CONST, ir_new_vreg(), NOREG, NOREG);
+            ir_branch(IR_NE, left, zero->dst, if_true, if_false);
+            break;
+    }
+}
+
+static void LOWER(lower_if)(AST_NODE n, t_ir_block* break_to, t_ir_block* continue_to) {
+    t_ir_block* then_block = ir_new_block();
+    t_ir_block* else_block = ir_new_block();
+    t_ir_block* end_block = AST_RIGHT(n) ? ir_new_block() : else_block;
+
+    LOWER(lower_condition)(AST_LEFT(n), then_block, else_block);
+
+    ir_place_block(then_block);
+    LOWER(lower_statement)(AST_MIDDLE(n), break_to, continue_to);
+
+    if (AST_RIGHT(n)) {
+        ir_jump(end_block);
+        ir_place_block(else_block);
+        LOWER(lower_statement)(AST_RIGHT(n), break_to, continue_to);
+    }
+
+    ir_place_block(end_block);
+}
+
+static void LOWER(lower_while)(AST_NODE n) {
+    t_ir_block* head = ir_new_block();
+    t_ir_block* body = ir_new_block();
+    t_ir_block* end = ir_new_block();
+
+    ir_place_block(head);
+    LOWER(lower_condition)(AST_LEFT(n), body, end);
+
+    ir_place_block(body);
+    LOWER(lower_statement)(AST_RIGHT(n), end, head);
+    ir_jump(head);
+
+    ir_place_block(end);
+}
+
+static void LOWER(lower_switch)(AST_NODE n, t_ir_block* continue_to) {
+    t_case_table* table = AST_CASES(n);
+    t_ir_block* end = ir_new_block();
+    t_ir_block** blocks;
+    t_ir_block** case_blocks;
+    t_ir_instr* ins;
+    int cases = 0;
+    int i;
+    AST_NODE c;
+
+    ins = ir_append(IR_SWITCH, NOREG, LOWER(lower_expression)(AST_LEFT(n)), NOREG);
+
+    // One target per case in the order of the table, the default (or
+    // the end) comes last
+    blocks = arena_alloc(&ir_arena, AST_VALUE(n) * sizeof(t_ir_block*));
+    case_blocks = arena_alloc(&ir_arena, (table->count + 1) * sizeof(t_ir_block*));
+    ins->args = arena_alloc(&ir_arena, (table->count + 1) * sizeof(int));
+    ins->targets = arena_alloc(&ir_arena, (table->count + 1) * sizeof(t_ir_block*));
+    ins->targets[table->count] = end;
+
+    for (i = 0, c = AST_RIGHT(n); c != AST_NONE; i++, c = AST_RIGHT(c)) {
+        blocks[i] = ir_new_block();
+
+        if (AST_OP(c) == A_DEFAULT) {
+            ins->targets[table->count] = blocks[i];
+        } else {
+            case_blocks[cases++] = blocks[i];
+        }
+    }
+
+    for (i = 0; i < table->count; i++) {
+        ins->args[i] = table->labels[i].value;
+        ins->targets[i] = case_blocks[table->labels[i].position];
+    }
+
+    ins->argc = table->count;
+    ins->ntargets = table->count + 1;
+
+    // The cases fall through into each other
+    for (i = 0, c = AST_RIGHT(n); c != AST_NONE; i++, c = AST_RIGHT(c)) {
+        ir_place_block(blocks[i]);
+        LOWER(lower_statement)(AST_LEFT(c), end, continue_to);
+    }
+
+    ir_place_block(end);
+}
+
+static void LOWER(lower_statement)(AST_NODE n, t_ir_block* break_to, t_ir_block* continue_to) {
+    int value;
+
+    if (n == AST_NONE) {
+        return;
+    }
+
+    switch (AST_OP(n)) {
+        case A_GLUE:
+            LOWER(lower_statement)(AST_LEFT(n), break_to, continue_to);
+            LOWER(lower_statement)(AST_RIGHT(n), break_to, continue_to);
+            break;
+        case A_IF:
+            LOWER(lower_if)(n, break_to, continue_to);
+            break;
+        case A_WHILE:
+            LOWER(lower_while)(n);
+            break;
+        case A_SWITCH:
+            LOWER(lower_switch)(n, continue_to);
+            break;
+        case A_BREAK:
+            ir_jump(break_to);
+            break;
+        case A_CONTINUE:
+            ir_jump(continue_to);
+            break;
+        case A_RETURN:
+            value = AST_LEFT(n) ? LOWER(lower_expression)(AST_LEFT(n)) : NOREG;
+            ir_append(IR_RETURN, NOREG, value, NOREG);
+            break;
+        default:
+            LOWER(lower_expression)(n);
+            break;
+    }
+}
+
+/*
+    Lower the tree of a function, rooted at its A_FUNCTION node.
+*/
+t_ir_function* LOWER(lower_function)(AST_NODE n) {
+    ir_begin_function(AST_SYMBOL(n));
+    LOWER(lower_statement)(AST_LEFT(n), NULL, NULL);
+    return ir_end_function();
+}
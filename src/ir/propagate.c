@@ -0,0 +1,514 @@
+#include "../../include/ir.h"
+#include "../../include/interpret.h"
+
+// Sparse conditional constant propagation after Wegman and Zadeck,
+// "Constant Propagation with Conditional Branches", followed by copy
+// propagation, on a function in SSA form.
+//
+// Every register starts unknown and is lowered to a constant or to
+// overdefined as the instructions defining it are evaluated. Only blocks
+// reached over edges found executable are evaluated, so a value merged
+// from a branch that is never taken does not spoil a phi.
+
+enum {
+    UNKNOWN,
+    CONSTANT,
+    OVERDEFINED
+};
+
+// AST operator of every IR operator folded by evaluate_operator()
+static const int ast_operator[] = {
+    [IR_ADD] = A_ADD, [IR_SUB] = A_SUBTRACT, [IR_MUL] = A_MULTIPLY,
+    [IR_DIV] = A_DIVIDE, [IR_MOD] = A_MOD, [IR_SHL] = A_LSHIFT, [IR_SHR] = A_RSHIFT,
+    [IR_AND] = A_AND, [IR_OR] = A_OR, [IR_XOR] = A_XOR,
+    [IR_EQ] = A_EQUALS, [IR_NE] = A_NOT_EQUAL, [IR_LT] = A_LESS_THAN,
+    [IR_GT] = A_GREATER_THAN, [IR_LE] = A_LESS_EQUAL, [IR_GE] = A_GREATER_EQUAL,
+    [IR_SHL_CONST] = A_LSHIFT, [IR_NEG] = A_NEGATE, [IR_INVERT] = A_INVERT,
+    [IR_LOGIC_NOT] = A_LOGIC_NOT
+};
+
+// Lattice value of every register
+static char* kind;
+static int* value;
+static int* defs;
+
+// Instructions that use every register, users[first_user[v] ..
+// first_user[v + 1] - 1]
+static int* first_user;
+static t_ir_instr** users;
+
+// Executable edges, one flag per predecessor of a block, and the blocks
+// reached over them
+static char** executable;
+static char* reached;
+
+static t_ir_block** block_worklist;
+static int block_top;
+static t_ir_instr** instr_worklist;
+static int instr_top;
+
+// Registers whose definition became a constant
+static char* substituted;
+
+// Register a copy or phi is replaced by, NOREG if none
+static int* alias;
+
+// Statistics for -v
+static int constant_uses;
+static int copy_uses;
+static int branches_removed;
+static int blocks_removed;
+
+static int pred_index(t_ir_block* b, t_ir_block* p) {
+    int j;
+
+    for (j = 0; j < b->npreds && b->preds[j] != p; j++);
+    return j;
+}
+
+static void mark_edge(t_ir_block* p, t_ir_block* b) {
+    int j = pred_index(b, p);
+
+    if (!executable[b->id][j]) {
+        executable[b->id][j] = 1;
+        block_worklist[block_top++] = b;
+    }
+}
+
+// Lower register v to the meet of its value and (k, c), and revisit its
+// users if it changed.
+static void lower(int v, int k, int c) {
+    if (kind[v] == OVERDEFINED || k == UNKNOWN || (kind[v] == CONSTANT && k == CONSTANT && value[v] == c)) {
+        return;
+    }
+
+    if (kind[v] == CONSTANT) {
+        k = OVERDEFINED;
+    }
+
+    kind[v] = k;
+    value[v] = c;
+
+    for (int i = first_user[v]; i < first_user[v + 1]; i++) {
+        instr_worklist[instr_top++] = users[i];
+    }
+}
+
+// Return the value a truncation to type leaves of constant c, as the
+// movzbq or movslq of the generated code would.
+static int truncated(int c, int type) {
+    switch (get_primitive_size(type)) {
+        case 1: return c & 0xff;
+        default: return c;
+    }
+}
+
+static void visit(t_ir_instr* ins) {
+    t_ir_block* b = ins->block;
+    int k1 = ins->src1 == NOREG ? CONSTANT : kind[ins->src1];
+    int k2 = ins->src2 == NOREG ? CONSTANT : kind[ins->src2];
+    int c1 = ins->src1 == NOREG ? 0 : value[ins->src1];
+    int c2 = ins->src2 == NOREG ? 0 : value[ins->src2];
+    int c, i;
+
+    switch (ins->op) {
+        case IR_CONST:
+            lower(ins->dst, CONSTANT, ins->value);
+            return;
+
+        case IR_COPY:
+            lower(ins->dst, k1, c1);
+            return;
+
+        case IR_PHI:
+            for (i = 0; i < ins->argc; i++) {
+                if (executable[b->id][i]) {
+                    lower(ins->dst, kind[ins->args[i]], value[ins->args[i]]);
+                }
+            }
+            return;
+
+        case IR_ADD: case IR_SUB: case IR_MUL: case IR_DIV: case IR_MOD:
+        case IR_SHL: case IR_SHR: case IR_AND: case IR_OR: case IR_XOR:
+        case IR_EQ: case IR_NE: case IR_LT: case IR_GT: case IR_LE: case IR_GE:
+        case IR_SHL_CONST: case IR_NEG: case IR_INVERT: case IR_LOGIC_NOT:
+        case IR_TRUNCATE:
+            if (k1 == OVERDEFINED || k2 == OVERDEFINED) {
+                lower(ins->dst, OVERDEFINED, 0);
+            } else if (k1 == CONSTANT && k2 == CONSTANT) {
+                if (ins->op == IR_TRUNCATE) {
+                    lower(ins->dst, CONSTANT, truncated(c1, ins->type));
+                } else if (evaluate_operator(ast_operator[ins->op], c1,
+                        ins->op == IR_SHL_CONST ? ins->value : c2, &c)) {
+                    lower(ins->dst, CONSTANT, c);
+                } else {
+                    lower(ins->dst, OVERDEFINED, 0);
+                }
+            }
+            return;
+
+        case IR_JUMP:
+            mark_edge(b, ins->targets[0]);
+            return;
+
+        case IR_BRANCH:
+            if (k1 == OVERDEFINED || k2 == OVERDEFINED) {
+                mark_edge(b, ins->targets[0]);
+                mark_edge(b, ins->targets[1]);
+            } else if (k1 == CONSTANT && k2 == CONSTANT) {
+                if (evaluate_operator(ast_operator[ins->value], c1, c2, &c)) {
+                    mark_edge(b, ins->targets[c ? 0 : 1]);
+                } else {
+                    mark_edge(b, ins->targets[0]);
+                    mark_edge(b, ins->targets[1]);
+                }
+            }
+            return;
+
+        case IR_SWITCH:
+            if (k1 == OVERDEFINED) {
+                for (i = 0; i < ins->ntargets; i++) {
+                    mark_edge(b, ins->targets[i]);
+                }
+            } else if (k1 == CONSTANT) {
+                for (i = 0; i < ins->argc && ins->args[i] != c1; i++);
+                mark_edge(b, ins->targets[i]);
+            }
+            return;
+
+        default:
+            // Loads, calls, addresses and parameters
+            if (ins->dst != NOREG) {
+                lower(ins->dst, OVERDEFINED, 0);
+            }
+            return;
+    }
+}
+
+// Count the definitions and collect the users of every register.
+static void find_users(t_ir_function* fn) {
+    int n = fn->nvregs;
+    int* p;
+
+    defs = arena_alloc(&ir_arena, (n + 1) * sizeof(int));
+    first_user = arena_alloc(&ir_arena, (n + 2) * sizeof(int));
+
+    for (t_ir_block* b = fn->first; b != NULL; b = b->next) {
+        for (t_ir_instr* ins = b->first; ins != NULL; ins = ins->next) {
+            for (int i = 0; (p = ir_operand(ins, i)) != NULL; i++) {
+                if (*p != NOREG) {
+                    first_user[*p + 1]++;
+                }
+            }
+
+            if (ins->dst != NOREG) {
+                defs[ins->dst]++;
+            }
+        }
+    }
+
+    for (int v = 0; v < n; v++) {
+        first_user[v + 1] += first_user[v];
+    }
+
+    users = arena_alloc(&ir_arena, (first_user[n] + 1) * sizeof(t_ir_instr*));
+
+    for (t_ir_block* b = fn->first; b != NULL; b = b->next) {
+        for (t_ir_instr* ins = b->first; ins != NULL; ins = ins->next) {
+            for (int i = 0; (p = ir_operand(ins, i)) != NULL; i++) {
+                if (*p != NOREG) {
+                    users[first_user[*p]++] = ins;
+                }
+            }
+        }
+    }
+
+    // The fill moved every start to the next register
+    for (int v = n; v > 0; v--) {
+        first_user[v] = first_user[v - 1];
+    }
+
+    first_user[0] = 0;
+}
+
+static void propagate(t_ir_function* fn) {
+    int n = fn->nvregs;
+    int edges = 1;
+
+    kind = arena_alloc(&ir_arena, n + 1);
+    value = arena_alloc(&ir_arena, (n + 1) * sizeof(int));
+    executable = arena_alloc(&ir_arena, fn->nblocks * sizeof(char*));
+    reached = arena_alloc(&ir_arena, fn->nblocks);
+
+    // A register with several definitions is not in SSA form, '&&' and
+    // '||' set their result in two blocks
+    for (int v = 0; v < n; v++) {
+        if (defs[v] != 1) {
+            kind[v] = OVERDEFINED;
+        }
+    }
+
+    for (t_ir_block* b = fn->first; b != NULL; b = b->next) {
+        executable[b->id] = arena_alloc(&ir_arena, b->npreds + 1);
+        edges += b->npreds;
+    }
+
+    // A block is queued once per executable edge into it, a register is
+    // lowered at most twice
+    block_worklist = arena_alloc(&ir_arena, edges * sizeof(t_ir_block*));
+    instr_worklist = arena_alloc(&ir_arena, (2 * first_user[n] + 1) * sizeof(t_ir_instr*));
+    block_top = instr_top = 0;
+    block_worklist[block_top++] = fn->first;
+
+    while (block_top > 0 || instr_top > 0) {
+        if (block_top > 0) {
+            t_ir_block* b = block_worklist[--block_top];
+
+            // A block reached before only merges the new edge into its phis
+            for (t_ir_instr* ins = b->first; ins != NULL; ins = ins->next) {
+                if (reached[b->id] && ins->op != IR_PHI) {
+                    break;
+                }
+
+                visit(ins);
+            }
+
+            reached[b->id] = 1;
+        } else {
+            t_ir_instr* ins = instr_worklist[--instr_top];
+
+            if (reached[ins->block->id]) {
+                visit(ins);
+            }
+        }
+    }
+}
+
+// Replace the instructions with a constant result by the constant, the
+// phis among them go after the other phis of the block.
+static void substitute_constants(t_ir_function* fn) {
+    substituted = arena_alloc(&ir_arena, fn->nvregs + 1);
+
+    for (t_ir_block* b = fn->first; b != NULL; b = b->next) {
+        t_ir_instr *ins, *next, *body;
+
+        for (body = b->first; body->op == IR_PHI; body = body->next);
+
+        for (ins = b->first; ins != NULL; ins = next) {
+            next = ins->next;
+
+            if (ins->dst == NOREG || ins->op == IR_CONST || kind[ins->dst] != CONSTANT) {
+                continue;
+            }
+
+            substituted[ins->dst] = 1;
+
+            if (ins->op == IR_PHI) {
+                ir_remove(ins);
+                ir_insert(b, body, ins);
+            }
+
+            ins->op = IR_CONST;
+            ins->value = value[ins->dst];
+            ins->src1 = ins->src2 = NOREG;
+            ins->symbol = NULL;
+            ins->args = NULL;
+            ins->argc = 0;
+        }
+    }
+}
+
+// Turn the branches and switches with one executable edge into jumps,
+// drop the blocks never reached and the phi operands of the edges gone.
+static void remove_dead_branches(t_ir_function* fn) {
+    t_ir_block*** old_preds = arena_alloc(&ir_arena, fn->nblocks * sizeof(t_ir_block**));
+    t_ir_block* prev = NULL;
+    int* old_npreds = arena_alloc(&ir_arena, fn->nblocks * sizeof(int));
+    int id = 0;
+
+    for (t_ir_block* b = fn->first; b != NULL; b = b->next) {
+        t_ir_instr* last = b->last;
+        t_ir_block* taken = NULL;
+        int count = 0;
+
+        if (!reached[b->id] || (last->op != IR_BRANCH && last->op != IR_SWITCH)) {
+            continue;
+        }
+
+        for (int i = 0; i < last->ntargets; i++) {
+            t_ir_block* t = last->targets[i];
+
+            if (t != taken && executable[t->id][pred_index(t, b)]) {
+                taken = t;
+                count++;
+            }
+        }
+
+        if (count == 1) {
+            last->op = IR_JUMP;
+            last->src1 = last->src2 = NOREG;
+            last->value = 0;
+            last->args = NULL;
+            last->argc = 0;
+            last->targets[0] = taken;
+            last->ntargets = 1;
+            branches_removed++;
+        }
+    }
+
+    // Keep the old predecessors of every block to match the phi operands
+    for (t_ir_block* b = fn->first; b != NULL; b = b->next) {
+        t_ir_block** preds = arena_alloc(&ir_arena, (b->npreds + 1) * sizeof(t_ir_block*));
+
+        for (int j = 0; j < b->npreds; j++) {
+            preds[j] = b->preds[j];
+        }
+
+        old_preds[b->id] = preds;
+        old_npreds[b->id] = b->npreds;
+    }
+
+    for (t_ir_block* b = fn->first; b != NULL; b = b->next) {
+        if (!reached[b->id]) {
+            blocks_removed++;
+            continue;
+        }
+
+        if (prev == NULL) {
+            fn->first = b;
+        } else {
+            prev->next = b;
+        }
+
+        prev = b;
+    }
+
+    prev->next = NULL;
+    fn->last = prev;
+    ir_build_cfg(fn);
+
+    for (t_ir_block* b = fn->first; b != NULL; b = b->next) {
+        t_ir_block** preds = old_preds[b->id];
+
+        for (t_ir_instr* ins = b->first; ins != NULL && ins->op == IR_PHI; ins = ins->next) {
+            int* args = arena_alloc(&ir_arena, (b->npreds + 1) * sizeof(int));
+
+            for (int j = 0; j < b->npreds; j++) {
+                int i;
+
+                for (i = 0; i < old_npreds[b->id] && preds[i] != b->preds[j]; i++);
+                args[j] = ins->args[i];
+            }
+
+            ins->args = args;
+            ins->argc = b->npreds;
+        }
+    }
+
+    for (t_ir_block* b = fn->first; b != NULL; b = b->next) {
+        b->id = id++;
+    }
+
+    fn->nblocks = id;
+}
+
+static int resolve(int v) {
+    while (alias[v] != NOREG) {
+        v = alias[v];
+    }
+
+    return v;
+}
+
+// Return the register all operands of phi other than its own result
+// stand for, NOREG if they differ.
+static int phi_copy(t_ir_instr* phi) {
+    int source = NOREG;
+
+    for (int i = 0; i < phi->argc; i++) {
+        int v = resolve(phi->args[i]);
+
+        if (v == phi->dst || v == source) {
+            continue;
+        }
+
+        if (source != NOREG) {
+            return NOREG;
+        }
+
+        source = v;
+    }
+
+    return source;
+}
+
+// Replace the uses of copies, and of phis that merge one value, by the
+// register copied, and count the uses of the constants substituted.
+// Only registers with a single definition are followed: ir_from_ssa()
+// splits the edges it places the copies of a phi on, so the longer live
+// range of the source cannot overlap its next value.
+static void propagate_copies(t_ir_function* fn) {
+    int changed;
+    int* p;
+
+    alias = arena_alloc(&ir_arena, (fn->nvregs + 1) * sizeof(int));
+
+    for (int v = 0; v < fn->nvregs; v++) {
+        alias[v] = NOREG;
+    }
+
+    do {
+        changed = 0;
+
+        for (t_ir_block* b = fn->first; b != NULL; b = b->next) {
+            t_ir_instr *ins, *next;
+
+            for (ins = b->first; ins != NULL; ins = next) {
+                int source = NOREG;
+                next = ins->next;
+
+                if (ins->op == IR_COPY) {
+                    source = resolve(ins->src1);
+                } else if (ins->op == IR_PHI) {
+                    source = phi_copy(ins);
+                }
+
+                if (source != NOREG && defs[ins->dst] == 1 && defs[source] == 1) {
+                    alias[ins->dst] = source;
+                    ir_remove(ins);
+                    changed = 1;
+                }
+            }
+        }
+    } while (changed);
+
+    for (t_ir_block* b = fn->first; b != NULL; b = b->next) {
+        for (t_ir_instr* ins = b->first; ins != NULL; ins = ins->next) {
+            for (int i = 0; (p = ir_operand(ins, i)) != NULL; i++) {
+                if (*p != NOREG && alias[*p] != NOREG) {
+                    *p = resolve(*p);
+                    copy_uses++;
+                }
+
+                if (*p != NOREG && substituted[*p]) {
+                    constant_uses++;
+                }
+            }
+        }
+    }
+}
+
+void ir_propagate(t_ir_function* fn) {
+    find_users(fn);
+    propagate(fn);
+    substitute_constants(fn);
+    remove_dead_branches(fn);
+    propagate_copies(fn);
+}
+
+void report_propagation_statistics(char* filename) {
+    fprintf(stderr, "%s: propagation: %d uses of constants, %d uses of copies, %d branches and %d blocks removed\n",
+            filename, constant_uses, copy_uses, branches_removed, blocks_removed);
+
+    constant_uses = copy_uses = branches_removed = blocks_removed = 0;
+}
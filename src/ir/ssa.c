@@ -0,0 +1,544 @@
+#include "../../include/ir.h"
+#include "../../include/symbol.h"
+#include "../../include/types.h"
+#include "../../include/code_generation.h"
+
+#define SET(set, i)         ((set)[(i) / 64] |= 1ul << ((i) % 64))
+
+// Variables of the function being converted
+static t_symbol_entry** variables;
+static int nvariables;
+
+// Renaming: the current value of every variable, the value before the
+// function (loaded parameter or zero) and the log to undo the values
+// set in a subtree of the dominator tree
+static int* current;
+static int* initial;
+static int* log_variable;
+static int* log_value;
+static int log_top;
+
+// Register a load is replaced by, NOREG if none
+static int* alias;
+
+// Type a register is known to be cut to, 0 if unknown
+static int* cut_to;
+
+static int is_scalar(t_symbol_entry* symbol) {
+    if (symbol->stype != S_VARIABLE) {
+        return 0;
+    }
+
+    return pointer_type(symbol->type) || symbol->type == TYPE_CHAR
+           || symbol->type == TYPE_INT || symbol->type == TYPE_LONG;
+}
+
+// Return the index of the variable symbol stands for, -1 if it is not
+// one of the variables kept in registers.
+static int index_of(t_symbol_entry* symbol) {
+    int v = symbol->variable;
+
+    if (v < 0 || v >= nvariables || variables[v] != symbol) {
+        return -1;
+    }
+
+    return v;
+}
+
+static int variable_of(t_ir_instr* ins) {
+    if (ins->op != IR_LOAD_LOCAL && ins->op != IR_STORE_LOCAL) {
+        return -1;
+    }
+
+    return index_of(ins->symbol);
+}
+
+// Number the locals and parameters that can live in registers: scalars
+// that no instruction takes the address of.
+static void find_variables(t_ir_function* fn) {
+    t_symbol_entry* s;
+    int count = 0;
+
+    for (s = fn->symbol->member; s != NULL; s = s->next) {
+        count++;
+    }
+
+    for (s = local_symbols->head; s != NULL; s = s->next) {
+        count++;
+    }
+
+    variables = arena_alloc(&ir_arena, (count + 1) * sizeof(t_symbol_entry*));
+    nvariables = 0;
+
+    for (s = fn->symbol->member; s != NULL; s = s->next) {
+        variables[nvariables] = s;
+        s->variable = nvariables++;
+    }
+
+    for (s = local_symbols->head; s != NULL; s = s->next) {
+        variables[nvariables] = s;
+        s->variable = nvariables++;
+    }
+
+    for (t_ir_block* b = fn->first; b != NULL; b = b->next) {
+        for (t_ir_instr* ins = b->first; ins != NULL; ins = ins->next) {
+            if (ins->op == IR_ADDRESS && index_of(ins->symbol) >= 0) {
+                ins->symbol->variable = -1;
+            }
+        }
+    }
+
+    for (int v = 0; v < nvariables; v++) {
+        if (!is_scalar(variables[v])) {
+            variables[v]->variable = -1;
+        }
+    }
+}
+
+// Compute which variables are live into every block, so that phis are
+// only placed where their value is used (pruned SSA).
+static unsigned long** live_variables(t_ir_function* fn, t_ir_block** blocks, int words) {
+    unsigned long** live_in = arena_alloc(&ir_arena, fn->nblocks * sizeof(unsigned long*));
+    unsigned long** use = arena_alloc(&ir_arena, fn->nblocks * sizeof(unsigned long*));
+    unsigned long** def = arena_alloc(&ir_arena, fn->nblocks * sizeof(unsigned long*));
+    int changed;
+    int v;
+
+    for (t_ir_block* b = fn->first; b != NULL; b = b->next) {
+        live_in[b->id] = arena_alloc(&ir_arena, (words + 1) * sizeof(unsigned long));
+        use[b->id] = arena_alloc(&ir_arena, (words + 1) * sizeof(unsigned long));
+        def[b->id] = arena_alloc(&ir_arena, (words + 1) * sizeof(unsigned long));
+
+        for (t_ir_instr* ins = b->first; ins != NULL; ins = ins->next) {
+            if ((v = variable_of(ins)) < 0) {
+                continue;
+            }
+
+            // Increments read the variable before they write it
+            if (ins->op == IR_LOAD_LOCAL && !IR_TEST(def[b->id], v)) {
+                SET(use[b->id], v);
+            }
+
+            if (ins->op == IR_STORE_LOCAL || ins->value != 0) {
+                SET(def[b->id], v);
+            }
+        }
+    }
+
+    do {
+        changed = 0;
+
+        for (int id = fn->nblocks - 1; id >= 0; id--) {
+            t_ir_block* b = blocks[id];
+
+            for (int w = 0; w < words; w++) {
+                unsigned long out = 0, in;
+
+                for (int i = 0; i < b->last->ntargets; i++) {
+                    out |= live_in[b->last->targets[i]->id][w];
+                }
+
+                in = use[id][w] | (out & ~def[id][w]);
+
+                if (in != live_in[id][w]) {
+                    live_in[id][w] = in;
+                    changed = 1;
+                }
+            }
+        }
+    } while (changed);
+
+    return live_in;
+}
+
+// Place a phi for every variable at the iterated dominance frontier of
+// the blocks that assign it, where the variable is live.
+static void insert_phis(t_ir_function* fn) {
+    t_ir_block** blocks = arena_alloc(&ir_arena, fn->nblocks * sizeof(t_ir_block*));
+    t_ir_block** worklist = arena_alloc(&ir_arena, fn->nblocks * sizeof(t_ir_block*));
+    int* queued = arena_alloc(&ir_arena, fn->nblocks * sizeof(int));
+    int* has_phi = arena_alloc(&ir_arena, fn->nblocks * sizeof(int));
+    int words = IR_BIT_WORDS(nvariables);
+    unsigned long** live_in;
+    int top, v;
+
+    for (t_ir_block* b = fn->first; b != NULL; b = b->next) {
+        blocks[b->id] = b;
+        queued[b->id] = has_phi[b->id] = -1;
+    }
+
+    live_in = live_variables(fn, blocks, words);
+
+    for (v = 0; v < nvariables; v++) {
+        if (variables[v]->variable != v) {
+            continue;
+        }
+
+        top = 0;
+
+        for (t_ir_block* b = fn->first; b != NULL; b = b->next) {
+            for (t_ir_instr* ins = b->first; ins != NULL; ins = ins->next) {
+                if (variable_of(ins) == v && (ins->op == IR_STORE_LOCAL || ins->value != 0)) {
+                    queued[b->id] = v;
+                    worklist[top++] = b;
+                    break;
+                }
+            }
+        }
+
+        while (top > 0) {
+            t_ir_block* b = worklist[--top];
+
+            for (t_ir_block_list* f = b->frontier; f != NULL; f = f->next) {
+                t_ir_block* d = f->block;
+
+                if (has_phi[d->id] == v || !IR_TEST(live_in[d->id], v)) {
+                    continue;
+                }
+
+                t_ir_instr* phi = ir_new_instr(IR_PHI, fn->nvregs++, NOREG, NOREG);
+                phi->symbol = variables[v];
+                phi->argc = d->npreds;
+                phi->args = arena_alloc(&ir_arena, d->npreds * sizeof(int));
+                ir_insert(d, d->first, phi);
+                has_phi[d->id] = v;
+
+                if (queued[d->id] != v) {
+                    queued[d->id] = v;
+                    worklist[top++] = d;
+                }
+            }
+        }
+    }
+}
+
+static int cut(t_ir_function* fn, t_ir_instr* pos, int v, int value);
+
+static void set_current(int v, int value) {
+    log_variable[log_top] = v;
+    log_value[log_top++] = current[v];
+    current[v] = value;
+}
+
+// Return the value of variable v at this point. Before any assignment
+// parameters hold what was passed, locals are zero. These values are
+// set at the start of the entry block, before anything that could
+// destroy the registers of the parameters.
+static int value_of(t_ir_function* fn, int v) {
+    t_ir_instr* ins;
+
+    if (current[v] != NOREG) {
+        return current[v];
+    }
+
+    if (initial[v] == NOREG) {
+        // Parameters come first in variables[]
+        if (variables[v]->class == C_PARAMETER && v < NUM_PARAMETER_REGISTERS) {
+            ins = ir_new_instr(IR_PARAM, fn->nvregs++, NOREG, NOREG);
+            ins->symbol = variables[v];
+            ins->value = v + 1;
+        } else if (variables[v]->class == C_PARAMETER) {
+            ins = ir_new_instr(IR_LOAD_LOCAL, fn->nvregs++, NOREG, NOREG);
+            ins->symbol = variables[v];
+            cut_to[ins->dst] = variables[v]->type;
+        } else {
+            ins = ir_new_instr(IR_CONST, fn->nvregs++, NOREG, NOREG);
+            cut_to[ins->dst] = TYPE_CHAR;
+        }
+
+        ir_insert(fn->first, fn->first->first, ins);
+        initial[v] = cut(fn, ins->next, v, ins->dst);
+    }
+
+    return initial[v];
+}
+
+// Return a value fit to be kept in variable v, as if it had been
+// stored to memory and loaded back.
+static int cut(t_ir_function* fn, t_ir_instr* pos, int v, int value) {
+    int type = variables[v]->type;
+    t_ir_instr* ins;
+
+    if (pointer_type(type) || type == TYPE_LONG || cut_to[value] == type
+            || (cut_to[value] == TYPE_CHAR && type == TYPE_INT)) {
+        return value;
+    }
+
+    ins = ir_new_instr(IR_TRUNCATE, fn->nvregs++, value, NOREG);
+    ins->type = type;
+    ir_insert(pos->block, pos, ins);
+    return ins->dst;
+}
+
+// Replace the increment of variable v by ins with an addition.
+static int increment(t_ir_function* fn, t_ir_instr* ins, int v) {
+    int op = ins->value == A_PRE_INCREMENT || ins->value == A_POST_INCREMENT ? IR_ADD : IR_SUB;
+    t_ir_instr* one = ir_new_instr(IR_CONST, fn->nvregs++, NOREG, NOREG);
+    t_ir_instr* sum = ir_new_instr(op, fn->nvregs++, value_of(fn, v), one->dst);
+
+    one->value = 1;
+    cut_to[one->dst] = TYPE_CHAR;
+    ir_insert(ins->block, ins, one);
+    ir_insert(ins->block, ins, sum);
+    return cut(fn, ins, v, sum->dst);
+}
+
+// Note which registers are known to fit a type, so stores of them to
+// a variable need not cut them.
+static void find_cut_values(t_ir_function* fn) {
+    for (t_ir_block* b = fn->first; b != NULL; b = b->next) {
+        for (t_ir_instr* ins = b->first; ins != NULL; ins = ins->next) {
+            switch (ins->op) {
+                case IR_CONST:
+                    if (ins->value >= 0 && ins->value <= 255) {
+                        cut_to[ins->dst] = TYPE_CHAR;
+                    } else {
+                        cut_to[ins->dst] = TYPE_INT;
+                    }
+                    break;
+                case IR_LOAD_LOCAL:
+                case IR_LOAD_GLOBAL:
+                    if (!pointer_type(ins->symbol->type)) {
+                        cut_to[ins->dst] = ins->symbol->type;
+                    }
+                    break;
+                case IR_LOAD:
+                    cut_to[ins->dst] = value_at(ins->type);
+                    break;
+                case IR_EQ:
+                case IR_NE:
+                case IR_LT:
+                case IR_GT:
+                case IR_LE:
+                case IR_GE:
+                case IR_LOGIC_NOT:
+                    cut_to[ins->dst] = TYPE_CHAR;
+                    break;
+            }
+        }
+    }
+}
+
+// Rename the variables in the dominator subtree of b: loads become the
+// current value, stores set it.
+static void rename_block(t_ir_function* fn, t_ir_block* b) {
+    int log_start = log_top;
+    t_ir_instr *ins, *next;
+    int* p;
+    int v;
+
+    for (ins = b->first; ins != NULL; ins = next) {
+        next = ins->next;
+
+        if (ins->op == IR_PHI) {
+            set_current(ins->symbol->variable, ins->dst);
+            continue;
+        }
+
+        for (int i = 0; (p = ir_operand(ins, i)) != NULL; i++) {
+            if (*p != NOREG && alias[*p] != NOREG) {
+                *p = alias[*p];
+            }
+        }
+
+        if ((v = variable_of(ins)) < 0) {
+            continue;
+        }
+
+        if (ins->op == IR_STORE_LOCAL) {
+            set_current(v, cut(fn, ins, v, ins->src1));
+        } else if (ins->value == A_PRE_INCREMENT || ins->value == A_PRE_DECREMENT) {
+            set_current(v, increment(fn, ins, v));
+            alias[ins->dst] = current[v];
+        } else if (ins->value != 0) {
+            alias[ins->dst] = value_of(fn, v);
+            set_current(v, increment(fn, ins, v));
+        } else {
+            alias[ins->dst] = value_of(fn, v);
+        }
+
+        ir_remove(ins);
+    }
+
+    // Fill in the operands of the phis of the successors for this edge
+    for (int i = 0; i < b->last->ntargets; i++) {
+        t_ir_block* s = b->last->targets[i];
+        int j;
+
+        for (j = 0; s->preds[j] != b; j++);
+
+        for (ins = s->first; ins != NULL && ins->op == IR_PHI; ins = ins->next) {
+            ins->args[j] = value_of(fn, ins->symbol->variable);
+        }
+    }
+
+    for (t_ir_block* c = b->dom_child; c != NULL; c = c->dom_sibling) {
+        rename_block(fn, c);
+    }
+
+    while (log_top > log_start) {
+        log_top--;
+        current[log_variable[log_top]] = log_value[log_top];
+    }
+}
+
+void ir_to_ssa(t_ir_function* fn) {
+    int writes = 0;
+
+    find_variables(fn);
+    ir_dominators(fn);
+    insert_phis(fn);
+
+    current = arena_alloc(&ir_arena, (nvariables + 1) * sizeof(int));
+    initial = arena_alloc(&ir_arena, (nvariables + 1) * sizeof(int));
+
+    for (int v = 0; v < nvariables; v++) {
+        current[v] = initial[v] = NOREG;
+    }
+
+    // Every phi and assignment logs one value
+    for (t_ir_block* b = fn->first; b != NULL; b = b->next) {
+        for (t_ir_instr* ins = b->first; ins != NULL; ins = ins->next) {
+            writes += ins->op == IR_PHI || variable_of(ins) >= 0;
+        }
+    }
+
+    log_variable = arena_alloc(&ir_arena, (writes + 1) * sizeof(int));
+    log_value = arena_alloc(&ir_arena, (writes + 1) * sizeof(int));
+    log_top = 0;
+
+    // Every variable access may add a constant, an addition and a cut
+    alias = arena_alloc(&ir_arena, (fn->nvregs + 4 * writes + nvariables + 1) * sizeof(int));
+    cut_to = arena_alloc(&ir_arena, (fn->nvregs + 4 * writes + nvariables + 1) * sizeof(int));
+
+    for (int r = 0; r < fn->nvregs + 4 * writes + nvariables; r++) {
+        alias[r] = NOREG;
+    }
+
+    find_cut_values(fn);
+    rename_block(fn, fn->first);
+}
+
+// Emit the parallel copy dst[i] = src[i], i < n, at pos in block b as a
+// sequence: a copy is emitted once no other copy still reads its
+// destination, a cycle is broken by saving one destination first.
+static void sequentialize(t_ir_function* fn, t_ir_block* b, t_ir_instr* pos, int* dst, int* src, int n) {
+    int emitted;
+
+    while (n > 0) {
+        do {
+            emitted = 0;
+
+            for (int i = 0; i < n; i++) {
+                int j;
+
+                for (j = 0; j < n && src[j] != dst[i]; j++);
+
+                if (j < n) {
+                    continue;
+                }
+
+                ir_insert(b, pos, ir_new_instr(IR_COPY, dst[i], src[i], NOREG));
+                dst[i] = dst[--n];
+                src[i] = src[n];
+                i--;
+                emitted = 1;
+            }
+        } while (emitted);
+
+        if (n > 0) {
+            int saved = fn->nvregs++;
+
+            ir_insert(b, pos, ir_new_instr(IR_COPY, saved, dst[0], NOREG));
+
+            for (int i = 0; i < n; i++) {
+                if (src[i] == dst[0]) {
+                    src[i] = saved;
+                }
+            }
+        }
+    }
+}
+
+// Return the block the copies for the edge from p to b go to. An edge
+// from a block with several successors is split by a new block.
+static t_ir_block* edge_block(t_ir_function* fn, t_ir_block* p, t_ir_block* b) {
+    t_ir_block* split;
+    t_ir_instr* jump;
+
+    if (p->last->op == IR_JUMP) {
+        return p;
+    }
+
+    split = ir_new_block();
+    jump = ir_new_instr(IR_JUMP, NOREG, NOREG, NOREG);
+    jump->targets = arena_alloc(&ir_arena, sizeof(t_ir_block*));
+    jump->targets[0] = b;
+    jump->ntargets = 1;
+    ir_insert(split, NULL, jump);
+
+    for (int i = 0; i < p->last->ntargets; i++) {
+        if (p->last->targets[i] == b) {
+            p->last->targets[i] = split;
+        }
+    }
+
+    split->next = p->next;
+    p->next = split;
+
+    if (fn->last == p) {
+        fn->last = split;
+    }
+
+    return split;
+}
+
+void ir_from_ssa(t_ir_function* fn) {
+    int *dst = NULL, *src = NULL;
+    int capacity = 0;
+
+    for (t_ir_block* b = fn->first; b != NULL; b = b->next) {
+        int phis = 0;
+        t_ir_instr* ins;
+
+        for (ins = b->first; ins != NULL && ins->op == IR_PHI; ins = ins->next) {
+            phis++;
+        }
+
+        if (phis == 0) {
+            continue;
+        }
+
+        if (phis > capacity) {
+            capacity = phis * 2;
+            dst = arena_alloc(&ir_arena, capacity * sizeof(int));
+            src = arena_alloc(&ir_arena, capacity * sizeof(int));
+        }
+
+        for (int j = 0; j < b->npreds; j++) {
+            t_ir_block* e = edge_block(fn, b->preds[j], b);
+            int n = 0;
+
+            for (ins = b->first; ins != NULL && ins->op == IR_PHI; ins = ins->next) {
+                if (ins->dst != ins->args[j]) {
+                    dst[n] = ins->dst;
+                    src[n++] = ins->args[j];
+                }
+            }
+
+            sequentialize(fn, e, e->last, dst, src, n);
+        }
+
+        while (b->first != NULL && b->first->op == IR_PHI) {
+            ir_remove(b->first);
+        }
+    }
+
+    fn->nblocks = 0;
+
+    for (t_ir_block* b = fn->first; b != NULL; b = b->next) {
+        b->id = fn->nblocks++;
+    }
+
+    ir_build_cfg(fn);
+}
@@ -0,0 +1,68 @@
+#include <string.h>
+
+#include "../../include/arena.h"
+
+// Keep every allocation aligned for any type
+#define ARENA_ALIGN(n) (((n) + 15) & ~(size_t)15)
+
+static t_arena_block* new_block(t_arena* a, size_t size) {
+    t_arena_block* b;
+
+    if (size < ARENA_BLOCK_SIZE) {
+        size = ARENA_BLOCK_SIZE;
+    }
+
+    if ((b = malloc(sizeof(t_arena_block) + size)) == NULL) {
+        report_error("new_block(): malloc() failed.\n");
+    }
+
+    b->next = NULL;
+    b->size = size;
+    b->used = 0;
+    a->reserved += size;
+    return b;
+}
+
+void* arena_alloc(t_arena* a, size_t size) {
+    t_arena_block* b = a->current;
+    void* p;
+
+    size = ARENA_ALIGN(size);
+
+    if (b == NULL) {
+        b = a->first = a->current = new_block(a, size);
+    }
+
+    // Move on to the next kept block, or append a new one
+    while (b->used + size > b->size) {
+        if (b->next == NULL) {
+            b->next = new_block(a, size);
+        }
+
+        b = a->current = b->next;
+        b->used = 0;
+    }
+
+    p = b->data + b->used;
+    b->used += size;
+
+    a->allocations++;
+    a->allocated += size;
+    a->in_use += size;
+
+    memset(p, 0, size);
+    return p;
+}
+
+void arena_reset(t_arena* a) {
+    if (a->in_use > a->peak) {
+        a->peak = a->in_use;
+    }
+
+    a->in_use = 0;
+    a->current = a->first;
+
+    if (a->first != NULL) {
+        a->first->used = 0;
+    }
+}
@@ -4,40 +4,24 @@
 static int isCompOperator(int tokenType);
 static int type_compatible(int* left, int* right, int onlyright);
 
-t_astnode* make_astnode(int op, int type, t_astnode* left, t_astnode* right, t_symbol_entry* symbol, int value) {
-    t_astnode *n;
-
-    n = (t_astnode *)malloc(sizeof(t_astnode));
-
-    if (n == NULL) {
-        fprintf(stderr, "malloc() failed in make_astnode(...)\n");
-        exit(1);
-    }
+// Nodes of the function that is parsed, reset after it was generated
+t_arena ast_arena;
 
-    n->op = op;
-    n->left = left;
-    n->right = right;
-    n->value = value;
-    n->symbol = symbol;
-    n->type = type;
-    return n;
+t_astnode* make_astnode(int op, int type, t_astnode* left, t_astnode* right, t_symbol_entry* symbol, int value) {
+    return make_ternary_astnode(op, type, left, NULL, right, symbol, value);
 }
 
 t_astnode* make_ternary_astnode(int op, int type, t_astnode* left, t_astnode* middle, t_astnode* right, t_symbol_entry* symbol, int value) {
     t_astnode *n;
 
-    n = (t_astnode *)malloc(sizeof(t_astnode));
-
-    if (n == NULL) {
-        fprintf(stderr, "malloc() failed in make_astnode(...)\n");
-        exit(1);
-    }
+    n = (t_astnode *)arena_alloc(&ast_arena, sizeof(t_astnode));
 
     n->op = op;
     n->left = left;
     n->middle = middle;
     n->right = right;
     n->value = value;
+    n->symbol = symbol;
     n->type = type;
     return n;
 }
@@ -50,6 +34,48 @@ t_astnode* make_unary_ast_node(int op, int type, t_astnode *left, t_symbol_entry
     return make_astnode(op, type, left, NULL, symbol, value);
 }
 
+int label_ast(t_astnode* n) {
+    int left, middle, right;
+
+    if (n == NULL) {
+        return 0;
+    }
+
+    left = label_ast(n->left);
+    middle = label_ast(n->middle);
+    right = label_ast(n->right);
+
+    if (left && right && n->op != A_GLUE) {
+        // One register holds the result of the operand evaluated first
+        n->need = (left == right) ? left + 1 : (left > right ? left : right);
+    } else {
+        n->need = 1;
+        n->need = left > n->need ? left : n->need;
+        n->need = middle > n->need ? middle : n->need;
+        n->need = right > n->need ? right : n->need;
+    }
+
+    n->side_effects = (n->left && n->left->side_effects)
+                    || (n->middle && n->middle->side_effects)
+                    || (n->right && n->right->side_effects);
+
+    switch (n->op) {
+        case A_ADD: case A_SUBTRACT: case A_MULTIPLY: case A_DIVIDE: case A_MOD:
+        case A_EQUALS: case A_NOT_EQUAL: case A_LESS_THAN: case A_GREATER_THAN:
+        case A_LESS_EQUAL: case A_GREATER_EQUAL:
+        case A_INTLIT: case A_IDENTIFIER: case A_WIDEN: case A_SCALE:
+        case A_ADDR: case A_DEREFERENCE: case A_STRLIT:
+        case A_LSHIFT: case A_RSHIFT: case A_OR: case A_AND: case A_XOR:
+        case A_LOGIC_NOT: case A_LOGIC_AND: case A_LOGIC_OR: case A_NEGATE: case A_INVERT:
+            break;
+        default:
+            n->side_effects = 1;
+            break;
+    }
+
+    return n->need;
+}
+
 int arithop(int tok) {
     switch (tok) {
         case T_PLUS:
@@ -60,6 +86,8 @@ int arithop(int tok) {
             return A_MULTIPLY;
         case T_SLASH:
             return A_DIVIDE;
+        case T_PERCENT:
+            return A_MOD;
         case T_EQUALS:
             return A_EQUALS;
         case T_NOT_EQUAL:
@@ -88,6 +116,10 @@ int arithop(int tok) {
             return A_AND;
         case T_XOR:
             return A_XOR;
+        case T_LOGIC_AND:
+            return A_LOGIC_AND;
+        case T_LOGIC_OR:
+            return A_LOGIC_OR;
     default:
         fprintf(stderr, "Unknown token on line %d\n", line);
         exit(1);
@@ -0,0 +1,75 @@
+#include <string.h>
+
+#include "../../include/compact_ast.h"
+
+t_compact_ast compact_ast;
+
+int compact_ast_layout;
+
+static void *grow(void* column, size_t size, t_ast_index capacity) {
+    if ((column = realloc(column, size * capacity)) == NULL) {
+        report_error("compact_ast_build(): realloc() failed.\n");
+    }
+
+    return column;
+}
+
+static t_ast_index add_node(t_astnode* n) {
+    t_compact_ast* c = &compact_ast;
+    t_ast_index i;
+
+    if (c->count >= c->capacity) {
+        c->capacity = c->capacity ? 2 * c->capacity : 1024;
+        c->op = grow(c->op, sizeof(unsigned short), c->capacity);
+        c->rvalue = grow(c->rvalue, sizeof(unsigned char), c->capacity);
+        c->type = grow(c->type, sizeof(int), c->capacity);
+        c->value = grow(c->value, sizeof(int), c->capacity);
+        c->need = grow(c->need, sizeof(unsigned char), c->capacity);
+        c->side_effects = grow(c->side_effects, sizeof(unsigned char), c->capacity);
+        c->left = grow(c->left, sizeof(t_ast_index), c->capacity);
+        c->middle = grow(c->middle, sizeof(t_ast_index), c->capacity);
+        c->right = grow(c->right, sizeof(t_ast_index), c->capacity);
+        c->reference = grow(c->reference, sizeof(t_ast_reference), c->capacity);
+    }
+
+    i = c->count++;
+    c->op[i] = n->op;
+    c->rvalue[i] = n->rvalue;
+    c->type[i] = n->type;
+    c->value[i] = n->value;
+    c->need[i] = n->need < 255 ? n->need : 255;
+    c->side_effects[i] = n->side_effects;
+    if (n->op == A_SWITCH) {
+        c->reference[i].cases = n->cases;
+    } else {
+        c->reference[i].symbol = n->symbol;
+    }
+    return i;
+}
+
+// Append the tree in pre-order, a node is followed by its left subtree
+static t_ast_index build(t_astnode* n) {
+    t_ast_index i, child;
+
+    if (n == NULL) {
+        return 0;
+    }
+
+    i = add_node(n);
+
+    // The columns may move while the children are added
+    child = build(n->left);
+    compact_ast.left[i] = child;
+    child = build(n->middle);
+    compact_ast.middle[i] = child;
+    child = build(n->right);
+    compact_ast.right[i] = child;
+
+    return i;
+}
+
+t_ast_index compact_ast_build(t_astnode* root) {
+    // Node 0 is never used, it marks missing children
+    compact_ast.count = 1;
+    return build(root);
+}
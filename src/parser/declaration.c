@@ -1,31 +1,35 @@
 #include "../../include/ast.h"
+#include "../../include/interpret.h"
 
+int parse_only;
 
-// Given a type, check if the current token is a literal of that type.
-// If it is an integer literal, return the value.
+// Given a type, parse an initial value of that type.
+// If it is a constant expression, return the value.
 // if it's a string literal, return the label number of the string.
 static int parse_literal(int type) {
+    int value;
+
     if ((type == pointer_to(TYPE_CHAR)) && (token.token == T_STRINGLIT)) {
-        return generate_global_string(text);
+        value = generate_global_string(interned_text);
+        scan(&token);
+        return value;
     }
 
-    if (token.token == T_INTLIT) {
-        switch (type) {
-            case TYPE_CHAR:
-                if (token.value < 0 || token.value > 255) {
-                    report_error("parse_literal(): Value too big for char type.\n");
-                }
-            case TYPE_INT:
-            case TYPE_LONG:
-                break;
-            default:
-                report_error("parse_literal(): Type mismatch.\n");
-        }
-    } else {
-        report_error("parse_literal(): Expecingt an integer literal value.\n");
+    value = constant_expression();
+
+    switch (type) {
+        case TYPE_CHAR:
+            if (value < 0 || value > 255) {
+                report_error("parse_literal(): Value too big for char type.\n");
+            }
+        case TYPE_INT:
+        case TYPE_LONG:
+            break;
+        default:
+            report_error("parse_literal(): Type mismatch.\n");
     }
 
-    return token.value;
+    return value;
 }
 
 static int parse_stars(int type) {
@@ -51,14 +55,12 @@ static t_symbol_entry* array_declaration(
     t_symbol_entry* symbol = NULL;
     scan(&token);
 
-    if (token.token == T_INTLIT) {
+    if (token.token != T_RIGHT_BRACKET) {
+        number_elements = constant_expression();
 
-        if (token.value < 0) {
+        if (number_elements < 0) {
             report_error("array_declaration(): Size of array less than 0.\n");
         }
-
-        number_elements = token.value;
-        scan(&token);
     }
 
     match(T_RIGHT_BRACKET, "array_declaration(): Expect ']'");
@@ -88,12 +90,12 @@ static t_symbol_entry* array_declaration(
             }
 
             if (number_elements <= 0 && i == max_elements) {
+                max_elements *= 2;
                 init_list = realloc(init_list, max_elements * sizeof(int));
             }
 
             init_list[i] = parse_literal(type);
             i++;
-            scan(&token);
 
             if (token.token == T_RIGHT_BRACE) {
                 scan(&token);
@@ -104,8 +106,12 @@ static t_symbol_entry* array_declaration(
         }
 
 
+        // An array without a size has as many elements as initial values,
+        // the elements past the initial values are zero
+        if (number_elements <= 0) {number_elements = i;}
+
         int j;
-        for (j = i; j < symbol->num_elements; j++) {init_list[j] = 0;}
+        for (j = i; j < number_elements; j++) {init_list[j] = 0;}
 
         symbol->initializer_list = init_list;
     }
@@ -154,7 +160,6 @@ static t_symbol_entry* scalar_declaration(
         if (class == C_GLOBAL) {
             symbol->initializer_list = (int*)malloc(sizeof(int));
             symbol->initializer_list[0] = parse_literal(type);
-            scan(&token);
         }
     }
 
@@ -180,7 +185,7 @@ static t_symbol_entry* symbol_declaration(
         ) {
 
     t_symbol_entry* symbol = NULL;
-    char* varname = strdup(text);
+    char* varname = interned_text;
 
     int stype = S_VARIABLE;
 
@@ -304,7 +309,7 @@ static int parameter_declaration_list(
     return parameter_count;
 }
 
-static int type_of_typedef(char* name, t_symbol_entry* ctype) {
+static int type_of_typedef(char* name, t_symbol_entry** ctype) {
     t_symbol_entry* t;
 
     if ((t = find_typedef_symbol(name)) == NULL) {
@@ -312,7 +317,7 @@ static int type_of_typedef(char* name, t_symbol_entry* ctype) {
     }
 
     scan(&token);
-    ctype = t->ctype;
+    *ctype = t->ctype;
     return t->type;
 }
 
@@ -325,14 +330,14 @@ static int typedef_declaration(t_symbol_entry** ctype) {
 
     type = parse_type(ctype, &class);
 
-    if (find_typedef_symbol(text) != NULL) {
-        report_error("typedef_declaration(): Redeclaration of typedef %s.\n", text);
+    if (find_typedef_symbol(interned_text) != NULL) {
+        report_error("typedef_declaration(): Redeclaration of typedef %s.\n", interned_text);
     }
 
     type = parse_stars(type);
 
     scan(&token);
-    add_typedef_symbol(text, type, *ctype);
+    add_typedef_symbol(interned_text, type, *ctype);
     return type;
 }
 
@@ -340,20 +345,20 @@ static void enum_declaration() {
 
     t_symbol_entry* enum_entry = NULL;
     char* name = NULL;
-    int int_value;
+    int int_value = -1;
 
     // Scan 'enum' keyword
     scan(&token);
 
     if (token.token == T_IDENTIFIER) {
-        enum_entry = find_enum_symbol(text);
-        name = strdup(text);
+        enum_entry = find_enum_symbol(interned_text);
+        name = interned_text;
         scan(&token);
     }
 
     if (token.token != T_LEFT_BRACE) {
         if (enum_entry == NULL) {
-            report_error("enum_declaration(): Expected enum type before %s\n", text);
+            report_error("enum_declaration(): Expected enum type before %s\n", interned_text);
         }
 
         return;
@@ -372,7 +377,7 @@ static void enum_declaration() {
     while (1) {
         match(T_IDENTIFIER, "Expect identifier inside enum declaration.\n");
 
-        name = strdup(text);
+        name = interned_text;
 
         enum_entry = find_enum_value(name);
         if (enum_entry != NULL) {
@@ -381,12 +386,7 @@ static void enum_declaration() {
 
         if (token.token == T_ASSIGNMENT) {
             scan(&token);
-            if (token.token != T_INTLIT) {
-                report_error("enum_declaration(): Only int literals allowed for enum initialization.\n");
-            }
-
-            int_value = token.value;
-            scan(&token);
+            int_value = constant_expression();
         } else {
             int_value++;
         }
@@ -415,9 +415,9 @@ static t_symbol_entry* composite_declaration(int type) {
 
     if (token.token == T_IDENTIFIER) {
         if (type == TYPE_STRUCT) {
-            ctype = find_struct_symbol(text);
+            ctype = find_struct_symbol(interned_text);
         } else {
-            ctype = find_union_symbol(text);
+            ctype = find_union_symbol(interned_text);
         }
 
         scan(&token);
@@ -438,9 +438,9 @@ static t_symbol_entry* composite_declaration(int type) {
     }
 
     if (type == TYPE_STRUCT) {
-        ctype = add_struct_symbol(text);
+        ctype = add_struct_symbol(interned_text);
     } else {
-        ctype = add_union_symbol(text);
+        ctype = add_union_symbol(interned_text);
     }
 
     scan(&token);
@@ -469,7 +469,7 @@ static t_symbol_entry* composite_declaration(int type) {
     }
 
     ctype->member = member_symbols->head;
-    member_symbols->head = member_symbols->tail = NULL;
+    clear_symbol_list(member_symbols);
 
     m = ctype->member;
     m->offset = 0;
@@ -485,6 +485,7 @@ static t_symbol_entry* composite_declaration(int type) {
     }
 
     ctype->size = offset;
+    index_members(ctype);
     return ctype;
 }
 
@@ -559,55 +560,47 @@ t_symbol_entry * function_declaration(
 
     tree = make_unary_ast_node(A_FUNCTION, type, tree, old_function_symbol, endlabel);
 
-    print_ast(tree, 1);
-
-    generate_ast(tree, NOLABEL, NOLABEL, NOLABEL, 0);
-    clear_local_symbol_table();
-
-    return old_function_symbol;
-}
-
-int var_declaration_list(t_symbol_entry* function_symbol, int class, int separator, int end_token) {
-    int type, p_count;
-    p_count = 0;
+    if (parse_only) {
+        // Only the parser is measured, the tree is dropped
+    } else {
+        t_ir_function* fn;
 
-    t_symbol_entry* function_prototype = NULL;
-    t_symbol_entry* ctype;
+        tree = fold_ast(tree);
+        label_ast(tree);
 
-    if (function_symbol != NULL) {
-        function_prototype = function_symbol->member;
-    }
+        if (compact_ast_layout) {
+            t_ast_index root = compact_ast_build(tree);
 
-    while (token.token != end_token) {
-        type = parse_type(&ctype, &class);
-        match(T_IDENTIFIER, "Expected identifier");
-
-        if (function_prototype != NULL) {
-            if (type != function_prototype->type) {
-                report_error("Type mismatch");
+            if (print_syntax_tree) {
+                print_compact_ast(root, 1);
             }
 
-            function_prototype = function_prototype->next;
+            fn = compact_lower_function(root);
         } else {
-            var_declaration(type, ctype, class);
+            if (print_syntax_tree) {
+                print_ast(tree, 1);
+            }
+
+            fn = lower_function(tree);
         }
 
-        p_count++;
+        ir_to_ssa(fn);
+        ir_propagate(fn);
 
-        if (token.token != separator && token.token != end_token) {
-            report_error("var_declaration_list(): Unexpected token in parameter list.\n");
+        if (print_ir) {
+            ir_dump(fn, stdout);
         }
 
-        if (token.token == separator) {
-            scan(&token);
-        }
+        ir_from_ssa(fn);
+        generate_ir(fn);
     }
+    clear_local_symbol_table();
 
-    if (function_symbol != NULL && p_count != function_symbol->params) {
-        report_error("parameter_declaration(): Parameter mismatch between function declaration and definition");
-    }
+    // The tree and the IR are dead once the function is emitted
+    arena_reset(&ast_arena);
+    arena_reset(&ir_arena);
 
-    return p_count;
+    return old_function_symbol;
 }
 
 void global_declarations(void) {
@@ -621,64 +614,26 @@ void global_declarations(void) {
     }
 }
 
-t_symbol_entry* var_declaration(int type, t_symbol_entry* ctype, int class) {
-
-    t_symbol_entry* symbol = NULL;
-
-    switch (class) {
-        case C_GLOBAL:
-            if (find_global_symbol(text) != NULL) {
-                report_error("var_declaration(): Already defined global variable %s.\n", text);
-            }
-            break;
-        case C_LOCAL:
-        case C_PARAMETER:
-            if (find_local_symbol(text) != NULL) {
-                report_error("var_declaration(): Already defined local variable %s.\n", text);
-            }
-            break;
-        case C_MEMBER:
-            if (find_member_symbol(text) != NULL) {
-                report_error("var_declaration(): Already defined struct member %s.\n", text);
-            }
-            break;
-    }
-
-    if (token.token == T_LEFT_BRACKET) {
-    scan(&token);
-
-    if (token.token == T_INTLIT) {
-        switch (class) {
-            case C_GLOBAL:
-            case C_EXTERN:
-                symbol = add_global_symbol(text, pointer_to(type), ctype, S_ARRAY, class, token.value, 0);
-                break;
-            case C_LOCAL:
-            case C_PARAMETER:
-                report_error("var_declaration(): Local array definition not implemented.\n");
-        }
-    }
-
-    scan(&token);
-    match(T_RIGHT_BRACKET, "]");
-    } else {
-        switch (class) {
-            case C_GLOBAL:
-                symbol = add_global_symbol(text, type, ctype, S_VARIABLE, class, 1, 0);
-                break;
-            case C_LOCAL:
-                symbol = add_local_symbol(text, type, ctype, S_VARIABLE, 1);
-                break;
-            case C_PARAMETER:
-                symbol = add_parameter_symbol(text, type, ctype, S_VARIABLE);
-                break;
-            case C_MEMBER:
-                symbol = add_member_symbol(text, type, ctype, S_VARIABLE, 1);
-                break;
-        }
+int is_type_name(void) {
+    switch (token.token) {
+        case T_VOID:
+        case T_CHAR:
+        case T_INT:
+        case T_LONG:
+        case T_STRUCT:
+        case T_UNION:
+        case T_ENUM:
+            return 1;
+        case T_IDENTIFIER:
+            return find_typedef_symbol(interned_text) != NULL;
+        default:
+            return 0;
     }
+}
 
-    return symbol;
+int parse_type_name(t_symbol_entry** ctype) {
+    int class = C_LOCAL;
+    return parse_stars(parse_type(ctype, &class));
 }
 
 int parse_type(t_symbol_entry** ctype, int *class) {
@@ -742,7 +697,7 @@ int parse_type(t_symbol_entry** ctype, int *class) {
             }
             break;
         case T_IDENTIFIER:
-            type = type_of_typedef(text, *ctype);
+            type = type_of_typedef(interned_text, ctype);
             break;
         default:
 
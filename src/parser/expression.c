@@ -1,4 +1,5 @@
 #include "../../include/ast.h"
+#include "../../include/interpret.h"
 
 // Expressions
 // <prefix> ::= <primary>
@@ -7,6 +8,8 @@
 //            | '-' <prefix>
 //            | '++' <prefix>
 //            | '--' <prefix>
+//            | 'sizeof' <prefix>
+//            | 'sizeof' '(' <type> ')'
 static t_astnode* prefix(void);
 
 // <postfix> ::= <primary>
@@ -17,42 +20,21 @@ static t_astnode* prefix(void);
 static t_astnode* postfix(void);
 
 
-// <shift> ::= <comparison>
-//                      | <comparison> ('<<' | '>>') <shift>
-static t_astnode* shift_expression(void);
-
-// <comparison> ::= <term>
-//                | <term> ('<' | '<=' | '>' | '>=') <comparison>
-static t_astnode* comparison_expression(void);
-
 // <array_access> ::= '[' <expression> ']'
 static t_astnode* array_access(void);
 
-static t_astnode* assignment_expression(void);
-
-// <equals> ::= <shift>
-//            | <shift> ('==' | '!=') <equals>
-static t_astnode* equals_expression(void);
-
-// <term> ::= <factor>
-//          | <factor> ('+' | '-') <term>
-static t_astnode* term_expression(void);
-
-// <factor> ::= <primary>
-//            | <primary> ('*' | '/') <factor>
-static t_astnode* factor_expression(void);
+// <binary> ::= <prefix>
+//            | <binary> <operator> <binary>
+// Operators and their binding power are listed in binary_precedence.
+static t_astnode* precedence_expression(int min_precedence);
 
 // <primary> ::= <number> | <string>
+//             | '(' <expression> ')'
+//             | '(' <type> ')' <prefix>
 static t_astnode* primary(void);
 
-// '|'
-static t_astnode* or_expression(void);
-
-// '&'
-static t_astnode* and_expression(void);
-
-// '^'
-static t_astnode* xor_expression(void);
+static t_astnode* cast(void);
+static int sizeof_operand(void);
 
 static void convert_types(t_astnode** left, t_astnode** right, int op);
 
@@ -62,8 +44,8 @@ static t_astnode* member_access(int indirect) {
     t_symbol_entry* composit;
     t_symbol_entry* member;
 
-    if ((composit = find_symbol(text)) == NULL) {
-        report_error("member_access(): Error, accessing member of non-existing variable %s.\n", text);
+    if ((composit = find_symbol(interned_text)) == NULL) {
+        report_error("member_access(): Error, accessing member of non-existing variable %s.\n", interned_text);
     }
 
     // If we try to access a member of a direct struct with '->' we report an error
@@ -95,16 +77,10 @@ static t_astnode* member_access(int indirect) {
         match(T_IDENTIFIER, "Expected identifier after '.'.\n");
     }
 
-    t_symbol_entry* m;
-
-    for (m = ctype->member; m != NULL; m = m->next) {
-        if (!strcmp(m->name, text)) {
-            break;
-        }
-    }
+    t_symbol_entry* m = find_member(ctype, interned_text);
 
     if (m == NULL) {
-        report_error("member_access(): No member %s in struct %s\n", text, composit->name);
+        report_error("member_access(): No member %s in struct %s\n", interned_text, composit->name);
     }
 
     // Get offset of struct member
@@ -117,98 +93,103 @@ static t_astnode* member_access(int indirect) {
 }
 
 
+// Binding power of the binary operators, 0 for tokens that end an
+// expression. '==' and '!=' bind like the relational operators, which
+// is tighter than the shifts.
+enum {
+    P_NONE,
+    P_ASSIGNMENT,       // '=', right associative
+    P_LOGIC_OR,         // '||'
+    P_LOGIC_AND,        // '&&'
+    P_OR,               // '|'
+    P_XOR,              // '^'
+    P_AND,              // '&'
+    P_SHIFT,            // '<<' '>>'
+    P_COMPARISON,       // '==' '!=' '<' '<=' '>' '>='
+    P_TERM,             // '+' '-'
+    P_FACTOR            // '*' '/' '%'
+};
+
+static const unsigned char binary_precedence[T_INCREMENT] = {
+    [T_ASSIGNMENT] = P_ASSIGNMENT,
+    [T_LOGIC_OR] = P_LOGIC_OR,
+    [T_LOGIC_AND] = P_LOGIC_AND,
+    [T_OR] = P_OR,
+    [T_XOR] = P_XOR,
+    [T_AMPER] = P_AND,
+    [T_LSHIFT] = P_SHIFT,
+    [T_RSHIFT] = P_SHIFT,
+    [T_EQUALS] = P_COMPARISON,
+    [T_NOT_EQUAL] = P_COMPARISON,
+    [T_LESS_THAN] = P_COMPARISON,
+    [T_LESS_EQUAL] = P_COMPARISON,
+    [T_GREATER_THAN] = P_COMPARISON,
+    [T_GREATER_EQUAL] = P_COMPARISON,
+    [T_PLUS] = P_TERM,
+    [T_MINUS] = P_TERM,
+    [T_STAR] = P_FACTOR,
+    [T_SLASH] = P_FACTOR,
+    [T_PERCENT] = P_FACTOR
+};
+
+#define PRECEDENCE(t) ((t) < T_INCREMENT ? binary_precedence[(t)] : P_NONE)
+
 t_astnode* binary_expression(void) {
-    t_astnode* expr = assignment_expression();
-    return expr;
+    return precedence_expression(P_ASSIGNMENT);
 }
 
-static t_astnode* term_expression(void) {
-    t_astnode* left, *right;
-    int type;
-
-    left = factor_expression();
+int constant_expression(void) {
+    t_astnode* tree = fold_ast(precedence_expression(P_LOGIC_OR));
 
-    type = token.token;
-
-    if (type == T_SEMICOLON) {
-        left->rvalue = 1;
-        return left;
-    }
-
-    while (token.token == T_PLUS || token.token == T_MINUS) {
-        scan(&token);
-
-        right = factor_expression();
-        left->rvalue = right->rvalue = 1;
-        convert_types(&left, &right, type);
-
-        left = make_astnode(arithop(type), left->type, left, right, NULL, 0);
-
-        type = token.token;
-        if (type == T_SEMICOLON) {
-            return left;
-        }
+    if (tree->op != A_INTLIT) {
+        report_error("constant_expression(): Expression on line %d is not constant.\n", line);
     }
 
-    return left;
+    return tree->value;
 }
 
-static t_astnode* shift_expression(void) {
+// Parse a prefix expression followed by all binary operators that bind
+// at least as tight as min_precedence.
+static t_astnode* precedence_expression(int min_precedence) {
     t_astnode* left, *right;
-    int type;
-
-    left = comparison_expression();
+    int type, precedence;
 
-    type = token.token;
+    left = prefix();
 
-    if (type == T_SEMICOLON) {
+    if (token.token == T_SEMICOLON) {
         left->rvalue = 1;
         return left;
     }
 
-    while (token.token == T_LSHIFT || token.token == T_RSHIFT) {
+    while ((precedence = PRECEDENCE(token.token)) >= min_precedence) {
+        type = token.token;
         scan(&token);
 
-        right = comparison_expression();
-        left->rvalue = right->rvalue = 1;
-        convert_types(&left, &right, type);
-
-        left = make_astnode(arithop(type), left->type, left, right, NULL, 0);
+        if (type == T_ASSIGNMENT) {
+            right = precedence_expression(precedence);
+            // Here, only right (assignment target) is rvalue
+            right->rvalue = 1;
+            modify_types(right, left->type, 0);
 
-        type = token.token;
-        if (type == T_SEMICOLON) {
-            return left;
+            // Pass arguments in different order to assure correct associativity
+            left = make_astnode(A_ASSIGN, left->type, right, left, NULL, 0);
+            continue;
         }
-    }
-
-    return left;
-}
-
-static t_astnode* factor_expression(void) {
-    t_astnode* left, *right;
-    int type;
-
-    left = prefix();
-
-    type = token.token;
 
-    if (type == T_SEMICOLON) {
-        left->rvalue = 1;
-        return left;
-    }
-
-    while ((type == T_STAR) || (type == T_SLASH)) {
-        scan(&token);
-        right = prefix();
+        right = precedence_expression(precedence + 1);
         left->rvalue = right->rvalue = 1;
-        convert_types(&left, &right, type);
-
-        left = make_astnode(arithop(type), left->type, left, right, NULL, 0);
 
-        type = token.token;
+        // The operands of '&&' and '||' are only compared with zero
+        if (type == T_LOGIC_AND || type == T_LOGIC_OR) {
+            left = make_astnode(arithop(type), TYPE_INT, left, right, NULL, 0);
+        } else {
+            convert_types(&left, &right, arithop(type));
+            left = make_astnode(arithop(type), left->type, left, right, NULL, 0);
+        }
 
-        if (type == T_EOF) {
-            break;
+        // An operation that ends the statement is always used as value
+        if (token.token == T_SEMICOLON) {
+            left->rvalue = 1;
         }
     }
 
@@ -221,7 +202,7 @@ static t_astnode* postfix(void) {
     t_symbol_entry* variable;
     t_symbol_entry* e_entry;
 
-    if ((e_entry = find_enum_value(text)) != NULL) {
+    if ((e_entry = find_enum_value(interned_text)) != NULL) {
         scan(&token);
         return make_ast_leaf(A_INTLIT, TYPE_INT, NULL, e_entry->size);
     }
@@ -244,8 +225,8 @@ static t_astnode* postfix(void) {
         return (member_access(1));
     }
 
-    if ((variable = find_symbol(text)) == NULL || variable->stype != S_VARIABLE) {
-        report_error("postfix(): Unknown variable %s\n", text);
+    if ((variable = find_symbol(interned_text)) == NULL || variable->stype != S_VARIABLE) {
+        report_error("postfix(): Unknown variable %s\n", interned_text);
     }
     
     switch (token.token) {
@@ -339,6 +320,11 @@ static t_astnode* prefix(void) {
             tree = make_unary_ast_node(A_DEREFERENCE, value_at(tree->type), tree, NULL, 0);
             break;
 
+        case T_SIZEOF:
+            scan(&token);
+            tree = make_ast_leaf(A_INTLIT, TYPE_INT, NULL, sizeof_operand());
+            break;
+
         default:
             tree = primary();
     }
@@ -346,201 +332,13 @@ static t_astnode* prefix(void) {
     return tree;
 }
 
-static t_astnode* equals_expression(void) {
-    t_astnode* left, *right;
-    int type;
-
-    left = shift_expression();
-
-    type = token.token;
-
-    if (type == T_SEMICOLON) {
-        left->rvalue = 1;
-        return left;
-    }
-
-    while (token.token == T_EQUALS || token.token == T_NOT_EQUAL) {
-        scan(&token);
-
-        right = shift_expression();
-        left->rvalue = right->rvalue = 1;
-        convert_types(&left, &right, type);
-
-        left = make_astnode(arithop(type), left->type, left, right, NULL, 0);
-
-        type = token.token;
-        if (type == T_SEMICOLON) {
-            return left;
-        }
-    }
-
-    return left;
-}
-
-static t_astnode* comparison_expression(void) {
-    t_astnode* left, *right;
-    int type;
-
-    left = term_expression();
-
-    type = token.token;
-
-    if (type == T_SEMICOLON) {
-        left->rvalue = 1;
-        return left;
-    }
-
-    while (token.token >= T_EQUALS && token.token <= T_GREATER_EQUAL) {
-        scan(&token);
-
-        right = term_expression();
-        // Change this in every expression
-        left->rvalue = right->rvalue = 1;
-        convert_types(&left, &right, type);
-        left = make_astnode(arithop(type), left->type, left, right, NULL, 0);
-
-        type = token.token;
-        if (type == T_SEMICOLON) {
-            return left;
-        }
-    }
-
-    return left;
-}
-
-
-static t_astnode* xor_expression(void) {
-    t_astnode* left, *right;
-    int type;
-
-    left = and_expression();
-    type = token.token;
-
-    if (type == T_SEMICOLON) {
-        left->rvalue = 1;
-        return left;
-    }
-
-    while (token.token == T_XOR) {
-        scan(&token);
-
-        right = and_expression();
-        left->rvalue = right->rvalue = 1;
-        convert_types(&left, &right, type);
-
-        left = make_astnode(arithop(type), left->type, left, right, NULL, 0);
-        type = token.token;
-        if (type == T_SEMICOLON) {
-            return left;
-        }
-
-    }
-
-    return left;
-}
-
-static t_astnode* and_expression(void) {
-    t_astnode* left, *right;
-    int type;
-
-    left = equals_expression();
-    type = token.token;
-
-    if (type == T_SEMICOLON) {
-        left->rvalue = 1;
-        return left;
-    }
-
-    while (token.token == T_AMPER) {
-        scan(&token);
-
-        right = equals_expression();
-        left->rvalue = right->rvalue = 1;
-        convert_types(&left, &right, type);
-
-        left = make_astnode(arithop(type), left->type, left, right, NULL, 0);
-        type = token.token;
-        if (type == T_SEMICOLON) {
-            return left;
-        }
-
-    }
-
-    return left;
-}
-
-
-static t_astnode* or_expression(void) {
-    t_astnode* left, *right;
-    int type;
-
-    left = xor_expression();
-    type = token.token;
-
-    if (type == T_SEMICOLON) {
-        left->rvalue = 1;
-        return left;
-    }
-
-    while (token.token == T_OR) {
-        scan(&token);
-
-        right = xor_expression();
-        left->rvalue = right->rvalue = 1;
-        convert_types(&left, &right, type);
-
-        left = make_astnode(arithop(type), left->type, left, right, NULL, 0);
-        type = token.token;
-        if (type == T_SEMICOLON) {
-            return left;
-        }
-
-    }
-
-    return left;
-}
-
-
-static t_astnode* assignment_expression(void) {
-    t_astnode* left, *right;
-    int type;
-
-    left = or_expression();
-
-    type = token.token;
-
-    if (type == T_SEMICOLON) {
-        left->rvalue = 1;
-        return left;
-    }
-
-    while (token.token == T_ASSIGNMENT) {
-        scan(&token);
-
-        right = assignment_expression();
-        // Here, only right (assignment target) is rvalue
-        right->rvalue = 1;
-        modify_types(right, left->type, 0);
-
-        // Pass arguments in different order to assure correct associativity
-        left = make_astnode(arithop(type), left->type, right, left, NULL, 0);
-
-        type = token.token;
-        if (type == T_SEMICOLON) {
-            return left;
-        }
-    }
-
-    return left;
-}
-
 static t_astnode* primary(void) {
     t_astnode* n;
     int id;
 
     switch (token.token) {
         case T_STRINGLIT:
-            id = generate_global_string(text);
+            id = generate_global_string(interned_text);
             n = make_ast_leaf(A_STRLIT, pointer_to(TYPE_CHAR), NULL, id);
             break;
         case T_INTLIT:
@@ -552,9 +350,14 @@ static t_astnode* primary(void) {
             }
             break;
         
-        // Grouping '(' expression ')'
+        // Grouping '(' expression ')' or a cast
         case T_LEFT_PAREN:
             scan(&token);
+
+            if (is_type_name()) {
+                return cast();
+            }
+
             n = binary_expression();
             match(T_RIGHT_PAREN, "Expected ')'");
             return n;
@@ -588,8 +391,8 @@ static t_astnode* array_access(void) {
     t_astnode* left, *right;
     t_symbol_entry* array;
 
-    if ((array = find_symbol(text)) == NULL || array->stype != S_ARRAY) {
-        report_error("array_access(): Undeclared array %s.\n", text);
+    if ((array = find_symbol(interned_text)) == NULL || array->stype != S_ARRAY) {
+        report_error("array_access(): Undeclared array %s.\n", interned_text);
     }
 
     left = make_ast_leaf(A_ADDR, array->type, array, 0);
@@ -620,8 +423,8 @@ t_astnode* function_calls(void) {
     t_symbol_entry* function_ptr;
 
     // Check if function name exists
-    if ((function_ptr = find_symbol(text)) == NULL || function_ptr->stype != S_FUNCTION) {
-        report_error("function_calls(): Undeclared function %s.\n", text);
+    if ((function_ptr = find_symbol(interned_text)) == NULL || function_ptr->stype != S_FUNCTION) {
+        report_error("function_calls(): Undeclared function %s.\n", interned_text);
     }
 
     match(T_LEFT_PAREN, "(");
@@ -655,4 +458,96 @@ t_astnode* expression_list(int end_token) {
     }
 
     return tree;
-}
\ No newline at end of file
+}
+
+// The '(' of the cast has been scanned. A constant is cut to the type,
+// other values keep theirs in the register, which is 64 bit wide, so
+// they cannot be cast to a smaller integer type.
+static t_astnode* cast(void) {
+    t_symbol_entry* ctype = NULL;
+    t_astnode* tree;
+    int type = parse_type_name(&ctype);
+    int size;
+
+    match(T_RIGHT_PAREN, "Expected ')' after type in cast");
+
+    tree = fold_ast(prefix());
+    tree->rvalue = 1;
+
+    if (type == TYPE_STRUCT || type == TYPE_UNION || tree->type == TYPE_STRUCT || tree->type == TYPE_UNION) {
+        report_error("cast(): Cannot cast to or from a struct or union.\n");
+    }
+
+    size = typesize(type, NULL);
+
+    if (tree->op == A_INTLIT) {
+        switch (size) {
+            case 1: tree->value &= 0xff; break;
+            case 4: tree->value = (int)tree->value; break;
+        }
+    } else if (inttype(type) && inttype(tree->type) && size < typesize(tree->type, NULL)) {
+        report_error("cast(): Only constants can be cast to a smaller type.\n");
+    } else if (inttype(type) && inttype(tree->type) && size > typesize(tree->type, NULL)) {
+        return make_unary_ast_node(A_WIDEN, type, tree, NULL, 0);
+    }
+
+    tree->type = type;
+    return tree;
+}
+
+// Return the size of the expression that follows, without evaluating
+// it. A struct must be named by a variable, an array name alone stands
+// for the whole array.
+static int size_of_expression(int parenthesized) {
+    t_symbol_entry* symbol;
+    t_astnode* tree;
+
+    if (token.token == T_IDENTIFIER && (symbol = find_symbol(interned_text)) != NULL && symbol->stype == S_ARRAY) {
+        scan(&token);
+
+        if (token.token != T_LEFT_BRACKET) {
+            return symbol->size;
+        }
+
+        tree = array_access();
+    } else {
+        tree = parenthesized ? binary_expression() : prefix();
+    }
+
+    if (tree->type == TYPE_STRUCT || tree->type == TYPE_UNION) {
+        if (tree->op != A_IDENTIFIER) {
+            report_error("sizeof: Size of a struct or union needs a variable.\n");
+        }
+
+        return typesize(tree->type, tree->symbol->ctype);
+    }
+
+    return typesize(tree->type, NULL);
+}
+
+// 'sizeof' has been scanned. Return the size in bytes of its operand.
+static int sizeof_operand(void) {
+    t_symbol_entry* ctype = NULL;
+    int type, size;
+
+    if (token.token != T_LEFT_PAREN) {
+        return size_of_expression(0);
+    }
+
+    scan(&token);
+
+    if (is_type_name()) {
+        type = parse_type_name(&ctype);
+
+        if ((type == TYPE_STRUCT || type == TYPE_UNION) && ctype == NULL) {
+            report_error("sizeof: Unknown struct or union.\n");
+        }
+
+        size = typesize(type, ctype);
+    } else {
+        size = size_of_expression(1);
+    }
+
+    match(T_RIGHT_PAREN, "Expected ')' after sizeof");
+    return size;
+}
@@ -1,5 +1,87 @@
 #include "../../include/ast.h"
 
+// Case labels of a switch being parsed, in source order, with an open
+// addressing hash set of their positions + 1 to find duplicates
+typedef struct case_set {
+    t_case_label* labels;
+    int count;
+    int capacity;
+    int* slots;
+    unsigned int mask;
+} t_case_set;
+
+static unsigned int case_slot(t_case_set* set, int value) {
+    unsigned int i = ((unsigned int)value * 0x9e3779b1u) & set->mask;
+
+    while (set->slots[i] != 0 && set->labels[set->slots[i] - 1].value != value) {
+        i = (i + 1) & set->mask;
+    }
+
+    return i;
+}
+
+// Add the value of the next case, return 0 if it is already there.
+static int add_case(t_case_set* set, int value) {
+    unsigned int i;
+
+    if ((set->count + 1) * 2 > (int)(set->mask + 1)) {
+        int* old = set->slots;
+        unsigned int old_size = set->slots ? set->mask + 1 : 0;
+
+        set->mask = old_size ? old_size * 2 - 1 : 63;
+
+        if ((set->slots = calloc(set->mask + 1, sizeof(int))) == NULL) {
+            report_error("add_case(): calloc() failed.\n");
+        }
+
+        for (unsigned int j = 0; j < old_size; j++) {
+            if (old[j] != 0) {
+                set->slots[case_slot(set, set->labels[old[j] - 1].value)] = old[j];
+            }
+        }
+
+        free(old);
+    }
+
+    if (set->slots[i = case_slot(set, value)] != 0) {
+        return 0;
+    }
+
+    if (set->count == set->capacity) {
+        set->capacity = set->capacity ? set->capacity * 2 : 32;
+
+        if ((set->labels = realloc(set->labels, set->capacity * sizeof(t_case_label))) == NULL) {
+            report_error("add_case(): realloc() failed.\n");
+        }
+    }
+
+    set->labels[set->count].value = value;
+    set->labels[set->count].position = set->count;
+    set->slots[i] = ++set->count;
+    return 1;
+}
+
+static int compare_case_labels(const void* a, const void* b) {
+    int x = ((const t_case_label*)a)->value;
+    int y = ((const t_case_label*)b)->value;
+    return (x > y) - (x < y);
+}
+
+// Move the case labels into a table sorted by value, for the code
+// generator to dispatch on.
+static t_case_table* sorted_cases(t_case_set* set) {
+    t_case_table* table = arena_alloc(&ast_arena, sizeof(t_case_table));
+
+    table->count = set->count;
+    table->labels = arena_alloc(&ast_arena, set->count * sizeof(t_case_label) + 1);
+    memcpy(table->labels, set->labels, set->count * sizeof(t_case_label));
+    qsort(table->labels, set->count, sizeof(t_case_label), compare_case_labels);
+
+    free(set->labels);
+    free(set->slots);
+    return table;
+}
+
 static t_astnode* switch_statement() {
 
     t_astnode* expr = NULL;
@@ -18,6 +100,8 @@ static t_astnode* switch_statement() {
     int default_declared = 0;
     int case_value = 0;
 
+    t_case_set cases = { NULL, 0, 0, NULL, 0 };
+
     // Scan 'switch'
     scan(&token);
     match(T_LEFT_PAREN, "switch_statement(): Expect '(' after 'switch'.\n");
@@ -59,21 +143,10 @@ static t_astnode* switch_statement() {
                     // Scan 'case'
                     scan(&token);
 
-                    left = binary_expression();
-
-                    if (left->op != A_INTLIT) {
-                        report_error("switch_statement(): Only integer type in case.\n");
-                    }
-
-                    case_value = left->value;
-
-                    t_astnode * c;
+                    case_value = constant_expression();
 
-                    // Check for existing case values
-                    for (c = case_tree; c != NULL; c = c->right) {
-                        if (c->value == case_value) {
-                            report_error("switch_statement(): Duplicate case in same switch statement.\n");
-                        }
+                    if (!add_case(&cases, case_value)) {
+                        report_error("switch_statement(): Duplicate case in same switch statement.\n");
                     }
                 }
 
@@ -99,6 +172,7 @@ static t_astnode* switch_statement() {
     switch_level--;
     node->value = case_count;
     node->right = case_tree;
+    node->cases = sorted_cases(&cases);
 
     match(T_RIGHT_BRACE, "Expect '}' after switch statement.\n");
     return node;
@@ -192,7 +266,7 @@ t_astnode* single_statement() {
             match(T_RIGHT_BRACE, "single_statement(): Expected '}'");
             return stmt;
         case T_IDENTIFIER:
-            if (find_typedef_symbol(text) == NULL) {
+            if (find_typedef_symbol(interned_text) == NULL) {
                stmt = binary_expression();
                match(T_SEMICOLON, "Expect semicolon");
                return stmt;
@@ -261,10 +335,6 @@ t_astnode* if_statement(void) {
 
     condAST = binary_expression();
 
-    if (condAST->op < A_EQUALS || condAST->op > A_GREATER_EQUAL) {
-        fprintf(stderr, "Bad comparison operator.\n");
-    }
-
     match(T_RIGHT_PAREN, ")");
 
     trueAST = single_statement();
@@ -288,10 +358,6 @@ t_astnode* while_statement(void) {
 
     condAST = binary_expression();
 
-    if (condAST->op < A_EQUALS || condAST->op > A_GREATER_EQUAL) {
-        fprintf(stderr, "Bad comparison operator\n");
-    }
-
     match(T_RIGHT_PAREN, ")");
 
 
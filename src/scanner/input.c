@@ -0,0 +1,49 @@
+#include <errno.h>
+#include <string.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+#include "../../include/input.h"
+
+t_input_buffer input;
+
+int input_map_file(char* filename, t_input_buffer* buffer) {
+    struct stat st;
+    char* start;
+    int fd;
+
+    if ((fd = open(filename, O_RDONLY)) < 0) {
+        return 0;
+    }
+
+    if (fstat(fd, &st) < 0) {
+        close(fd);
+        return 0;
+    }
+
+    buffer->capacity = 0;
+
+    // mmap() refuses empty files, an empty buffer is just as good
+    if (st.st_size == 0) {
+        close(fd);
+        buffer->start = buffer->pos = buffer->end = NULL;
+        buffer->mapped = 0;
+        return 1;
+    }
+
+    start = mmap(NULL, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+    close(fd);
+
+    if (start == MAP_FAILED) {
+        fprintf(stderr, "Unable to map %s: %s\n", filename, strerror(errno));
+        exit(1);
+    }
+
+    madvise(start, st.st_size, MADV_SEQUENTIAL);
+    buffer->start = buffer->pos = start;
+    buffer->end = start + st.st_size;
+    buffer->mapped = 1;
+    return 1;
+}
@@ -0,0 +1,116 @@
+#include <string.h>
+
+#include "../../include/intern.h"
+
+t_intern_pool intern_pool;
+
+static unsigned int hash_string(char* s, int length) {
+    unsigned int h = 2166136261u;
+
+    for (int i = 0; i < length; i++) {
+        h = (h ^ (unsigned char)s[i]) * 16777619u;
+    }
+
+    return h;
+}
+
+static void* intern_alloc(size_t size) {
+    void* p;
+
+    if ((p = calloc(1, size)) == NULL) {
+        fprintf(stderr, "Out of memory for interned strings\n");
+        exit(1);
+    }
+
+    return p;
+}
+
+// Copy length characters to the current block, long strings get a
+// block of their own
+static char* store(char* s, int length) {
+    char* copy;
+
+    if (length + 1 > INTERN_BLOCK_SIZE / 4) {
+        copy = intern_alloc(length + 1);
+    } else {
+        if ((size_t)length + 1 > intern_pool.block_left) {
+            intern_pool.block = intern_alloc(INTERN_BLOCK_SIZE);
+            intern_pool.block_left = INTERN_BLOCK_SIZE;
+        }
+
+        copy = intern_pool.block;
+        intern_pool.block += length + 1;
+        intern_pool.block_left -= length + 1;
+    }
+
+    memcpy(copy, s, length);
+    copy[length] = '\0';
+    intern_pool.interned_bytes += length + 1;
+    return copy;
+}
+
+static void grow(void) {
+    t_intern_entry* old = intern_pool.entries;
+    unsigned int old_capacity = intern_pool.capacity;
+    unsigned int mask;
+
+    intern_pool.capacity = old_capacity ? old_capacity * 2 : INTERN_TABLE_SIZE;
+    intern_pool.entries = intern_alloc(intern_pool.capacity * sizeof(t_intern_entry));
+    mask = intern_pool.capacity - 1;
+
+    for (unsigned int i = 0; i < old_capacity; i++) {
+        unsigned int j;
+
+        if (old[i].string == NULL) {
+            continue;
+        }
+
+        for (j = old[i].hash & mask; intern_pool.entries[j].string != NULL; j = (j + 1) & mask);
+        intern_pool.entries[j] = old[i];
+    }
+
+    free(old);
+}
+
+char* intern(char* s, int length) {
+    t_intern_entry* e;
+    unsigned int hash, mask;
+
+    intern_pool.requests++;
+    intern_pool.requested_bytes += length + 1;
+
+    if ((intern_pool.count + 1) * 2 > intern_pool.capacity) {
+        grow();
+    }
+
+    hash = hash_string(s, length);
+    mask = intern_pool.capacity - 1;
+
+    for (unsigned int i = hash & mask; ; i = (i + 1) & mask) {
+        e = &intern_pool.entries[i];
+
+        if (e->string == NULL) {
+            break;
+        }
+
+        if (e->hash == hash && e->length == length && !memcmp(e->string, s, length)) {
+            return e->string;
+        }
+    }
+
+    e->string = store(s, length);
+    e->hash = hash;
+    e->length = length;
+    intern_pool.count++;
+    return e->string;
+}
+
+char* intern_string(char* s) {
+    return intern(s, strlen(s));
+}
+
+void report_intern_statistics(char* filename) {
+    fprintf(stderr, "%s: %u strings interned in %zu bytes, %ld requests for %zu bytes\n",
+            filename, intern_pool.count, intern_pool.interned_bytes,
+            intern_pool.requests, intern_pool.requested_bytes);
+}
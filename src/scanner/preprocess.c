@@ -0,0 +1,1409 @@
+#include <errno.h>
+#include <limits.h>
+#include <stdarg.h>
+
+#include "../../include/preprocess.h"
+
+// Macro defined with #define
+typedef struct macro {
+    char* name;
+    int length;                 // Length of the name
+    char* body;                 // Replacement text, 0-terminated
+    int body_length;
+    int function_like;          // Defined with a parameter list
+    int variadic;               // Last parameter is '...' (__VA_ARGS__)
+    int param_count;
+    char** params;
+    int expanding;              // Expansion is being scanned, don't expand again
+    struct macro* next;         // Next macro in the same bucket
+} t_macro;
+
+// File read during this process. The contents stay mapped, so every
+// header is read only once no matter how often it is included.
+typedef struct source_file {
+    char* path;                 // Resolved path, key of the cache
+    char* name;                 // Path as first spelled, used in diagnostics
+    t_input_buffer buffer;
+    char* guard;                // Macro of an include guard around the whole file
+    int once;                   // File contains '#pragma once'
+    int unit;                   // Last translation unit that entered the file
+    struct source_file* next;
+} t_source_file;
+
+// Include guard detection of a file that is being scanned
+enum {
+    GUARD_START,                // Nothing seen so far
+    GUARD_INSIDE,               // First directive was #ifndef <guard>
+    GUARD_AFTER,                // The #endif of the guard has been seen
+    GUARD_NONE                  // File is not guarded as a whole
+};
+
+// File or macro expansion on the source stack
+typedef struct source {
+    t_input_buffer buffer;      // Input of the source while a nested one is scanned
+    char* name;                 // File name used in diagnostics
+    int line;                   // Line of the source while a nested one is scanned
+    t_source_file* file;        // NULL for macro expansions
+    t_macro* macro;             // Macro being expanded, NULL for files
+    int owned;                  // Buffer was allocated for the expansion
+    int conditional_depth;      // Depth of the #if stack when the file was entered
+    int guard_state;
+    char* guard;                // Candidate include guard
+    int guard_depth;            // Depth of the #if stack outside the guard
+} t_source;
+
+// State of an #if group
+enum {
+    COND_ACTIVE,                // Current branch is compiled
+    COND_SEARCHING,             // No branch taken so far, the current one is skipped
+    COND_DONE                   // A branch has been taken, the rest is skipped
+};
+
+typedef struct conditional {
+    int state;
+    int else_seen;
+} t_conditional;
+
+// Growable text, used for directive lines and macro expansions
+typedef struct text_buffer {
+    char* data;
+    int length;
+    int capacity;
+} t_text_buffer;
+
+// State of the evaluation of an #if expression
+typedef struct pp_expr {
+    char* p;
+    int depth;                  // Nesting of macros that are evaluated
+    int unevaluated;            // Inside the skipped operand of &&, || or ?:
+} t_pp_expr;
+
+static t_macro* macro_table[MACRO_TABLE_SIZE];
+static int macro_count;
+
+static t_source_file* files;
+
+static t_source sources[MAX_SOURCES];
+static int source_depth;
+
+static t_conditional conditionals[MAX_CONDITIONALS];
+static int conditional_depth;
+
+// Number of the current translation unit
+static int unit;
+
+static t_text_buffer directive_line;
+
+int pp_guard_watch;
+
+static void skip_group(void);
+static long eval_conditional(t_pp_expr* e);
+
+static void pp_error(char* msg, ...) {
+    va_list list;
+
+    fprintf(stderr, "%s:%d: ", infile_name, line);
+    va_start(list, msg);
+    vfprintf(stderr, msg, list);
+    va_end(list);
+    fprintf(stderr, "\n");
+    exit(1);
+}
+
+static void append(t_text_buffer* b, char* s, int length) {
+    if (b->length + length + 1 > b->capacity) {
+        b->capacity = 2 * (b->length + length + 1);
+
+        if ((b->data = realloc(b->data, b->capacity)) == NULL) {
+            report_error("append(): realloc() failed.\n");
+        }
+    }
+
+    memcpy(b->data + b->length, s, length);
+    b->length += length;
+}
+
+static void append_char(t_text_buffer* b, char c) {
+    append(b, &c, 1);
+}
+
+static char* skip_blanks(char* p) {
+    while (*p == ' ' || *p == '\t' || *p == '\r' || *p == '\f' || *p == '\v') {
+        p++;
+    }
+
+    return p;
+}
+
+// Length of the identifier at p, 0 if p does not start one
+static int name_length(char* p) {
+    int n = 0;
+
+    if (!isalpha((unsigned char)*p) && *p != '_') {
+        return 0;
+    }
+
+    while (isalnum((unsigned char)p[n]) || p[n] == '_') {
+        n++;
+    }
+
+    return n;
+}
+
+static int is_name(char* name, int length, char* s) {
+    return (int)strlen(s) == length && !memcmp(name, s, length);
+}
+
+/*
+    Macro table
+*/
+static unsigned int hash_name(char* name, int length) {
+    unsigned int h = 2166136261u;
+
+    for (int i = 0; i < length; i++) {
+        h = (h ^ (unsigned char)name[i]) * 16777619u;
+    }
+
+    return h & (MACRO_TABLE_SIZE - 1);
+}
+
+static t_macro* find_macro(char* name, int length) {
+    t_macro* m;
+
+    for (m = macro_table[hash_name(name, length)]; m != NULL; m = m->next) {
+        if (m->length == length && !memcmp(m->name, name, length)) {
+            return m;
+        }
+    }
+
+    return NULL;
+}
+
+// Names and parameters are interned and stay in the pool
+static void free_macro(t_macro* m) {
+    free(m->params);
+    free(m->body);
+    free(m);
+}
+
+static void undefine(char* name, int length) {
+    t_macro** link = &macro_table[hash_name(name, length)];
+    t_macro* m;
+
+    for (; (m = *link) != NULL; link = &m->next) {
+        if (m->length == length && !memcmp(m->name, name, length)) {
+            *link = m->next;
+            free_macro(m);
+            macro_count--;
+            return;
+        }
+    }
+}
+
+static void define(t_macro* m) {
+    unsigned int h = hash_name(m->name, m->length);
+
+    undefine(m->name, m->length);
+    m->next = macro_table[h];
+    macro_table[h] = m;
+    macro_count++;
+}
+
+static void clear_macros(void) {
+    t_macro* m;
+
+    for (int i = 0; i < MACRO_TABLE_SIZE; i++) {
+        while ((m = macro_table[i]) != NULL) {
+            macro_table[i] = m->next;
+            free_macro(m);
+        }
+    }
+
+    macro_count = 0;
+}
+
+/*
+    Sources
+*/
+
+// Return the cached file with the given path, reading it on first use.
+// Return NULL if the file does not exist.
+static t_source_file* load_file(char* path) {
+    char resolved[PATH_MAX];
+    t_source_file* f;
+    char* key;
+
+    if (realpath(path, resolved) == NULL) {
+        return NULL;
+    }
+
+    key = intern_string(resolved);
+
+    for (f = files; f != NULL; f = f->next) {
+        if (f->path == key) {
+            return f;
+        }
+    }
+
+    f = calloc(1, sizeof(t_source_file));
+
+    if (!input_map_file(resolved, &f->buffer)) {
+        free(f);
+        return NULL;
+    }
+
+    f->path = key;
+    f->name = intern_string(path);
+    f->next = files;
+    files = f;
+    return f;
+}
+
+// Innermost file on the source stack
+static t_source* current_file(void) {
+    int i = source_depth;
+
+    while (i > 0 && sources[i].file == NULL) {
+        i--;
+    }
+
+    return &sources[i];
+}
+
+static void update_guard_watch(void) {
+    t_source* s = &sources[source_depth];
+
+    pp_guard_watch = s->file != NULL && (s->guard_state == GUARD_START || s->guard_state == GUARD_AFTER);
+}
+
+void pp_token_seen(void) {
+    sources[source_depth].guard_state = GUARD_NONE;
+    pp_guard_watch = 0;
+}
+
+static t_source* push_source(void) {
+    if (source_depth + 1 == MAX_SOURCES) {
+        pp_error("Too many nested includes or macro expansions");
+    }
+
+    sources[source_depth].buffer = input;
+    sources[source_depth].line = line;
+    source_depth++;
+    memset(&sources[source_depth], 0, sizeof(t_source));
+
+    return &sources[source_depth];
+}
+
+static void push_file(t_source_file* f) {
+    t_source* s = push_source();
+
+    s->name = f->name;
+    s->file = f;
+    s->conditional_depth = conditional_depth;
+    s->guard_state = GUARD_START;
+    f->unit = unit;
+
+    input = f->buffer;
+    input.pos = input.start;
+    line = 1;
+    infile_name = f->name;
+    update_guard_watch();
+}
+
+static void push_expansion(t_macro* m, char* text, int length, int owned) {
+    t_source* s = push_source();
+
+    s->name = infile_name;
+    s->macro = m;
+    s->owned = owned;
+    s->guard_state = GUARD_NONE;
+    m->expanding = 1;
+
+    input.start = input.pos = text;
+    input.end = text + length;
+    input.capacity = owned ? length : 0;
+    input.mapped = 0;
+    pp_guard_watch = 0;
+}
+
+int pp_pop_source(void) {
+    t_source* s = &sources[source_depth];
+
+    if (s->file != NULL) {
+        if (conditional_depth > s->conditional_depth) {
+            pp_error("Unterminated conditional directive");
+        }
+
+        if (s->guard_state == GUARD_AFTER && s->file->guard == NULL) {
+            s->file->guard = s->guard;
+        }
+
+        s->guard = NULL;
+    } else if (s->macro != NULL) {
+        s->macro->expanding = 0;
+
+        if (s->owned) {
+            free(input.start);
+        }
+
+        s->macro = NULL;
+        s->owned = 0;
+    }
+
+    if (source_depth == 0) {
+        input.pos = input.end;
+        return 0;
+    }
+
+    source_depth--;
+    input = sources[source_depth].buffer;
+    line = sources[source_depth].line;
+    infile_name = sources[source_depth].name;
+    update_guard_watch();
+    return 1;
+}
+
+void pp_start(char* filename) {
+    t_source_file* f;
+
+    unit++;
+    clear_macros();
+    conditional_depth = 0;
+
+    if ((f = load_file(filename)) == NULL) {
+        fprintf(stderr, "Unable to open %s: %s\n", filename, strerror(errno));
+        exit(1);
+    }
+
+    // The main file is the bottom of the stack
+    source_depth = 0;
+    memset(&sources[0], 0, sizeof(t_source));
+    sources[0].name = intern_string(filename);
+    sources[0].file = f;
+    sources[0].guard_state = GUARD_NONE;
+    f->unit = unit;
+
+    input = f->buffer;
+    input.pos = input.start;
+    line = 1;
+    infile_name = sources[0].name;
+    pp_guard_watch = 0;
+}
+
+/*
+    Directives
+*/
+
+// Copy the rest of the directive line into directive_line, joining
+// continuation lines and replacing comments by a blank.
+// The input is left on the '\n' that ends the line, so that line still
+// counts the directive while it is handled.
+static char* read_line(void) {
+    char* p = input.pos;
+    char* end = input.end;
+    int quote = 0;
+    char c;
+
+    directive_line.length = 0;
+
+    while (p < end) {
+        c = *p;
+
+        if (c == '\n') {
+            break;
+        }
+
+        if (c == '\\' && p + 1 < end && p[1] == '\n') {
+            p += 2;
+            line++;
+            continue;
+        }
+
+        if (quote) {
+            append_char(&directive_line, c);
+            p++;
+
+            if (c == '\\' && p < end && *p != '\n') {
+                append_char(&directive_line, *p++);
+            } else if (c == quote) {
+                quote = 0;
+            }
+
+            continue;
+        }
+
+        if (c == '/' && p + 1 < end && p[1] == '/') {
+            while (p < end && *p != '\n') {
+                p++;
+            }
+
+            continue;
+        }
+
+        if (c == '/' && p + 1 < end && p[1] == '*') {
+            for (p += 2; p + 1 < end && !(p[0] == '*' && p[1] == '/'); p++) {
+                line += (*p == '\n');
+            }
+
+            if (p + 1 >= end) {
+                pp_error("Unterminated comment");
+            }
+
+            p += 2;
+            append_char(&directive_line, ' ');
+            continue;
+        }
+
+        if (c == '"' || c == '\'') {
+            quote = c;
+        }
+
+        append_char(&directive_line, c);
+        p++;
+    }
+
+    append_char(&directive_line, '\0');
+    input.pos = p;
+    return directive_line.data;
+}
+
+static void define_directive(char* p) {
+    t_macro* m;
+    int length;
+
+    p = skip_blanks(p);
+
+    if ((length = name_length(p)) == 0) {
+        pp_error("Macro name expected after #define");
+    }
+
+    m = calloc(1, sizeof(t_macro));
+    m->name = intern(p, length);
+    m->length = length;
+    p += length;
+
+    // Only a '(' directly after the name starts a parameter list
+    if (*p == '(') {
+        m->function_like = 1;
+        m->params = malloc(MAX_MACRO_ARGS * sizeof(char*));
+        p = skip_blanks(p + 1);
+
+        while (*p != ')') {
+            if (m->param_count == MAX_MACRO_ARGS) {
+                pp_error("Too many parameters of macro %s", m->name);
+            }
+
+            if (!strncmp(p, "...", 3)) {
+                m->variadic = 1;
+                m->params[m->param_count++] = intern_string("__VA_ARGS__");
+                p = skip_blanks(p + 3);
+                break;
+            }
+
+            if ((length = name_length(p)) == 0) {
+                pp_error("Parameter name expected in macro %s", m->name);
+            }
+
+            m->params[m->param_count++] = intern(p, length);
+            p = skip_blanks(p + length);
+
+            if (*p != ',') {
+                break;
+            }
+
+            p = skip_blanks(p + 1);
+        }
+
+        if (*p != ')') {
+            pp_error("Expected ')' after parameters of macro %s", m->name);
+        }
+
+        p++;
+    }
+
+    p = skip_blanks(p);
+    length = strlen(p);
+
+    while (length > 0 && isspace((unsigned char)p[length - 1])) {
+        length--;
+    }
+
+    m->body = strndup(p, length);
+    m->body_length = length;
+    define(m);
+}
+
+static void push_conditional(int active) {
+    if (conditional_depth == MAX_CONDITIONALS) {
+        pp_error("Conditional directives nested too deeply");
+    }
+
+    conditionals[conditional_depth].state = active ? COND_ACTIVE : COND_SEARCHING;
+    conditionals[conditional_depth].else_seen = 0;
+    conditional_depth++;
+
+    if (!active) {
+        skip_group();
+    }
+}
+
+static void pop_conditional(void) {
+    t_source* s = &sources[source_depth];
+
+    if (conditional_depth == s->conditional_depth) {
+        pp_error("#endif without #if");
+    }
+
+    conditional_depth--;
+
+    if (s->guard_state == GUARD_INSIDE && conditional_depth == s->guard_depth) {
+        s->guard_state = GUARD_AFTER;
+        update_guard_watch();
+    }
+}
+
+// Start an #elif or #else branch of the innermost group
+static t_conditional* next_branch(int is_else) {
+    t_source* s = &sources[source_depth];
+    t_conditional* c;
+
+    if (conditional_depth == s->conditional_depth) {
+        pp_error("#%s without #if", is_else ? "else" : "elif");
+    }
+
+    c = &conditionals[conditional_depth - 1];
+
+    if (c->else_seen) {
+        pp_error("#%s after #else", is_else ? "else" : "elif");
+    }
+
+    c->else_seen = is_else;
+
+    // A guard only covers files without further branches
+    if (s->guard_state == GUARD_INSIDE && conditional_depth == s->guard_depth + 1) {
+        s->guard_state = GUARD_NONE;
+    }
+
+    return c;
+}
+
+static int eval_line(char* p) {
+    t_pp_expr e = {p, 0, 0};
+    long value = eval_conditional(&e);
+
+    e.p = skip_blanks(e.p);
+
+    if (*e.p != '\0') {
+        pp_error("Unexpected '%s' in #if", e.p);
+    }
+
+    return value != 0;
+}
+
+// Skip lines up to the branch of the innermost group that is taken,
+// or up to its #endif.
+static void skip_group(void) {
+    t_conditional* c = &conditionals[conditional_depth - 1];
+    int nesting = 0;
+    char* p;
+    char* nl;
+    int length;
+
+    while (1) {
+        p = input.pos;
+
+        while (p < input.end && (*p == ' ' || *p == '\t' || *p == '\r')) {
+            p++;
+        }
+
+        if (p >= input.end) {
+            pp_error("Unterminated conditional directive");
+        }
+
+        if (*p != '#') {
+            if ((nl = memchr(p, '\n', input.end - p)) == NULL) {
+                input.pos = input.end;
+            } else {
+                input.pos = nl + 1;
+                line++;
+            }
+
+            continue;
+        }
+
+        input.pos = p + 1;
+        p = skip_blanks(read_line());
+        length = name_length(p);
+
+        if (is_name(p, length, "if") || is_name(p, length, "ifdef") || is_name(p, length, "ifndef")) {
+            nesting++;
+        } else if (nesting > 0) {
+            nesting -= is_name(p, length, "endif");
+        } else if (is_name(p, length, "endif")) {
+            pop_conditional();
+            return;
+        } else if (is_name(p, length, "else")) {
+            next_branch(1);
+
+            if (c->state == COND_SEARCHING) {
+                c->state = COND_ACTIVE;
+                return;
+            }
+        } else if (is_name(p, length, "elif")) {
+            next_branch(0);
+
+            if (c->state == COND_SEARCHING && eval_line(p + length)) {
+                c->state = COND_ACTIVE;
+                return;
+            }
+        }
+    }
+}
+
+static void include_directive(char* p) {
+    char path[PATH_MAX];
+    t_source_file* f = NULL;
+    char* dir = current_file()->name;
+    char* slash;
+    char* name;
+    char terminator;
+
+    p = skip_blanks(p);
+
+    if (*p == '"') {
+        terminator = '"';
+    } else if (*p == '<') {
+        terminator = '>';
+    } else {
+        pp_error("Expected \"file\" or <file> after #include");
+    }
+
+    name = ++p;
+
+    while (*p != '\0' && *p != terminator) {
+        p++;
+    }
+
+    if (*p == '\0') {
+        pp_error("Missing %c after file name in #include", terminator);
+    }
+
+    *p = '\0';
+
+    if (name[0] == '/') {
+        f = load_file(name);
+    } else {
+        // "file" is looked for next to the including file first
+        if (terminator == '"') {
+            if ((slash = strrchr(dir, '/')) != NULL) {
+                snprintf(path, PATH_MAX, "%.*s/%s", (int)(slash - dir), dir, name);
+            } else {
+                snprintf(path, PATH_MAX, "%s", name);
+            }
+
+            f = load_file(path);
+        }
+
+        if (f == NULL) {
+            snprintf(path, PATH_MAX, "%s/%s", INCDIR, name);
+            f = load_file(path);
+        }
+    }
+
+    if (f == NULL) {
+        pp_error("Cannot find include file %s", name);
+    }
+
+    // Files that cannot contribute anything are not entered again
+    if (f->once && f->unit == unit) {
+        return;
+    }
+
+    if (f->guard != NULL && find_macro(f->guard, strlen(f->guard)) != NULL) {
+        return;
+    }
+
+    push_file(f);
+}
+
+// #line <number> ["file"] and the markers '#' <number> "file" of cpp
+static void line_directive(char* p) {
+    t_source* s = &sources[source_depth];
+    char* end;
+    char* q;
+    long n;
+
+    p = skip_blanks(p);
+    n = strtol(p, &end, 10);
+
+    if (end == p) {
+        pp_error("Line number expected in #line");
+    }
+
+    p = skip_blanks(end);
+
+    if (*p == '"' && (q = strchr(p + 1, '"')) != NULL) {
+        s->name = intern(p + 1, q - p - 1);
+        infile_name = s->name;
+    }
+
+    // n is the number of the line after the directive
+    line = n - 1;
+}
+
+int pp_directive_start(char* p) {
+    if (sources[source_depth].file == NULL) {
+        return 0;
+    }
+
+    while (p > input.start && (p[-1] == ' ' || p[-1] == '\t' || p[-1] == '\r')) {
+        p--;
+    }
+
+    return p == input.start || p[-1] == '\n';
+}
+
+void pp_directive(void) {
+    t_source* s = &sources[source_depth];
+    int guard_start = s->guard_state == GUARD_START;
+    char* p = skip_blanks(read_line());
+    char* name = p;
+    int length;
+
+    if (s->guard_state == GUARD_START || s->guard_state == GUARD_AFTER) {
+        s->guard_state = GUARD_NONE;
+        pp_guard_watch = 0;
+    }
+
+    // Null directive
+    if (*p == '\0') {
+        return;
+    }
+
+    if (isdigit((unsigned char)*p)) {
+        line_directive(p);
+        return;
+    }
+
+    length = name_length(p);
+    p += length;
+
+    if (is_name(name, length, "define")) {
+        define_directive(p);
+    } else if (is_name(name, length, "undef")) {
+        p = skip_blanks(p);
+        undefine(p, name_length(p));
+    } else if (is_name(name, length, "include")) {
+        include_directive(p);
+    } else if (is_name(name, length, "if")) {
+        push_conditional(eval_line(p));
+    } else if (is_name(name, length, "ifdef") || is_name(name, length, "ifndef")) {
+        int want = length == 5;
+
+        p = skip_blanks(p);
+
+        if ((length = name_length(p)) == 0) {
+            pp_error("Macro name expected after #%s", want ? "ifdef" : "ifndef");
+        }
+
+        if (!want && guard_start) {
+            s->guard_state = GUARD_INSIDE;
+            s->guard = intern(p, length);
+            s->guard_depth = conditional_depth;
+        }
+
+        push_conditional((find_macro(p, length) != NULL) == want);
+    } else if (is_name(name, length, "elif") || is_name(name, length, "else")) {
+        // The group was active so far, everything up to #endif is skipped
+        next_branch(length == 4 && name[2] == 's')->state = COND_DONE;
+        skip_group();
+    } else if (is_name(name, length, "endif")) {
+        pop_conditional();
+    } else if (is_name(name, length, "line")) {
+        line_directive(p);
+    } else if (is_name(name, length, "pragma")) {
+        p = skip_blanks(p);
+
+        if (is_name(p, name_length(p), "once")) {
+            current_file()->file->once = 1;
+        }
+    } else if (is_name(name, length, "error")) {
+        pp_error("#error%s", p);
+    } else if (is_name(name, length, "warning")) {
+        fprintf(stderr, "%s:%d: #warning%s\n", infile_name, line, p);
+    } else {
+        pp_error("Unknown directive #%.*s", length, name);
+    }
+}
+
+/*
+    #if expressions
+*/
+enum {
+    OP_LOGIC_OR = 1, OP_LOGIC_AND, OP_OR, OP_XOR, OP_AND,
+    OP_EQUALS, OP_NOT_EQUAL, OP_LESS_THAN, OP_LESS_EQUAL, OP_GREATER_THAN, OP_GREATER_EQUAL,
+    OP_LSHIFT, OP_RSHIFT, OP_PLUS, OP_MINUS, OP_MUL, OP_DIV, OP_MOD
+};
+
+typedef struct pp_operator {
+    char* spelling;
+    int length;
+    int op;
+    int precedence;
+} t_pp_operator;
+
+// Two character operators come first, so that "<<" is not taken for "<"
+static const t_pp_operator pp_operators[] = {
+    {"||", 2, OP_LOGIC_OR, 1}, {"&&", 2, OP_LOGIC_AND, 2},
+    {"==", 2, OP_EQUALS, 6}, {"!=", 2, OP_NOT_EQUAL, 6},
+    {"<=", 2, OP_LESS_EQUAL, 7}, {">=", 2, OP_GREATER_EQUAL, 7},
+    {"<<", 2, OP_LSHIFT, 8}, {">>", 2, OP_RSHIFT, 8},
+    {"|", 1, OP_OR, 3}, {"^", 1, OP_XOR, 4}, {"&", 1, OP_AND, 5},
+    {"<", 1, OP_LESS_THAN, 7}, {">", 1, OP_GREATER_THAN, 7},
+    {"+", 1, OP_PLUS, 9}, {"-", 1, OP_MINUS, 9},
+    {"*", 1, OP_MUL, 10}, {"/", 1, OP_DIV, 10}, {"%", 1, OP_MOD, 10},
+    {NULL, 0, 0, 0}
+};
+
+static const t_pp_operator* find_operator(char* p) {
+    const t_pp_operator* o;
+
+    for (o = pp_operators; o->spelling != NULL; o++) {
+        if (!strncmp(p, o->spelling, o->length)) {
+            return o;
+        }
+    }
+
+    return NULL;
+}
+
+static int accept(t_pp_expr* e, char c) {
+    e->p = skip_blanks(e->p);
+
+    if (*e->p == c) {
+        e->p++;
+        return 1;
+    }
+
+    return 0;
+}
+
+static long eval_char(t_pp_expr* e) {
+    long value = (unsigned char)*e->p++;
+
+    if (value == '\\') {
+        switch (*e->p++) {
+            case 'n': value = '\n'; break;
+            case 't': value = '\t'; break;
+            case 'r': value = '\r'; break;
+            case '0': value = '\0'; break;
+            default: value = (unsigned char)e->p[-1]; break;
+        }
+    }
+
+    if (*e->p++ != '\'') {
+        pp_error("Expected ' at end of character in #if");
+    }
+
+    return value;
+}
+
+// Value of an identifier. Object-like macros are evaluated in place,
+// function-like macros and all other identifiers count as 0.
+static long eval_identifier(t_pp_expr* e, char* name, int length) {
+    t_macro* m;
+    t_pp_expr body;
+    int depth = 0;
+    long value;
+
+    if (is_name(name, length, "defined")) {
+        int paren = accept(e, '(');
+
+        e->p = skip_blanks(e->p);
+
+        if ((length = name_length(e->p)) == 0) {
+            pp_error("Macro name expected after defined");
+        }
+
+        value = find_macro(e->p, length) != NULL;
+        e->p += length;
+
+        if (paren && !accept(e, ')')) {
+            pp_error("Expected ')' after defined(%.*s", length, e->p - length);
+        }
+
+        return value;
+    }
+
+    if ((m = find_macro(name, length)) == NULL || m->expanding) {
+        return 0;
+    }
+
+    if (m->function_like) {
+        if (accept(e, '(')) {
+            for (depth = 1; depth > 0 && *e->p != '\0'; e->p++) {
+                depth += (*e->p == '(') - (*e->p == ')');
+            }
+        }
+
+        return 0;
+    }
+
+    if (e->depth == MAX_EVAL_DEPTH) {
+        pp_error("Macros nested too deeply in #if");
+    }
+
+    body.p = m->body;
+    body.depth = e->depth + 1;
+    body.unevaluated = e->unevaluated;
+
+    m->expanding = 1;
+    value = eval_conditional(&body);
+    m->expanding = 0;
+
+    if (*skip_blanks(body.p) != '\0') {
+        pp_error("Macro %s is not an expression in #if", m->name);
+    }
+
+    return value;
+}
+
+static long eval_unary(t_pp_expr* e) {
+    char* end;
+    long value;
+    int length;
+
+    e->p = skip_blanks(e->p);
+
+    switch (*e->p) {
+        case '!': e->p++; return !eval_unary(e);
+        case '~': e->p++; return ~eval_unary(e);
+        case '-': e->p++; return -eval_unary(e);
+        case '+': e->p++; return eval_unary(e);
+        case '(':
+            e->p++;
+            value = eval_conditional(e);
+
+            if (!accept(e, ')')) {
+                pp_error("Expected ')' in #if");
+            }
+
+            return value;
+        case '\'':
+            e->p++;
+            return eval_char(e);
+    }
+
+    if (isdigit((unsigned char)*e->p)) {
+        value = strtol(e->p, &end, 0);
+        e->p = end;
+
+        while (*e->p == 'u' || *e->p == 'U' || *e->p == 'l' || *e->p == 'L') {
+            e->p++;
+        }
+
+        return value;
+    }
+
+    if ((length = name_length(e->p)) > 0) {
+        e->p += length;
+        return eval_identifier(e, e->p - length, length);
+    }
+
+    pp_error("Value expected in #if");
+    return 0;
+}
+
+static long eval_binary(t_pp_expr* e, int precedence) {
+    const t_pp_operator* o;
+    long lhs = eval_unary(e);
+    long rhs;
+    int skipped;
+
+    while (1) {
+        e->p = skip_blanks(e->p);
+
+        if ((o = find_operator(e->p)) == NULL || o->precedence < precedence) {
+            return lhs;
+        }
+
+        e->p += o->length;
+
+        // Division by zero is only an error where it is evaluated
+        skipped = (o->op == OP_LOGIC_AND && !lhs) || (o->op == OP_LOGIC_OR && lhs);
+        e->unevaluated += skipped;
+        rhs = eval_binary(e, o->precedence + 1);
+        e->unevaluated -= skipped;
+
+        switch (o->op) {
+            case OP_LOGIC_OR: lhs = lhs || rhs; break;
+            case OP_LOGIC_AND: lhs = lhs && rhs; break;
+            case OP_OR: lhs |= rhs; break;
+            case OP_XOR: lhs ^= rhs; break;
+            case OP_AND: lhs &= rhs; break;
+            case OP_EQUALS: lhs = lhs == rhs; break;
+            case OP_NOT_EQUAL: lhs = lhs != rhs; break;
+            case OP_LESS_THAN: lhs = lhs < rhs; break;
+            case OP_LESS_EQUAL: lhs = lhs <= rhs; break;
+            case OP_GREATER_THAN: lhs = lhs > rhs; break;
+            case OP_GREATER_EQUAL: lhs = lhs >= rhs; break;
+            case OP_LSHIFT: lhs <<= rhs; break;
+            case OP_RSHIFT: lhs >>= rhs; break;
+            case OP_PLUS: lhs += rhs; break;
+            case OP_MINUS: lhs -= rhs; break;
+            case OP_MUL: lhs *= rhs; break;
+            case OP_DIV:
+            case OP_MOD:
+                if (rhs == 0) {
+                    if (!e->unevaluated) {
+                        pp_error("Division by zero in #if");
+                    }
+
+                    lhs = 0;
+                } else {
+                    lhs = o->op == OP_DIV ? lhs / rhs : lhs % rhs;
+                }
+                break;
+        }
+    }
+}
+
+static long eval_conditional(t_pp_expr* e) {
+    long condition = eval_binary(e, 1);
+    long a, b;
+
+    if (!accept(e, '?')) {
+        return condition;
+    }
+
+    e->unevaluated += !condition;
+    a = eval_conditional(e);
+    e->unevaluated -= !condition;
+
+    if (!accept(e, ':')) {
+        pp_error("Expected ':' in #if");
+    }
+
+    e->unevaluated += !!condition;
+    b = eval_conditional(e);
+    e->unevaluated -= !!condition;
+
+    return condition ? a : b;
+}
+
+/*
+    Macro expansion
+*/
+
+// Skip whitespace up to the next character and tell if it is '('.
+// Expansions that end on the way are finished, so that the arguments
+// of a function-like macro may follow the expansion it was named in.
+static int next_is_paren(void) {
+    while (1) {
+        while (input.pos < input.end && isspace((unsigned char)*input.pos)) {
+            line += (*input.pos++ == '\n');
+        }
+
+        if (input.pos < input.end) {
+            return *input.pos == '(';
+        }
+
+        if (sources[source_depth].macro == NULL) {
+            return 0;
+        }
+
+        pp_pop_source();
+    }
+}
+
+// Split the arguments of a call of m, whose '(' is at p, into spans.
+// Return a pointer behind the closing ')'.
+static char* collect_args(t_macro* m, char* p, char* end, char** args, int* lengths) {
+    char* start = ++p;
+    int depth = 0;
+    int count = 0;
+    char c;
+
+    while (1) {
+        if (p >= end) {
+            pp_error("Unterminated call of macro %s", m->name);
+        }
+
+        c = *p;
+
+        if (c == '"' || c == '\'') {
+            for (p++; p < end && *p != c && *p != '\n'; p++) {
+                p += (*p == '\\');
+            }
+        } else if (c == '(') {
+            depth++;
+        } else if (c == ')' && depth > 0) {
+            depth--;
+        } else if (c == ')' || (c == ',' && depth == 0 && !(m->variadic && count == m->param_count - 1))) {
+            if (count == MAX_MACRO_ARGS) {
+                pp_error("Too many arguments for macro %s", m->name);
+            }
+
+            // Leading and trailing whitespace does not belong to the argument
+            while (start < p && isspace((unsigned char)*start)) {
+                start++;
+            }
+
+            args[count] = start;
+            lengths[count] = p - start;
+
+            while (lengths[count] > 0 && isspace((unsigned char)start[lengths[count] - 1])) {
+                lengths[count]--;
+            }
+
+            count++;
+            start = p + 1;
+
+            if (c == ')') {
+                break;
+            }
+        }
+
+        p++;
+    }
+
+    // m() passes no argument at all, m(a) may leave out the variable ones
+    if (count == 1 && m->param_count == 0 && lengths[0] == 0) {
+        count = 0;
+    } else if (m->variadic && count == m->param_count - 1) {
+        args[count] = "";
+        lengths[count++] = 0;
+    }
+
+    if (count != m->param_count) {
+        pp_error("Macro %s expects %d arguments, %d given", m->name, m->param_count, count);
+    }
+
+    return p + 1;
+}
+
+static void substitute(t_macro* m, char** args, int* lengths, t_text_buffer* b);
+
+// Copy [p, end) to b with all macros in it expanded. Arguments are
+// expanded this way before they are substituted, so that a macro may
+// appear in the arguments of its own call.
+static void expand_text(char* p, char* end, t_text_buffer* b) {
+    char* args[MAX_MACRO_ARGS];
+    int lengths[MAX_MACRO_ARGS];
+    t_text_buffer call;
+    t_macro* m;
+    char* q;
+    int length;
+
+    while (p < end) {
+        if (*p == '"' || *p == '\'') {
+            for (q = p + 1; q < end && *q != *p; q++) {
+                q += (*q == '\\');
+            }
+
+            q += (q < end);
+            append(b, p, q - p);
+            p = q;
+            continue;
+        }
+
+        if (isdigit((unsigned char)*p)) {
+            for (q = p; q < end && (isalnum((unsigned char)*q) || *q == '_' || *q == '.'); q++);
+            append(b, p, q - p);
+            p = q;
+            continue;
+        }
+
+        if ((length = name_length(p)) == 0 || p + length > end) {
+            append_char(b, *p++);
+            continue;
+        }
+
+        if ((m = find_macro(p, length)) == NULL || m->expanding) {
+            append(b, p, length);
+            p += length;
+            continue;
+        }
+
+        for (q = p + length; q < end && isspace((unsigned char)*q); q++);
+
+        if (!m->function_like) {
+            q = p + length;
+            call.data = m->body;
+            call.length = m->body_length;
+        } else if (q < end && *q == '(') {
+            q = collect_args(m, q, end, args, lengths);
+            call.data = NULL;
+            call.length = call.capacity = 0;
+            substitute(m, args, lengths, &call);
+        } else {
+            append(b, p, length);
+            p += length;
+            continue;
+        }
+
+        append_char(b, ' ');
+        m->expanding = 1;
+        expand_text(call.data, call.data + call.length, b);
+        m->expanding = 0;
+        append_char(b, ' ');
+
+        if (m->function_like) {
+            free(call.data);
+        }
+
+        p = q;
+    }
+}
+
+static int param_index(t_macro* m, char* name, int length) {
+    for (int i = 0; i < m->param_count; i++) {
+        if (is_name(name, length, m->params[i])) {
+            return i;
+        }
+    }
+
+    return -1;
+}
+
+static int followed_by_paste(char* p) {
+    p = skip_blanks(p);
+    return p[0] == '#' && p[1] == '#';
+}
+
+// #arg: the spelling of the argument as a string literal
+static void stringize(t_text_buffer* b, char* arg, int length) {
+    append_char(b, '"');
+
+    for (int i = 0; i < length; i++) {
+        if (isspace((unsigned char)arg[i])) {
+            while (i + 1 < length && isspace((unsigned char)arg[i + 1])) {
+                i++;
+            }
+
+            append_char(b, ' ');
+            continue;
+        }
+
+        if (arg[i] == '"' || arg[i] == '\\') {
+            append_char(b, '\\');
+        }
+
+        append_char(b, arg[i]);
+    }
+
+    append_char(b, '"');
+}
+
+// Replace the parameters in the body of m by the arguments.
+// Operands of # and ## are inserted as written, all other arguments
+// with their macros expanded. Blanks around an argument keep it from
+// running into the surrounding tokens.
+static void substitute(t_macro* m, char** args, int* lengths, t_text_buffer* b) {
+    char* p = m->body;
+    char* end = m->body + m->body_length;
+    char* q;
+    int paste = 0;
+    int length;
+    int k;
+
+    while (p < end) {
+        if (p[0] == '#' && p[1] == '#') {
+            while (b->length > 0 && isspace((unsigned char)b->data[b->length - 1])) {
+                b->length--;
+            }
+
+            p = skip_blanks(p + 2);
+            paste = 1;
+            continue;
+        }
+
+        if (p[0] == '#') {
+            q = skip_blanks(p + 1);
+            length = name_length(q);
+
+            if (length > 0 && (k = param_index(m, q, length)) >= 0) {
+                stringize(b, args[k], lengths[k]);
+                p = q + length;
+                paste = 0;
+                continue;
+            }
+        }
+
+        if ((length = name_length(p)) > 0) {
+            if ((k = param_index(m, p, length)) >= 0) {
+                int blanks = !paste && !followed_by_paste(p + length);
+
+                if (blanks) {
+                    append_char(b, ' ');
+                    expand_text(args[k], args[k] + lengths[k], b);
+                    append_char(b, ' ');
+                } else {
+                    append(b, args[k], lengths[k]);
+                }
+            } else {
+                append(b, p, length);
+            }
+
+            p += length;
+            paste = 0;
+            continue;
+        }
+
+        // Numbers such as 0x1f are copied whole, their letters are no parameters
+        if (isdigit((unsigned char)*p)) {
+            for (q = p; q < end && (isalnum((unsigned char)*q) || *q == '_' || *q == '.'); q++);
+            append(b, p, q - p);
+            p = q;
+            paste = 0;
+            continue;
+        }
+
+        if (*p == '"' || *p == '\'') {
+            for (q = p + 1; q < end && *q != *p; q++) {
+                q += (*q == '\\');
+            }
+
+            q += (q < end);
+            append(b, p, q - p);
+            p = q;
+            paste = 0;
+            continue;
+        }
+
+        append_char(b, *p++);
+        paste = 0;
+    }
+}
+
+int pp_expand(char* name, int length) {
+    char* args[MAX_MACRO_ARGS];
+    int lengths[MAX_MACRO_ARGS];
+    t_text_buffer expansion = {NULL, 0, 0};
+    t_macro* m;
+    char* end;
+
+    if (macro_count == 0 || (m = find_macro(name, length)) == NULL || m->expanding) {
+        return 0;
+    }
+
+    if (!m->function_like) {
+        push_expansion(m, m->body, m->body_length, 0);
+        return 1;
+    }
+
+    // The name of a function-like macro without arguments is left alone
+    if (!next_is_paren()) {
+        return 0;
+    }
+
+    end = collect_args(m, input.pos, input.end, args, lengths);
+
+    for (; input.pos < end; input.pos++) {
+        line += (*input.pos == '\n');
+    }
+
+    substitute(m, args, lengths, &expansion);
+    push_expansion(m, expansion.data, expansion.length, 1);
+    return 1;
+}
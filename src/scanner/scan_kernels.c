@@ -0,0 +1,295 @@
+#include "../../include/scan_kernels.h"
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <immintrin.h>
+#define HAVE_X86_KERNELS
+#endif
+
+/*
+    Scalar kernels, used on every CPU and for the tail of the buffer.
+*/
+static char* scalar_skip_whitespace(char* p, char* end, int* newlines) {
+    int count = 0;
+
+    while (p < end && (*p == ' ' || *p == '\t' || *p == '\n' || *p == '\r')) {
+        count += (*p == '\n');
+        p++;
+    }
+
+    *newlines = count;
+    return p;
+}
+
+static char* scalar_skip_identifier(char* p, char* end) {
+    while (p < end) {
+        char c = *p;
+
+        if (!((c >= 'a' && c <= 'z') || (c >= 'A' && c <= 'Z') || (c >= '0' && c <= '9') || c == '_')) {
+            break;
+        }
+
+        p++;
+    }
+
+    return p;
+}
+
+static char* scalar_skip_digits(char* p, char* end) {
+    while (p < end && *p >= '0' && *p <= '9') {
+        p++;
+    }
+
+    return p;
+}
+
+static char* scalar_skip_string(char* p, char* end) {
+    while (p < end && *p != '"' && *p != '\\' && *p != '\n') {
+        p++;
+    }
+
+    return p;
+}
+
+#ifdef HAVE_X86_KERNELS
+
+/*
+    SSE2 kernels, 16 characters per step.
+    Range checks shift the range [lo, hi] down to start at -128, so
+    that one signed comparison decides whether a byte lies inside.
+*/
+__attribute__((target("sse2")))
+static inline __m128i sse2_in_range(__m128i v, char lo, char hi) {
+    __m128i shifted = _mm_add_epi8(v, _mm_set1_epi8((char)(0x80 - lo)));
+    return _mm_cmplt_epi8(shifted, _mm_set1_epi8((char)(0x80 + (hi - lo + 1))));
+}
+
+__attribute__((target("sse2")))
+static char* sse2_skip_whitespace(char* p, char* end, int* newlines) {
+    int count = 0;
+    int tail;
+
+    while (end - p >= 16) {
+        __m128i v = _mm_loadu_si128((const __m128i*)p);
+        __m128i nl = _mm_cmpeq_epi8(v, _mm_set1_epi8('\n'));
+        __m128i ws = _mm_or_si128(
+                _mm_or_si128(_mm_cmpeq_epi8(v, _mm_set1_epi8(' ')), _mm_cmpeq_epi8(v, _mm_set1_epi8('\t'))),
+                _mm_or_si128(nl, _mm_cmpeq_epi8(v, _mm_set1_epi8('\r'))));
+
+        unsigned int mask = _mm_movemask_epi8(ws);
+        unsigned int nl_mask = _mm_movemask_epi8(nl);
+
+        if (mask != 0xffff) {
+            int n = __builtin_ctz(~mask);
+            *newlines = count + __builtin_popcount(nl_mask & ((1u << n) - 1));
+            return p + n;
+        }
+
+        count += __builtin_popcount(nl_mask);
+        p += 16;
+    }
+
+    p = scalar_skip_whitespace(p, end, &tail);
+    *newlines = count + tail;
+    return p;
+}
+
+__attribute__((target("sse2")))
+static char* sse2_skip_identifier(char* p, char* end) {
+    while (end - p >= 16) {
+        __m128i v = _mm_loadu_si128((const __m128i*)p);
+        __m128i alpha = sse2_in_range(_mm_or_si128(v, _mm_set1_epi8(0x20)), 'a', 'z');
+        __m128i digit = sse2_in_range(v, '0', '9');
+        __m128i underscore = _mm_cmpeq_epi8(v, _mm_set1_epi8('_'));
+
+        unsigned int mask = _mm_movemask_epi8(_mm_or_si128(_mm_or_si128(alpha, digit), underscore));
+
+        if (mask != 0xffff) {
+            return p + __builtin_ctz(~mask);
+        }
+
+        p += 16;
+    }
+
+    return scalar_skip_identifier(p, end);
+}
+
+__attribute__((target("sse2")))
+static char* sse2_skip_digits(char* p, char* end) {
+    while (end - p >= 16) {
+        __m128i v = _mm_loadu_si128((const __m128i*)p);
+        unsigned int mask = _mm_movemask_epi8(sse2_in_range(v, '0', '9'));
+
+        if (mask != 0xffff) {
+            return p + __builtin_ctz(~mask);
+        }
+
+        p += 16;
+    }
+
+    return scalar_skip_digits(p, end);
+}
+
+__attribute__((target("sse2")))
+static char* sse2_skip_string(char* p, char* end) {
+    while (end - p >= 16) {
+        __m128i v = _mm_loadu_si128((const __m128i*)p);
+        __m128i stop = _mm_or_si128(
+                _mm_or_si128(_mm_cmpeq_epi8(v, _mm_set1_epi8('"')), _mm_cmpeq_epi8(v, _mm_set1_epi8('\\'))),
+                _mm_cmpeq_epi8(v, _mm_set1_epi8('\n')));
+
+        unsigned int mask = _mm_movemask_epi8(stop);
+
+        if (mask != 0) {
+            return p + __builtin_ctz(mask);
+        }
+
+        p += 16;
+    }
+
+    return scalar_skip_string(p, end);
+}
+
+/*
+    AVX2 kernels, 32 characters per step.
+*/
+__attribute__((target("avx2")))
+static inline __m256i avx2_in_range(__m256i v, char lo, char hi) {
+    __m256i shifted = _mm256_add_epi8(v, _mm256_set1_epi8((char)(0x80 - lo)));
+    return _mm256_cmpgt_epi8(_mm256_set1_epi8((char)(0x80 + (hi - lo + 1))), shifted);
+}
+
+__attribute__((target("avx2")))
+static char* avx2_skip_whitespace(char* p, char* end, int* newlines) {
+    int count = 0;
+    int tail;
+
+    while (end - p >= 32) {
+        __m256i v = _mm256_loadu_si256((const __m256i*)p);
+        __m256i nl = _mm256_cmpeq_epi8(v, _mm256_set1_epi8('\n'));
+        __m256i ws = _mm256_or_si256(
+                _mm256_or_si256(_mm256_cmpeq_epi8(v, _mm256_set1_epi8(' ')), _mm256_cmpeq_epi8(v, _mm256_set1_epi8('\t'))),
+                _mm256_or_si256(nl, _mm256_cmpeq_epi8(v, _mm256_set1_epi8('\r'))));
+
+        unsigned int mask = _mm256_movemask_epi8(ws);
+        unsigned int nl_mask = _mm256_movemask_epi8(nl);
+
+        if (mask != 0xffffffffu) {
+            int n = __builtin_ctz(~mask);
+            *newlines = count + __builtin_popcount(nl_mask & ((1u << n) - 1));
+            return p + n;
+        }
+
+        count += __builtin_popcount(nl_mask);
+        p += 32;
+    }
+
+    p = sse2_skip_whitespace(p, end, &tail);
+    *newlines = count + tail;
+    return p;
+}
+
+__attribute__((target("avx2")))
+static char* avx2_skip_identifier(char* p, char* end) {
+    while (end - p >= 32) {
+        __m256i v = _mm256_loadu_si256((const __m256i*)p);
+        __m256i alpha = avx2_in_range(_mm256_or_si256(v, _mm256_set1_epi8(0x20)), 'a', 'z');
+        __m256i digit = avx2_in_range(v, '0', '9');
+        __m256i underscore = _mm256_cmpeq_epi8(v, _mm256_set1_epi8('_'));
+
+        unsigned int mask = _mm256_movemask_epi8(_mm256_or_si256(_mm256_or_si256(alpha, digit), underscore));
+
+        if (mask != 0xffffffffu) {
+            return p + __builtin_ctz(~mask);
+        }
+
+        p += 32;
+    }
+
+    return sse2_skip_identifier(p, end);
+}
+
+__attribute__((target("avx2")))
+static char* avx2_skip_digits(char* p, char* end) {
+    while (end - p >= 32) {
+        __m256i v = _mm256_loadu_si256((const __m256i*)p);
+        unsigned int mask = _mm256_movemask_epi8(avx2_in_range(v, '0', '9'));
+
+        if (mask != 0xffffffffu) {
+            return p + __builtin_ctz(~mask);
+        }
+
+        p += 32;
+    }
+
+    return sse2_skip_digits(p, end);
+}
+
+__attribute__((target("avx2")))
+static char* avx2_skip_string(char* p, char* end) {
+    while (end - p >= 32) {
+        __m256i v = _mm256_loadu_si256((const __m256i*)p);
+        __m256i stop = _mm256_or_si256(
+                _mm256_or_si256(_mm256_cmpeq_epi8(v, _mm256_set1_epi8('"')), _mm256_cmpeq_epi8(v, _mm256_set1_epi8('\\'))),
+                _mm256_cmpeq_epi8(v, _mm256_set1_epi8('\n')));
+
+        unsigned int mask = _mm256_movemask_epi8(stop);
+
+        if (mask != 0) {
+            return p + __builtin_ctz(mask);
+        }
+
+        p += 32;
+    }
+
+    return sse2_skip_string(p, end);
+}
+
+#endif
+
+static const t_scan_kernels scalar_kernels = {
+    "scalar",
+    scalar_skip_whitespace,
+    scalar_skip_identifier,
+    scalar_skip_digits,
+    scalar_skip_string
+};
+
+#ifdef HAVE_X86_KERNELS
+static const t_scan_kernels sse2_kernels = {
+    "sse2",
+    sse2_skip_whitespace,
+    sse2_skip_identifier,
+    sse2_skip_digits,
+    sse2_skip_string
+};
+
+static const t_scan_kernels avx2_kernels = {
+    "avx2",
+    avx2_skip_whitespace,
+    avx2_skip_identifier,
+    avx2_skip_digits,
+    avx2_skip_string
+};
+#endif
+
+t_scan_kernels scan_kernels = {
+    "scalar",
+    scalar_skip_whitespace,
+    scalar_skip_identifier,
+    scalar_skip_digits,
+    scalar_skip_string
+};
+
+void select_scan_kernels(void) {
+    scan_kernels = scalar_kernels;
+
+#ifdef HAVE_X86_KERNELS
+    __builtin_cpu_init();
+
+    if (__builtin_cpu_supports("avx2")) {
+        scan_kernels = avx2_kernels;
+    } else if (__builtin_cpu_supports("sse2")) {
+        scan_kernels = sse2_kernels;
+    }
+#endif
+}
@@ -1,4 +1,7 @@
 #include "../include/scanner.h"
+#include "../include/input.h"
+#include "../include/preprocess.h"
+#include "../include/scan_kernels.h"
 
 /*
     Forward declarations
@@ -6,8 +9,9 @@
 static int next(void);
 static int skip(void);
 static void putback(int);
-static int char_index(char*, int);
+static void skip_comment(void);
 static int scan_int(int);
+static int escape_char(int);
 
 // Scan character
 static int scanch(void);
@@ -15,7 +19,95 @@ static int scanch(void);
 // Scan string
 static int scanstr(char* buff);
 
-static int scan_identifier(int c, char* buff, int lim);
+static int scan_identifier(void);
+static int keyword(char* s, int length);
+
+// Character classes used to dispatch on the first character of a token
+enum {
+    CC_SPACE = 0x1,         // ' ', '\t', '\n', '\r'
+    CC_DIGIT = 0x2,         // '0'-'9'
+    CC_ALPHA = 0x4,         // 'a'-'z', 'A'-'Z', '_'
+    CC_IDENT = CC_DIGIT | CC_ALPHA
+};
+
+// Runs up to this length are scanned one character at a time,
+// the vector kernels only pay off for longer ones
+#define SHORT_RUN 8
+
+static const unsigned char char_class[256] = {
+    [' '] = CC_SPACE, ['\t'] = CC_SPACE, ['\n'] = CC_SPACE, ['\r'] = CC_SPACE,
+    ['0' ... '9'] = CC_DIGIT,
+    ['a' ... 'z'] = CC_ALPHA,
+    ['A' ... 'Z'] = CC_ALPHA,
+    ['_'] = CC_ALPHA
+};
+
+// Characters that form a token on their own, whatever follows them
+static const unsigned char single_char_tokens[256] = {
+    ['^'] = T_XOR,
+    [':'] = T_COLON,
+    ['.'] = T_DOT,
+    ['~'] = T_INVERT,
+    ['*'] = T_STAR,
+    ['/'] = T_SLASH,
+    ['%'] = T_PERCENT,
+    [';'] = T_SEMICOLON,
+    [','] = T_COMMA,
+    ['('] = T_LEFT_PAREN,
+    [')'] = T_RIGHT_PAREN,
+    ['{'] = T_LEFT_BRACE,
+    ['}'] = T_RIGHT_BRACE,
+    ['['] = T_LEFT_BRACKET,
+    [']'] = T_RIGHT_BRACKET
+};
+
+// Perfect hash over the keywords: no two keywords share a slot, so a
+// single comparison decides whether an identifier is a keyword.
+#define KEYWORD_HASH_SIZE 64
+#define KEYWORD_MIN_LENGTH 2
+#define KEYWORD_MAX_LENGTH 8
+#define KEYWORD_HASH(s, length) \
+    (((unsigned char)(s)[0] * 54 + (unsigned char)(s)[(length) - 1] + (length)) & (KEYWORD_HASH_SIZE - 1))
+
+typedef struct keyword_entry {
+    char* name;
+    int length;
+    int token;
+} t_keyword_entry;
+
+static const t_keyword_entry keywords[KEYWORD_HASH_SIZE] = {
+    [0] = {"return", 6, T_RETURN},
+    [2] = {"extern", 6, T_EXTERN},
+    [3] = {"double", 6, T_DOUBLE},
+    [4] = {"while", 5, T_WHILE},
+    [6] = {"register", 8, T_REGISTER},
+    [9] = {"do", 2, T_DO},
+    [11] = {"case", 4, T_CASE},
+    [12] = {"void", 4, T_VOID},
+    [14] = {"if", 2, T_IF},
+    [15] = {"continue", 8, T_CONTINUE},
+    [17] = {"volatile", 8, T_VOLATILE},
+    [19] = {"default", 7, T_DEFAULT},
+    [24] = {"char", 4, T_CHAR},
+    [26] = {"unsigned", 8, T_UNSIGNED},
+    [27] = {"const", 5, T_CONST},
+    [28] = {"break", 5, T_BREAK},
+    [29] = {"int", 3, T_INT},
+    [33] = {"union", 5, T_UNION},
+    [37] = {"typedef", 7, T_TYPEDEF},
+    [41] = {"auto", 4, T_AUTO},
+    [43] = {"static", 6, T_STATIC},
+    [44] = {"signed", 6, T_SIGNED},
+    [45] = {"goto", 4, T_GOTO},
+    [46] = {"sizeof", 6, T_SIZEOF},
+    [48] = {"switch", 6, T_SWITCH},
+    [51] = {"long", 4, T_LONG},
+    [55] = {"else", 4, T_ELSE},
+    [57] = {"for", 3, T_FOR},
+    [60] = {"struct", 6, T_STRUCT},
+    [61] = {"float", 5, T_FLOAT},
+    [63] = {"enum", 4, T_ENUM}
+};
 
 static t_token* rejected_token = NULL;
 
@@ -27,55 +119,84 @@ void reject_token(t_token* t) {
     rejected_token = t;
 }
 
+// Skip whitespace, comments and directives and return the first
+// character after them. Sources that run out are left for the one they
+// were included or expanded from.
 static int skip(void) {
     int c;
+    int newlines;
+
+    while (1) {
+        // Most tokens are separated by a blank or two, only longer
+        // runs are worth a call into the kernel
+        if (input.end - input.pos > SHORT_RUN && (char_class[(unsigned char)input.pos[1]] & CC_SPACE)
+            && (char_class[(unsigned char)input.pos[2]] & CC_SPACE)) {
+            input.pos = scan_kernels.skip_whitespace(input.pos, input.end, &newlines);
+            line += newlines;
+        }
 
-    c = next();
-
-    while (c == ' ' || c == '\t' || c == '\n' || c == '\r') {
         c = next();
-    }
 
-    return c;
-}
+        if (c == EOF) {
+            if (pp_pop_source()) {
+                continue;
+            }
 
-static int next(void) {
-    int c;
-    int l;
+            return EOF;
+        }
+
+        if (char_class[c] & CC_SPACE) {
+            continue;
+        }
+
+        if (c == '/' && input.pos < input.end && (*input.pos == '*' || *input.pos == '/')) {
+            skip_comment();
+            continue;
+        }
+
+        if (c == '#' && pp_directive_start(input.pos - 1)) {
+            pp_directive();
+            continue;
+        }
 
-    if (last_char) {
-        c = last_char;
-        last_char = 0;
         return c;
     }
+}
 
-    c = fgetc(infile);
+// Skip the comment whose '/' has just been read.
+static void skip_comment(void) {
+    char* p;
 
-    while (c == '#') {
-        scan(&token);
+    // Line comments leave the '\n' to skip()
+    if (*input.pos == '/') {
+        p = memchr(input.pos, '\n', input.end - input.pos);
+        input.pos = p != NULL ? p : input.end;
+        return;
+    }
 
-        if (token.token != T_INTLIT) {
-            report_error("next(): Expected preprocessor line number.\n");
+    for (p = input.pos + 1; p + 1 < input.end; p++) {
+        if (p[0] == '*' && p[1] == '/') {
+            input.pos = p + 2;
+            return;
         }
 
-        l = token.value;
-        scan(&token);
-
-        if (token.token != T_STRINGLIT) {
-            report_error("next(): Expected file name.\n");
-        }
+        line += (*p == '\n');
+    }
 
-        if (text[0] == '<') {
-            if (strcmp(text, infile_name) != 0) {
-                infile_name = strdup(text);
-            }
+    fprintf(stderr, "Unterminated comment on line %d\n", line);
+    exit(1);
+}
 
-            line = l;
-        }
+// Hand out the next character of the current source.
+static int next(void) {
+    int c;
 
-        while ((c = fgetc(infile)) != '\n') {c = fgetc(infile);}
+    if (input.pos >= input.end) {
+        return EOF;
     }
 
+    c = (unsigned char)*input.pos++;
+
     if (c == '\n') {
         line++;
     }
@@ -83,114 +204,65 @@ static int next(void) {
     return c;
 }
 
+// Step back over the character last returned by next().
 static void putback(int c) {
-    last_char = c;
-}
+    if (c == EOF) {
+        return;
+    }
 
-static int char_index(char *s, int c) {
-    char* p;
-    p = strchr(s, c);
+    input.pos--;
 
-    return (p ? p - s: -1);
+    if (c == '\n') {
+        line--;
+    }
 }
 
+// Scan an integer literal whose first digit c has already been read.
 static int scan_int(int c) {
-    int pos, val = 0;
+    char* p = input.pos;
+    char* end = scan_kernels.skip_digits(p, input.end);
+    int val = c - '0';
 
-    while ((pos = char_index("0123456789", c)) >= 0) {
-        val = val * 10 + pos;
-        c = next();
+    for (; p < end; p++) {
+        val = val * 10 + (*p - '0');
     }
 
-    putback(c);
-
+    input.pos = end;
     return val;
 }
 
-static int scan_identifier(int c, char* buff, int lim) {
-    int i = 0;
+// Scan an identifier whose first character has already been read.
+// Return the length of the identifier, which starts at input.pos - 1.
+static int scan_identifier(void) {
+    char* begin = input.pos - 1;
+    char* p = input.pos;
+    char* short_end = (input.end - p > SHORT_RUN) ? p + SHORT_RUN : input.end;
 
-    while (isalpha(c) || isdigit(c) || '_' == c) {
-        if (i == (lim - 1)) {
-            fprintf(stderr, "Identifier too long on line %d\n", line);
-            exit(1);
-        } else if (i < (lim - 1)) {
-            buff[i++] = c;
-        }
+    while (p < short_end && (char_class[(unsigned char)*p] & CC_IDENT)) {
+        p++;
+    }
 
-        c = next();
+    if (p == short_end) {
+        p = scan_kernels.skip_identifier(p, input.end);
     }
 
-    putback(c);
-    buff[i] = '\0';
-    return i;
+    input.pos = p;
+    return p - begin;
 }
 
-static int keyword(char* s) {
-    switch (*s) {
-        case 'a':
-            if (!strcmp(s, "auto")) { return T_AUTO; }
-            break;
-        case 'b':
-            if (!strcmp(s, "break")) { return T_BREAK; }
-            break;
-        case 'c':
-            if (!strcmp(s, "char")) {return T_CHAR;}
-            else if (!strcmp(s, "continue")) { return T_CONTINUE; }
-            else if (!strcmp(s, "const")) {return T_CONST;}
-            else if (!strcmp(s, "case")) { return T_CASE; }
-            break;
-        case 'd':
-            if (!strcmp(s, "default")) { return T_DEFAULT;}
-            else if (!strcmp(s, "double")) { return T_DOUBLE;}
-            else if (!strcmp(s, "do")) {return T_DO;}
-            break;
-        case 'e':
-            if (!strcmp(s, "else")) {return T_ELSE;}
-            else if (!strcmp(s, "enum")) {return T_ENUM;}
-            else if (!strcmp(s, "extern")) {return T_EXTERN;}
-            break;
-        case 'f':
-            if (!strcmp(s, "for")) {return T_FOR;}
-            else if (!strcmp(s, "float")) {return T_FLOAT;}
-            break;
-        case 'g':
-            if (!strcmp(s, "goto")) {return T_GOTO;}
-            break;
-        case 'i':
-            if (!strcmp(s, "int")) {return T_INT;}
-            else if (!strcmp(s, "if")) {return T_IF;}
-            break;
-        case 'l': {
-            if (!strcmp(s, "long")) {return T_LONG;}
-            break;
-        }
-        case 'r': {
-            if (!strcmp(s, "return")) { return T_RETURN; }
-            else if (!strcmp(s, "register")) {return T_REGISTER;}
-            break;
-        }
-        case 's':
-            if (!strcmp(s, "struct")) { return T_STRUCT; }
-            else if (!strcmp(s, "sizeof")) {return T_SIZEOF;}
-            else if (!strcmp(s, "static")) {return T_STATIC;}
-            else if (!strcmp(s, "switch")) {return T_SWITCH;}
-            else if (!strcmp(s, "signed")) {return T_SIGNED;}
-            break;
-        case 't':
-            if (!strcmp(s, "typedef")) {return T_TYPEDEF;}
-            break;
-        case 'u':
-            if (!strcmp(s, "union")) { return T_UNION;}
-            else if (!strcmp(s, "unsigned")) {return T_UNSIGNED;}
-            break;
-        case 'v':
-            if (!strcmp(s, "void")) { return T_VOID; }
-            else if (!strcmp(s, "volatile")) { return T_VOLATILE;}
-            break;
-        case 'w':
-            if (!strcmp(s, "while")) { return T_WHILE; }
-            break;
+// Return the token of the keyword spelled by the given span,
+// or 0 if the span is an ordinary identifier.
+static int keyword(char* s, int length) {
+    const t_keyword_entry* k;
+
+    if (length < KEYWORD_MIN_LENGTH || length > KEYWORD_MAX_LENGTH) {
+        return 0;
+    }
+
+    k = &keywords[KEYWORD_HASH(s, length)];
+
+    if (k->length == length && !memcmp(k->name, s, length)) {
+        return k->token;
     }
 
     return 0;
@@ -198,6 +270,8 @@ static int keyword(char* s) {
 
 int scan(t_token* t) {
     int c;
+    int type;
+    char* begin;
 
     if (rejected_token != NULL) {
         t = rejected_token;
@@ -207,16 +281,29 @@ int scan(t_token* t) {
 
     c = skip();
 
+    if (c == EOF) {
+        t->token = T_EOF;
+        t->name = NULL;
+        t->offset = input.end - input.start;
+        t->length = 0;
+        return 0;
+    }
+
+    if (pp_guard_watch) {
+        pp_token_seen();
+    }
+
+    begin = input.pos - 1;
+    t->name = NULL;
+
+    if ((type = single_char_tokens[c])) {
+        t->token = type;
+        t->offset = begin - input.start;
+        t->length = 1;
+        return 1;
+    }
+
     switch (c) {
-        case EOF:
-            t->token = T_EOF;
-            return 0;
-        case '^':
-            t->token = T_XOR;
-            break;
-        case ':':
-            t->token = T_COLON;
-            break;
         case '+':
             if ((c = next()) == '+') {
                 t->token = T_INCREMENT;
@@ -235,9 +322,6 @@ int scan(t_token* t) {
                 t->token = T_MINUS;
             }
             break;
-        case '.':
-            t->token = T_DOT;
-            break;
         case '|':
             if ((c = next()) == '|') {
                 t->token = T_LOGIC_OR;
@@ -246,20 +330,6 @@ int scan(t_token* t) {
                 t->token = T_OR;
             }
             break;
-        case '~':
-            t->token = T_INVERT;
-        case '*':
-            t->token = T_STAR;
-            break;
-        case '/':
-            t->token = T_SLASH;
-            break;
-        case ';':
-            t->token = T_SEMICOLON;
-            break;
-        case ',':
-            t->token = T_COMMA;
-            break;
         case '=':
             if ((c = next()) == '=') {
                 t->token = T_EQUALS;
@@ -304,24 +374,6 @@ int scan(t_token* t) {
                 t->token = T_GREATER_THAN;  
             }
             break;
-        case '(': 
-            t->token = T_LEFT_PAREN;
-            break;
-        case ')':
-            t->token = T_RIGHT_PAREN;
-            break;
-        case '{':
-            t->token = T_LEFT_BRACE;
-            break;
-        case '}':
-            t->token = T_RIGHT_BRACE;
-            break;
-        case '[':
-            t->token = T_LEFT_BRACKET;
-            break;
-        case ']':
-            t->token = T_RIGHT_BRACKET;
-            break;
         case '\'':
             t->value = scanch();
             t->token = T_INTLIT;
@@ -331,23 +383,35 @@ int scan(t_token* t) {
             }
             break;
         case '"':
-            scanstr(text);
+            interned_text = intern(text, scanstr(text));
+            t->name = interned_text;
             t->token = T_STRINGLIT;
             break;
         default:
-            if (isdigit(c)) {
+            if (char_class[c] & CC_DIGIT) {
                 t->value = scan_int(c);
                 t->token = T_INTLIT;
                 break;
-            } else if (isalpha(c) || c == '_') {
-                scan_identifier(c, text, TEXTLEN);
-                int type;
+            } else if (char_class[c] & CC_ALPHA) {
+                int length = scan_identifier();
 
-                if ((type = keyword(text))) {
+                // Macros may even redefine keywords
+                if (pp_expand(begin, length)) {
+                    return scan(t);
+                }
+
+                if ((type = keyword(begin, length))) {
                     t->token = type;
                     break;
                 }
 
+                if (length > TEXTLEN - 1) {
+                    fprintf(stderr, "Identifier too long on line %d\n", line);
+                    exit(1);
+                }
+
+                interned_text = intern(begin, length);
+                t->name = interned_text;
                 t->token = T_IDENTIFIER;
                 break;
             }
@@ -356,43 +420,80 @@ int scan(t_token* t) {
             exit(1);
     }
 
+    t->offset = begin - input.start;
+    t->length = input.pos - begin;
     return 1;
 }
 
 
+static int escape_char(int c) {
+    switch (c) {
+        case 'n': return '\n';
+        case '\\': return '\\';
+        case '\'': return '\'';
+        case '0' : return '\0';
+        default:
+            fprintf(stderr, "Unknown escape sequence for %c.\n", c);
+            exit(1);
+    }
+}
+
 static int scanch(void) {
     int c;
     c = next();
 
     if (c == '\\') {
-        switch (c = next()) {
-            case 'n': return '\n';
-            case '\\': return '\\';
-            case '\'': return '\'';
-            case '0' : return '\0';
-            default:
-                fprintf(stderr, "Unknown escape sequence for %c.\n", c);
-                exit(1);
-        }
+        return escape_char(next());
     }
 
     return c;
 }
 
+// Scan a string literal into buff. Runs of plain characters are located
+// with the string kernel and copied in one piece.
 static int scanstr(char* buff) {
-    int i,c;
+    char* p = input.pos;
+    char* run;
+    int i = 0;
+    int c;
+
+    while (1) {
+        run = scan_kernels.skip_string(p, input.end);
+
+        if (i + (run - p) > TEXTLEN - 1) {
+            fprintf(stderr, "String literal too long.\n");
+            exit(1);
+        }
+
+        memcpy(buff + i, p, run - p);
+        i += run - p;
+        p = run;
+
+        if (p >= input.end) {
+            fprintf(stderr, "Unterminated string literal on line %d.\n", line);
+            exit(1);
+        }
+
+        c = (unsigned char)*p++;
 
-    for (i = 0; i < TEXTLEN - 1; i++) {
         // End string here
-        if ((c = scanch()) == '"') {
+        if (c == '"') {
             buff[i] = 0;
+            input.pos = p;
             return i;
         }
 
-        buff[i] = c;
-    }
+        if (c == '\\' && p < input.end) {
+            c = escape_char((unsigned char)*p++);
+        } else if (c == '\n') {
+            line++;
+        }
 
-    fprintf(stderr, "String literal too long.\n");
-    exit(1);
-    return 0;
-}
\ No newline at end of file
+        if (i == TEXTLEN - 1) {
+            fprintf(stderr, "String literal too long.\n");
+            exit(1);
+        }
+
+        buff[i++] = c;
+    }
+}
@@ -1,29 +1,177 @@
-#include "../include/interpret.h"
+#include "../../include/interpret.h"
 
-int interpret_ast(t_astnode* n) {
-    int left_val, right_val;
+int evaluate_operator(int op, int left, int right, int* result) {
+    long l = left, r = right, v;
 
-    if (n->left) {
-        left_val = interpret_ast(n->left); 
+    // The generated code computes in 64 bit registers and shifts right
+    // logically, the constants follow it
+    switch (op) {
+        case A_ADD: v = l + r; break;
+        case A_SUBTRACT: v = l - r; break;
+        case A_MULTIPLY: v = l * r; break;
+        case A_DIVIDE:
+            if (r == 0) {return 0;}
+            v = l / r;
+            break;
+        case A_MOD:
+            if (r == 0) {return 0;}
+            v = l % r;
+            break;
+        case A_LSHIFT: v = (long)((unsigned long)l << (r & 63)); break;
+        case A_RSHIFT: v = (long)((unsigned long)l >> (r & 63)); break;
+        case A_AND: v = l & r; break;
+        case A_OR: v = l | r; break;
+        case A_XOR: v = l ^ r; break;
+        case A_EQUALS: v = l == r; break;
+        case A_NOT_EQUAL: v = l != r; break;
+        case A_LESS_THAN: v = l < r; break;
+        case A_GREATER_THAN: v = l > r; break;
+        case A_LESS_EQUAL: v = l <= r; break;
+        case A_GREATER_EQUAL: v = l >= r; break;
+        case A_LOGIC_AND: v = l && r; break;
+        case A_LOGIC_OR: v = l || r; break;
+        case A_LOGIC_NOT: v = !l; break;
+        case A_NEGATE: v = -l; break;
+        case A_INVERT: v = ~l; break;
+        case A_WIDEN: v = l; break;
+        default:
+            return 0;
+    }
+
+    if (v != (int)v) {
+        return 0;
+    }
+
+    *result = v;
+    return 1;
+}
+
+static int is_constant(t_astnode* n, int value) {
+    return n != NULL && n->op == A_INTLIT && n->value == value;
+}
+
+// Turn node n into a literal of its type
+static t_astnode* make_constant(t_astnode* n, int value) {
+    n->op = A_INTLIT;
+    n->value = value;
+    n->left = n->middle = n->right = NULL;
+    n->symbol = NULL;
+    return n;
+}
+
+// Return true if both trees compute the same value, without side
+// effects. same_value(n, n) tells if n has none.
+static int same_value(t_astnode* a, t_astnode* b) {
+    if (a == NULL || b == NULL) {
+        return a == b;
+    }
+
+    if (a->op != b->op) {
+        return 0;
     }
 
-    if (n->right) {
-        right_val = interpret_ast(n->right);
+    switch (a->op) {
+        case A_INTLIT:
+            return a->value == b->value;
+        case A_IDENTIFIER:
+        case A_ADDR:
+            return a->symbol == b->symbol;
+        case A_SCALE:
+            return a->size == b->size && same_value(a->left, b->left) && same_value(a->right, b->right);
+        case A_ADD: case A_SUBTRACT: case A_MULTIPLY: case A_DIVIDE: case A_MOD:
+        case A_EQUALS: case A_NOT_EQUAL: case A_LESS_THAN: case A_GREATER_THAN:
+        case A_LESS_EQUAL: case A_GREATER_EQUAL:
+        case A_LSHIFT: case A_RSHIFT: case A_OR: case A_AND: case A_XOR:
+        case A_LOGIC_AND: case A_LOGIC_OR: case A_LOGIC_NOT: case A_NEGATE: case A_INVERT:
+        case A_WIDEN: case A_DEREFERENCE:
+            return same_value(a->left, b->left) && same_value(a->right, b->right);
+        default:
+            return 0;
     }
+}
+
+// Apply the identities of an operator with one constant or two equal
+// operands. Return the simplified tree.
+static t_astnode* identities(t_astnode* n) {
+    t_astnode* left = n->left, *right = n->right;
 
-    switch(n->op) {
+    switch (n->op) {
         case A_ADD:
-            return left_val + right_val;
+        case A_OR:
+        case A_XOR:
+            if (is_constant(left, 0)) {return right;}
+            // Fall through
         case A_SUBTRACT:
-            return left_val - right_val;
+        case A_LSHIFT:
+        case A_RSHIFT:
+            if (is_constant(right, 0)) {return left;}
+            break;
         case A_MULTIPLY:
-            return left_val * right_val;
+            if (is_constant(left, 1)) {return right;}
+            if (is_constant(right, 1)) {return left;}
+            // Fall through
+        case A_AND:
+            if ((is_constant(left, 0) && same_value(right, right))
+                    || (is_constant(right, 0) && same_value(left, left))) {
+                return make_constant(n, 0);
+            }
+            break;
         case A_DIVIDE:
-            return left_val / right_val;
-        case A_INTLIT:
-            return n->value;
-        default:
-            fprintf(stderr, "Unknown AST operator %d\n", n->op);
-            exit(1);
+            if (is_constant(right, 1)) {return left;}
+            break;
     }
-}
\ No newline at end of file
+
+    if ((n->op == A_SUBTRACT || n->op == A_XOR) && same_value(left, right)) {
+        return make_constant(n, 0);
+    }
+
+    return n;
+}
+
+t_astnode* fold_ast(t_astnode* n) {
+    t_astnode* left, *right;
+    int value;
+
+    if (n == NULL) {
+        return NULL;
+    }
+
+    left = n->left = fold_ast(n->left);
+    n->middle = fold_ast(n->middle);
+    right = n->right = fold_ast(n->right);
+
+    switch (n->op) {
+        case A_IF:
+            if (left->op == A_INTLIT) {
+                return left->value ? n->middle : n->right;
+            }
+            return n;
+
+        case A_WHILE:
+            return is_constant(left, 0) ? NULL : n;
+
+        case A_SCALE:
+            if (left->op == A_INTLIT && evaluate_operator(A_MULTIPLY, left->value, n->size, &value)) {
+                return make_constant(n, value);
+            }
+            return n;
+
+        // The right operand is not evaluated once the left one decides
+        case A_LOGIC_AND:
+            if (is_constant(left, 0)) {return make_constant(n, 0);}
+            break;
+        case A_LOGIC_OR:
+            if (left->op == A_INTLIT && left->value != 0) {return make_constant(n, 1);}
+            break;
+    }
+
+    if (left != NULL && left->op == A_INTLIT && (right == NULL || right->op == A_INTLIT)
+            && evaluate_operator(n->op, left->value, right ? right->value : 0, &value)) {
+        return make_constant(n, value);
+    }
+
+    // An operand only replaces the node if it has its type, the type
+    // of a pointer decides what is loaded through it
+    left = identities(n);
+    return left->type == n->type ? left : n;
+}
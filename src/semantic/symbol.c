@@ -10,33 +10,137 @@ static t_symbol_entry* new_symbol(
         int class,
         int number_elements,
         int offset) {
-    t_symbol_entry* entry = malloc(sizeof(t_symbol_entry));
+    t_symbol_entry* entry = calloc(1, sizeof(t_symbol_entry));
 
-    // Duplicate name in order to make it unique
-    entry->name = strdup(name);
+    // Names are interned and shared, equal names have equal addresses
+    entry->name = name;
+    entry->num_elements = number_elements;
     entry->type = type;
     entry->stype = stype;
     entry->class = class;
     entry->ctype = ctype;
 
-    if (pointer_type(type) || inttype(type)) {
+    entry->offset = offset;
+
+    // size shares its storage with offset, which enum values use for
+    // their value
+    if (number_elements > 0 && (pointer_type(type) || inttype(type))) {
         entry->size = number_elements * typesize(type, ctype);
     }
 
-    entry->offset = offset;
-
     return entry;
 }
 
+// Parameters of the function whose body is parsed, indexed on demand
+// because function_id->member is linked by its own list
+static t_symbol_list function_parameters;
+static t_symbol_entry* indexed_function;
+
 void setup_symbol_table(void) {
-    global_symbols = (t_symbol_list *)malloc(sizeof(t_symbol_list));
-    local_symbols = (t_symbol_list *)malloc(sizeof(t_symbol_list));
-    parameter_symbols = (t_symbol_list *)malloc(sizeof(t_symbol_list));
-    struct_symbols = (t_symbol_list *)malloc(sizeof(t_symbol_list));
-    member_symbols = (t_symbol_list *)malloc(sizeof(t_symbol_list));
-    union_symbols = (t_symbol_list *)malloc(sizeof(t_symbol_list));
-    enum_symbols = (t_symbol_list *)malloc(sizeof(t_symbol_list));
-    typedef_symbols = (t_symbol_list *)malloc(sizeof(t_symbol_list));
+    global_symbols = (t_symbol_list *)calloc(1, sizeof(t_symbol_list));
+    local_symbols = (t_symbol_list *)calloc(1, sizeof(t_symbol_list));
+    parameter_symbols = (t_symbol_list *)calloc(1, sizeof(t_symbol_list));
+    struct_symbols = (t_symbol_list *)calloc(1, sizeof(t_symbol_list));
+    member_symbols = (t_symbol_list *)calloc(1, sizeof(t_symbol_list));
+    union_symbols = (t_symbol_list *)calloc(1, sizeof(t_symbol_list));
+    enum_symbols = (t_symbol_list *)calloc(1, sizeof(t_symbol_list));
+    typedef_symbols = (t_symbol_list *)calloc(1, sizeof(t_symbol_list));
+}
+
+// Interned names are identified by their address
+static unsigned int hash_name(char* name) {
+    unsigned long long h = (uintptr_t)name * 0x9e3779b97f4a7c15ull;
+    return (unsigned int)(h >> 32);
+}
+
+static int slot_live(t_symbol_list* list, t_symbol_slot* slot) {
+    return slot->entry != NULL && slot->generation == list->generation;
+}
+
+static void index_insert(t_symbol_list* list, t_symbol_entry* entry, unsigned int hash);
+
+// Double the slots, keeping only the entries of the current generation
+static void index_grow(t_symbol_list* list) {
+    t_symbol_slot* old = list->slots;
+    unsigned int old_capacity = list->capacity;
+    unsigned int generation = list->generation;
+
+    list->capacity = old_capacity ? old_capacity * 2 : SYMBOL_INDEX_SIZE;
+    list->slots = calloc(list->capacity, sizeof(t_symbol_slot));
+    list->count = 0;
+    list->generation = 0;
+
+    if (list->slots == NULL) {
+        fprintf(stderr, "Out of memory for symbol table\n");
+        exit(1);
+    }
+
+    for (unsigned int i = 0; i < old_capacity; i++) {
+        if (old[i].entry != NULL && old[i].generation == generation) {
+            index_insert(list, old[i].entry, old[i].hash);
+        }
+    }
+
+    free(old);
+}
+
+// The first entry with a name wins, as it did when lists were searched
+static void index_insert(t_symbol_list* list, t_symbol_entry* entry, unsigned int hash) {
+    t_symbol_slot* slot;
+
+    if ((list->count + 1) * 2 > list->capacity) {
+        index_grow(list);
+    }
+
+    for (unsigned int i = hash & (list->capacity - 1); ; i = (i + 1) & (list->capacity - 1)) {
+        slot = &list->slots[i];
+
+        if (!slot_live(list, slot)) {
+            break;
+        }
+
+        if (slot->entry->name == entry->name) {
+            return;
+        }
+    }
+
+    slot->entry = entry;
+    slot->hash = hash;
+    slot->generation = list->generation;
+    list->count++;
+}
+
+static t_symbol_entry* index_lookup(t_symbol_list* list, char* name) {
+    t_symbol_slot* slot;
+    unsigned int hash;
+    long probes = 1;
+
+    if (list->count == 0) {
+        return NULL;
+    }
+
+    hash = hash_name(name);
+    list->lookups++;
+
+    for (unsigned int i = hash & (list->capacity - 1); ; i = (i + 1) & (list->capacity - 1), probes++) {
+        slot = &list->slots[i];
+
+        if (!slot_live(list, slot)) {
+            slot = NULL;
+            break;
+        }
+
+        if (slot->entry->name == name) {
+            break;
+        }
+    }
+
+    list->probes += probes;
+    if (probes > list->longest_probe) {
+        list->longest_probe = probes;
+    }
+
+    return slot ? slot->entry : NULL;
 }
 
 void add_symbol(t_symbol_list* list, t_symbol_entry* s_entry) {
@@ -48,6 +152,16 @@ void add_symbol(t_symbol_list* list, t_symbol_entry* s_entry) {
     }
 
     s_entry->next = NULL;
+
+    if (s_entry->name != NULL) {
+        index_insert(list, s_entry, hash_name(s_entry->name));
+    }
+}
+
+void clear_symbol_list(t_symbol_list* list) {
+    list->head = list->tail = NULL;
+    list->count = 0;
+    list->generation++;
 }
 
 t_symbol_entry* add_global_symbol(char* name,
@@ -129,32 +243,18 @@ t_symbol_entry* add_typedef_symbol(char* name,
 }
 
 t_symbol_entry* find_symbol_in_list(t_symbol_list* list, char* name) {
-    t_symbol_entry *node = list->head;
-    while (node != NULL) {
-
-        if (node->name != NULL && strcmp(node->name, name) == 0) {
-            return node;
-        }
-
-        node = node->next;
-    }
-
-    return NULL;
+    return index_lookup(list, name);
 }
 
 void clear_local_symbol_table() {
-    local_symbols->head = local_symbols->tail = NULL;
+    clear_symbol_list(local_symbols);
 }
 
 t_symbol_entry* find_enum_value(char* name) {
-    t_symbol_entry *node = enum_symbols->head;
-    while (node != NULL) {
+    t_symbol_entry *node = index_lookup(enum_symbols, name);
 
-        if (node->type == C_ENUM_VALUE && node->name != NULL && strcmp(node->name, name) == 0) {
-            return node;
-        }
-
-        node = node->next;
+    if (node != NULL && node->class == C_ENUM_VALUE) {
+        return node;
     }
 
     return NULL;
@@ -183,22 +283,26 @@ t_symbol_entry* find_member_symbol(char* name) {
 }
 
 static t_symbol_entry* find_parameter_symbol(t_symbol_entry* function, char* name) {
-    while (function != NULL) {
-        if (!strcmp(function->name, name)) {
-            return function;
+    t_symbol_entry* parameter;
+
+    if (function != indexed_function) {
+        clear_symbol_list(&function_parameters);
+
+        for (parameter = function->member; parameter != NULL; parameter = parameter->next) {
+            index_insert(&function_parameters, parameter, hash_name(parameter->name));
         }
 
-        function = function->next;
+        indexed_function = function;
     }
 
-    return NULL;
+    return index_lookup(&function_parameters, name);
 }
 
 t_symbol_entry* find_symbol(char* name) {
     t_symbol_entry* node;
 
     if (function_id) {
-        node = find_parameter_symbol(function_id->member, name);
+        node = find_parameter_symbol(function_id, name);
 
         if (node) {
             return node;
@@ -229,12 +333,62 @@ t_symbol_entry* find_typedef_symbol(char* name) {
     return find_symbol_in_list(typedef_symbols, name);
 }
 
+void index_members(t_symbol_entry* composite) {
+    t_symbol_entry* m;
+
+    composite->members = calloc(1, sizeof(t_symbol_list));
+
+    for (m = composite->member; m != NULL; m = m->next) {
+        composite->members->tail = m;
+        index_insert(composite->members, m, hash_name(m->name));
+    }
+
+    composite->members->head = composite->member;
+}
+
+t_symbol_entry* find_member(t_symbol_entry* composite, char* name) {
+    if (composite->members == NULL) {
+        return NULL;
+    }
+
+    return index_lookup(composite->members, name);
+}
+
 void clear_parameter_symbols(void) {
-    parameter_symbols->head = parameter_symbols->tail = NULL;
+    clear_symbol_list(parameter_symbols);
 }
 
 void clear_symbol_table(void) {
-    global_symbols->head = global_symbols->tail = NULL;
-    local_symbols->head = local_symbols->tail = NULL;
-    parameter_symbols->head = parameter_symbols->tail = NULL;
+    clear_symbol_list(global_symbols);
+    clear_symbol_list(local_symbols);
+    clear_symbol_list(parameter_symbols);
+}
+
+void report_symbol_statistics(char* filename) {
+    struct {
+        char* name;
+        t_symbol_list* list;
+    } tables[] = {
+        {"global", global_symbols},
+        {"local", local_symbols},
+        {"parameter", &function_parameters},
+        {"struct", struct_symbols},
+        {"member", member_symbols},
+        {"enum", enum_symbols},
+        {"typedef", typedef_symbols}
+    };
+
+    for (size_t i = 0; i < sizeof(tables) / sizeof(tables[0]); i++) {
+        t_symbol_list* list = tables[i].list;
+
+        if (list->lookups == 0) {
+            continue;
+        }
+
+        fprintf(stderr, "%s: %s symbols: %ld lookups, %.2f probes on average, longest %ld, %u slots\n",
+                filename, tables[i].name, list->lookups, (double)list->probes / list->lookups,
+                list->longest_probe, list->capacity);
+
+        list->lookups = list->probes = list->longest_probe = 0;
+    }
 }
\ No newline at end of file
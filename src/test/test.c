@@ -23,10 +23,133 @@ void test_types() {
     free(str);
 }
 
+// Scan a single token from the given source text.
+static t_token scan_source(char* source) {
+    t_token t;
+
+    input.start = input.pos = source;
+    input.end = source + strlen(source);
+    scan(&t);
+
+    return t;
+}
+
 void test_scanner() {
+    char msg[TEST_MSG_LENGTH];
+    t_token t;
+    size_t i;
+
+    static char* keyword_names[] = {
+        "auto", "break", "case", "char", "const", "continue", "default", "do",
+        "double", "else", "enum", "extern", "float", "for", "goto", "if",
+        "int", "long", "register", "return", "signed", "sizeof", "static", "struct",
+        "switch", "typedef", "union", "unsigned", "void", "volatile", "while"
+    };
+
+    static int keyword_tokens[] = {
+        T_AUTO, T_BREAK, T_CASE, T_CHAR, T_CONST, T_CONTINUE, T_DEFAULT, T_DO,
+        T_DOUBLE, T_ELSE, T_ENUM, T_EXTERN, T_FLOAT, T_FOR, T_GOTO, T_IF,
+        T_INT, T_LONG, T_REGISTER, T_RETURN, T_SIGNED, T_SIZEOF, T_STATIC, T_STRUCT,
+        T_SWITCH, T_TYPEDEF, T_UNION, T_UNSIGNED, T_VOID, T_VOLATILE, T_WHILE
+    };
+
+    // Every keyword has to hit its own slot of the keyword hash
+    for (i = 0; i < sizeof(keyword_tokens) / sizeof(int); i++) {
+        t = scan_source(keyword_names[i]);
+
+        if (t.token != keyword_tokens[i]) {
+            snprintf(msg, TEST_MSG_LENGTH, "keyword %s scanned as token %d\n", keyword_names[i], t.token);
+            report_test_failed(msg);
+        }
+    }
+
+    // Identifiers that collide with a keyword slot are no keywords
+    static char* identifiers[] = {"in", "integer", "whilst", "_int", "Int", "r", "returned"};
+
+    for (i = 0; i < sizeof(identifiers) / sizeof(char*); i++) {
+        t = scan_source(identifiers[i]);
+
+        if (t.token != T_IDENTIFIER || t.offset != 0 || t.length != (int)strlen(identifiers[i])
+            || strcmp(interned_text, identifiers[i]) != 0) {
+            snprintf(msg, TEST_MSG_LENGTH, "identifier %s scanned as token %d\n", identifiers[i], t.token);
+            report_test_failed(msg);
+        }
+    }
+
+    // Runs that are longer than one vector step
+    t = scan_source("\n\n                                      \n  abcdefghijklmnopqrstuvwxyz_ABCDEFGHIJKLMNOPQRSTUVWXYZ_0123456789;");
+
+    if (t.token != T_IDENTIFIER || t.offset != 43 || t.length != 64) {
+        report_test_failed("long identifier scanned with wrong span\n");
+    }
+
+    t = scan_source("\"0123456789012345678901234567890123456789\\n0123456789012345678901234567890123456789\"");
+
+    if (t.token != T_STRINGLIT || strlen(text) != 81 || text[40] != '\n' || text[80] != '9') {
+        report_test_failed("long string literal scanned wrong\n");
+    }
+
+    t = scan_source("12345678901234567890123456789012345678;");
+
+    if (t.token != T_INTLIT || t.length != 38) {
+        report_test_failed("long integer literal scanned with wrong span\n");
+    }
+
+    t = scan_source("   ~x");
+
+    if (t.token != T_INVERT || t.offset != 3 || t.length != 1) {
+        report_test_failed("'~' not scanned as T_INVERT\n");
+    }
+}
+
+void test_preprocessor() {
+    char msg[TEST_MSG_LENGTH];
+    char filename[] = "/tmp/bcc_test_XXXXXX.c";
+    FILE* f;
+    t_token t;
+    int fd;
+    size_t i;
+
+    static char* source =
+        "#define N 4\n"
+        "#define ADD(a, b) (a + b)\n"
+        "#define CAT(a, b) a ## b\n"
+        "#if defined(N) && N * 2 == 8\n"
+        "ADD(ADD(1, N), CAT(x, 1))\n"
+        "#elif 1\n"
+        "wrong\n"
+        "#endif\n"
+        "/* comment */ N // comment\n";
+
+    static int tokens[] = {
+        T_LEFT_PAREN, T_LEFT_PAREN, T_INTLIT, T_PLUS, T_INTLIT, T_RIGHT_PAREN,
+        T_PLUS, T_IDENTIFIER, T_RIGHT_PAREN, T_INTLIT, T_EOF
+    };
+
+    if ((fd = mkstemps(filename, 2)) < 0 || (f = fdopen(fd, "w")) == NULL) {
+        report_test_failed("unable to create a file for the preprocessor\n");
+        return;
+    }
+
+    fputs(source, f);
+    fclose(f);
+    pp_start(filename);
+
+    for (i = 0; i < sizeof(tokens) / sizeof(int); i++) {
+        scan(&t);
 
+        if (t.token != tokens[i]) {
+            snprintf(msg, TEST_MSG_LENGTH, "preprocessed token %zu is %d instead of %d\n", i, t.token, tokens[i]);
+            report_test_failed(msg);
+            break;
+        }
+    }
 
+    if (line != 10 || strcmp(interned_text, "x1") != 0) {
+        report_test_failed("preprocessor lost track of the line or pasted wrong\n");
+    }
 
+    unlink(filename);
 }
 
 void report_test_failed(const char* msg, ...) {